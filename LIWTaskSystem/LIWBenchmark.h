@@ -0,0 +1,207 @@
+#pragma once
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+
+/*
+* Self-contained benchmark harness.
+* A benchmark runs a given count of operations and returns the time (ns) of its measured section,
+* so setup and teardown (pool init, thread join...) can be left out of the measurement.
+* Each benchmark is run several times, and min/median/max of ns per operation are reported as table, CSV or JSON.
+*/
+
+namespace LIW {
+	namespace Util {
+		/// <summary>
+		/// Benchmark function.
+		/// </summary>
+		/// <param name="countOps"> count of operations to run </param>
+		/// <returns> time of the measured section (ns) </returns>
+		typedef uint64_t(*LIWBenchmarkFunction)(uint64_t countOps);
+
+		/// <summary>
+		/// Get a timestamp for benchmarks (ns).
+		/// </summary>
+		inline uint64_t liw_bench_now_ns() {
+			return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		/// <summary>
+		/// Prevent the compiler from optimizing away the computation of a pointer (e.g. an allocation).
+		/// </summary>
+		inline void liw_bench_keep(const void* ptr) {
+			[[maybe_unused]] static const void* volatile s_sink; // Only written
+			s_sink = ptr;
+		}
+
+		struct LIWBenchmarkResult {
+			std::string m_name;				// Name of the benchmark
+			uint64_t m_countOps{ 0 };		// Operations per run
+			uint32_t m_countRuns{ 0 };		// Count of runs
+			double m_nsPerOpMin{ 0 };		// Min ns per operation among runs
+			double m_nsPerOpMedian{ 0 };	// Median ns per operation among runs
+			double m_nsPerOpMax{ 0 };		// Max ns per operation among runs
+
+			inline double GetOpsPerSec() const { return m_nsPerOpMedian <= 0 ? 0.0 : 1e9 / m_nsPerOpMedian; }
+		};
+
+		class LIWBenchmarkSuite {
+		private:
+			struct Entry {
+				std::string m_name;
+				LIWBenchmarkFunction m_func;
+				uint64_t m_countOps;
+			};
+		public:
+			/// <summary>
+			/// Register a benchmark.
+			/// </summary>
+			/// <param name="name"> name of the benchmark (group/name) </param>
+			/// <param name="func"> benchmark function </param>
+			/// <param name="countOps"> default operations per run </param>
+			inline void Add(const char* name, LIWBenchmarkFunction func, uint64_t countOps) {
+				m_entries.push_back(Entry{ name, func, countOps });
+			}
+
+			/// <summary>
+			/// Run all registered benchmarks whose names contain filter.
+			/// </summary>
+			/// <param name="filter"> substring to match (nullptr or empty for all) </param>
+			/// <param name="countRuns"> runs per benchmark </param>
+			/// <param name="scale"> multiplier of operations per run </param>
+			/// <param name="log"> stream to log progress to (nullptr for silence) </param>
+			/// <returns> results </returns>
+			std::vector<LIWBenchmarkResult> Run(const char* filter, uint32_t countRuns, double scale, std::ostream* log) const {
+				std::vector<LIWBenchmarkResult> results;
+				for (auto& entry : m_entries) {
+					if (filter && *filter && entry.m_name.find(filter) == std::string::npos)
+						continue;
+					LIWBenchmarkResult result;
+					result.m_name = entry.m_name;
+					result.m_countOps = std::max<uint64_t>(1, (uint64_t)(entry.m_countOps * scale));
+					result.m_countRuns = countRuns;
+
+					if (log) *log << entry.m_name << " ..." << std::flush;
+					std::vector<double> nsPerOp;
+					for (uint32_t i = 0; i < countRuns; ++i) {
+						nsPerOp.push_back((double)entry.m_func(result.m_countOps) / (double)result.m_countOps);
+					}
+					std::sort(nsPerOp.begin(), nsPerOp.end());
+					result.m_nsPerOpMin = nsPerOp.front();
+					result.m_nsPerOpMedian = nsPerOp[nsPerOp.size() / 2];
+					result.m_nsPerOpMax = nsPerOp.back();
+					if (log) *log << " " << result.m_nsPerOpMedian << " ns/op" << std::endl;
+
+					results.push_back(result);
+				}
+				return results;
+			}
+
+			/// <summary>
+			/// Entry point of a benchmark executable.
+			/// Options:
+			///		--filter <substr>			run only benchmarks whose names contain substr
+			///		--runs <n>					runs per benchmark (default 5)
+			///		--scale <x>					multiplier of operations per run (default 1)
+			///		--format <table|csv|json>	output format (default table)
+			///		--out <path>				write output into a file instead of stdout
+			///		--list						list benchmarks
+			/// </summary>
+			int Main(int argc, char** argv) const {
+				const char* filter = nullptr;
+				const char* format = "table";
+				const char* pathOut = nullptr;
+				uint32_t countRuns = 5;
+				double scale = 1.0;
+				for (int i = 1; i < argc; ++i) {
+					const bool hasVal = i + 1 < argc;
+					if (!strcmp(argv[i], "--filter") && hasVal) filter = argv[++i];
+					else if (!strcmp(argv[i], "--runs") && hasVal) countRuns = std::max(1, atoi(argv[++i]));
+					else if (!strcmp(argv[i], "--scale") && hasVal) scale = atof(argv[++i]);
+					else if (!strcmp(argv[i], "--format") && hasVal) format = argv[++i];
+					else if (!strcmp(argv[i], "--out") && hasVal) pathOut = argv[++i];
+					else if (!strcmp(argv[i], "--list")) {
+						for (auto& entry : m_entries) std::cout << entry.m_name << "\n";
+						return 0;
+					}
+					else {
+						std::cerr << "Usage: " << argv[0] << " [--filter substr] [--runs n] [--scale x] [--format table|csv|json] [--out path] [--list]\n";
+						return 1;
+					}
+				}
+				if (strcmp(format, "table") && strcmp(format, "csv") && strcmp(format, "json")) {
+					std::cerr << "Unknown format: " << format << "\n";
+					return 1;
+				}
+
+				const std::vector<LIWBenchmarkResult> results = Run(filter, countRuns, scale, &std::cerr);
+
+				std::ofstream fout;
+				if (pathOut) {
+					fout.open(pathOut);
+					if (!fout.is_open()) {
+						std::cerr << "Cannot open " << pathOut << "\n";
+						return 1;
+					}
+				}
+				std::ostream& os = pathOut ? fout : std::cout;
+				if (!strcmp(format, "csv")) WriteCSV(os, results);
+				else if (!strcmp(format, "json")) WriteJSON(os, results);
+				else WriteTable(os, results);
+				return 0;
+			}
+
+			static void WriteTable(std::ostream& os, const std::vector<LIWBenchmarkResult>& results) {
+				const std::ios::fmtflags flags = os.flags();
+				const std::streamsize precision = os.precision();
+				os << std::left << std::setw(40) << "benchmark" << std::right
+				   << std::setw(12) << "ops" << std::setw(14) << "ns/op(min)" << std::setw(14) << "ns/op(med)" << std::setw(14) << "ns/op(max)" << std::setw(16) << "ops/s" << "\n";
+				os << std::fixed << std::setprecision(2);
+				for (auto& result : results) {
+					os << std::left << std::setw(40) << result.m_name << std::right
+					   << std::setw(12) << result.m_countOps << std::setw(14) << result.m_nsPerOpMin << std::setw(14) << result.m_nsPerOpMedian
+					   << std::setw(14) << result.m_nsPerOpMax << std::setw(16) << std::setprecision(0) << result.GetOpsPerSec() << std::setprecision(2) << "\n";
+				}
+				os.flags(flags);
+				os.precision(precision);
+			}
+			static void WriteCSV(std::ostream& os, const std::vector<LIWBenchmarkResult>& results) {
+				const std::ios::fmtflags flags = os.flags();
+				const std::streamsize precision = os.precision();
+				os << "name,ops,runs,ns_per_op_min,ns_per_op_median,ns_per_op_max,ops_per_sec\n";
+				os << std::fixed << std::setprecision(3);
+				for (auto& result : results) {
+					os << result.m_name << "," << result.m_countOps << "," << result.m_countRuns << "," << result.m_nsPerOpMin << ","
+					   << result.m_nsPerOpMedian << "," << result.m_nsPerOpMax << "," << result.GetOpsPerSec() << "\n";
+				}
+				os.flags(flags);
+				os.precision(precision);
+			}
+			static void WriteJSON(std::ostream& os, const std::vector<LIWBenchmarkResult>& results) {
+				const std::ios::fmtflags flags = os.flags();
+				const std::streamsize precision = os.precision();
+				os << "{\"benchmarks\":[\n" << std::fixed << std::setprecision(3);
+				for (size_t i = 0; i < results.size(); ++i) {
+					const LIWBenchmarkResult& result = results[i];
+					os << "{\"name\":\"" << result.m_name << "\",\"ops\":" << result.m_countOps << ",\"runs\":" << result.m_countRuns
+					   << ",\"ns_per_op_min\":" << result.m_nsPerOpMin << ",\"ns_per_op_median\":" << result.m_nsPerOpMedian
+					   << ",\"ns_per_op_max\":" << result.m_nsPerOpMax << ",\"ops_per_sec\":" << result.GetOpsPerSec() << "}"
+					   << (i + 1 < results.size() ? ",\n" : "\n");
+				}
+				os << "]}\n";
+				os.flags(flags);
+				os.precision(precision);
+			}
+
+		private:
+			std::vector<Entry> m_entries;
+		};
+	}
+}
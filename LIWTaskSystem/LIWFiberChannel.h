@@ -0,0 +1,176 @@
+#pragma once
+#include <mutex>
+#include <queue>
+#include <list>
+#include <cassert>
+
+#include "LIWFiberCommon.h"
+#include "LIWFiberWorker.h"
+
+namespace LIW {
+	/*
+	* A channel for passing values between fibers.
+	* A fiber which pops an empty channel (or pushes a full bounded one) is parked on the channel's waiter list,
+	* and the worker thread is free to run other fibers. Parked fibers are awaken into their pool's awake list.
+	* NOTE: Blocking push/pop must be called inside a fiber of a fiber pool.
+	* NOTE: Call notify_stop() before stopping the pool, so that no fiber stays parked on the channel.
+	*/
+	template<class T>
+	class LIWFiberChannel {
+	public:
+		typedef typename std::queue<T>::size_type size_type;
+	private:
+		typedef std::lock_guard<std::mutex> lock_guard;
+		typedef std::unique_lock<std::mutex> uniq_lock;
+	public:
+		/// <summary>
+		/// Construct a channel.
+		/// </summary>
+		/// <param name="capacity"> max count of values in channel (0 means unbounded) </param>
+		LIWFiberChannel(size_type capacity = 0) : __m_capacity(capacity) {}
+		LIWFiberChannel(const LIWFiberChannel&) = delete;
+		LIWFiberChannel& operator=(const LIWFiberChannel&) = delete;
+
+		/// <summary>
+		/// Push a value into channel immediately. (Can be called outside fibers)
+		/// </summary>
+		/// <param name="val"> Value to enqueue. </param>
+		/// <returns> Is operation successful. Unsuccess means channel full or stopped. </returns>
+		bool push_now(const T& val) {
+			lock_guard lk(__m_mtx);
+			if (!__m_running || IsFull()) return false;
+			__m_queue.push(val);
+			AwakeOne(__m_waitersPop);
+			return true;
+		}
+		bool push_now(T&& val) {
+			lock_guard lk(__m_mtx);
+			if (!__m_running || IsFull()) return false;
+			__m_queue.push(std::move(val));
+			AwakeOne(__m_waitersPop);
+			return true;
+		}
+
+		/// <summary>
+		/// Push a value into channel. Park the fiber while channel is full.
+		/// </summary>
+		/// <param name="thisFiber"> fiber calling push </param>
+		/// <param name="val"> Value to enqueue. </param>
+		/// <returns> Is operation successful. Unsuccess means channel stopped. </returns>
+		bool push(LIWFiberWorker* thisFiber, const T& val) {
+			uniq_lock lk(__m_mtx);
+			WaitTillNonFull(thisFiber, lk);
+			if (!__m_running) return false;
+			__m_queue.push(val);
+			AwakeOne(__m_waitersPop);
+			return true;
+		}
+		bool push(LIWFiberWorker* thisFiber, T&& val) {
+			uniq_lock lk(__m_mtx);
+			WaitTillNonFull(thisFiber, lk);
+			if (!__m_running) return false;
+			__m_queue.push(std::move(val));
+			AwakeOne(__m_waitersPop);
+			return true;
+		}
+
+		/// <summary>
+		/// Pop from channel immediately. (Can be called outside fibers)
+		/// </summary>
+		/// <param name="valOut"> Value dequeued. </param>
+		/// <returns> Is operation successful. Unsuccess means channel empty. </returns>
+		bool pop_now(T& valOut) {
+			lock_guard lk(__m_mtx);
+			if (__m_queue.empty()) return false;
+			valOut = std::move(__m_queue.front());
+			__m_queue.pop();
+			AwakeOne(__m_waitersPush);
+			return true;
+		}
+
+		/// <summary>
+		/// Pop from channel. Park the fiber while channel is empty.
+		/// </summary>
+		/// <param name="thisFiber"> fiber calling pop </param>
+		/// <param name="valOut"> Value dequeued. </param>
+		/// <returns> Is operation successful. Unsuccess means channel stopped and drained. </returns>
+		bool pop(LIWFiberWorker* thisFiber, T& valOut) {
+			uniq_lock lk(__m_mtx);
+			while (__m_queue.empty() && __m_running) {
+				__m_waitersPop.emplace_back(thisFiber);
+				Park(thisFiber, lk);
+			}
+			if (__m_queue.empty()) return false;
+			valOut = std::move(__m_queue.front());
+			__m_queue.pop();
+			AwakeOne(__m_waitersPush);
+			return true;
+		}
+
+		/// <summary>
+		/// Get size of channel.
+		/// </summary>
+		/// <returns> Size of channel. </returns>
+		inline size_type size() const { lock_guard lk(__m_mtx); return __m_queue.size(); }
+		/// <summary>
+		/// Get if channel is empty.
+		/// </summary>
+		/// <returns> Is channel empty. </returns>
+		inline bool empty() const { lock_guard lk(__m_mtx); return __m_queue.empty(); }
+		/// <summary>
+		/// Get capacity of channel (0 means unbounded).
+		/// </summary>
+		/// <returns> Capacity of channel. </returns>
+		inline size_type capacity() const { return __m_capacity; }
+
+		/// <summary>
+		/// Stop the channel and awake all parked fibers.
+		/// Pushes fail afterwards. Pops succeed until channel is drained.
+		/// </summary>
+		void notify_stop() {
+			lock_guard lk(__m_mtx);
+			__m_running = false;
+			while (AwakeOne(__m_waitersPop)) {}
+			while (AwakeOne(__m_waitersPush)) {}
+		}
+
+	private:
+		inline bool IsFull() const { return __m_capacity != 0 && __m_queue.size() >= __m_capacity; }
+
+		/// <summary>
+		/// Park the fiber until awaken. Lock is released once the fiber is switched out and reacquired on resume.
+		/// </summary>
+		inline void Park(LIWFiberWorker* thisFiber, uniq_lock& lk) {
+			assert(thisFiber); // Blocking operations must be called inside a fiber
+			thisFiber->YieldToMainAndUnlock(*lk.release());
+			lk = uniq_lock(__m_mtx);
+		}
+
+		inline void WaitTillNonFull(LIWFiberWorker* thisFiber, uniq_lock& lk) {
+			while (IsFull() && __m_running) {
+				__m_waitersPush.emplace_back(thisFiber);
+				Park(thisFiber, lk);
+			}
+		}
+
+		/// <summary>
+		/// Awake the first fiber parked on a waiter list. (Lock must be held)
+		/// </summary>
+		/// <returns> Is any fiber awaken. </returns>
+		inline bool AwakeOne(std::list<LIWFiberWorker*>& waiters) {
+			if (waiters.empty()) return false;
+			LIWFiberWorker* fiber = waiters.front();
+			waiters.pop_front();
+			fiber->Awake();
+			return true;
+		}
+
+	private:
+		std::queue<T> __m_queue;
+		std::list<LIWFiberWorker*> __m_waitersPop;
+		std::list<LIWFiberWorker*> __m_waitersPush;
+		const size_type __m_capacity;
+		mutable std::mutex __m_mtx;
+		bool __m_running = true;
+	};
+}
@@ -2,6 +2,33 @@
 #include <functional>
 #include <atomic>
 #include <list>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+// ThreadSanitizer needs to be told about fiber switches on POSIX (ucontext), or it reports false races across fibers. 
+#if !defined(_WIN32) && !defined(LIW_FIBER_TSAN)
+#if defined(__SANITIZE_THREAD__)
+#define LIW_FIBER_TSAN
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define LIW_FIBER_TSAN
+#endif
+#endif
+#endif
+#ifdef LIW_FIBER_TSAN
+#include <sanitizer/tsan_interface.h>
+#endif
+
+// Check fiber stacks for overflow on every switch out. On by default in debug builds (no NDEBUG), or define LIW_FIBER_STACK_CHECK. 
+#if !defined(NDEBUG) && !defined(LIW_FIBER_STACK_CHECK)
+#define LIW_FIBER_STACK_CHECK
+#endif
+
+// Bytes at the top of fiber stacks painted to measure peak usage with LIW_ENABLE_STATS (POSIX). Painting commits them, and deeper peaks read as this depth. 
+#ifndef LIW_FIBER_STACK_PAINT_DEPTH
+#define LIW_FIBER_STACK_PAINT_DEPTH (64 * 1024)
+#endif
 
 namespace LIW {
 	class LIWFiberMain;
@@ -13,7 +40,37 @@ namespace LIW {
 		Running
 	};
 
+	/// <summary>
+	/// Stack size class of fibers. A task hints the class it needs, and pools run it on an idle fiber of that class, or of the class one step up if none is idle. 
+	/// Pools refuse to submit a task hinting a class they have no fibers of. 
+	/// </summary>
+	enum class LIWFiberStackClass : uint8_t {
+		Small,
+		Medium,
+		Large,
+		Count
+	};
+	const size_t c_countFiberStackClasses = (size_t)LIWFiberStackClass::Count;
+
+	/// <summary>
+	/// Fibers of each stack class to create in a fiber pool. 
+	/// </summary>
+	struct LIWFiberStackConfig {
+		int m_numFibers[c_countFiberStackClasses] = { 0, 0, 0 };							// Count of fibers of each class
+		size_t m_stackSizes[c_countFiberStackClasses] = { 16 * 1024, 64 * 1024, 512 * 1024 };	// Stack size of each class (bytes)
+	};
+
+	/// <summary>
+	/// Which worker thread resumes a fiber after it was parked. 
+	/// </summary>
+	enum class LIWFiberAffinity : uint8_t {
+		None,		// Any worker (global awake list)
+		Preferred,	// The worker which last ran it (local ready queue), unless stolen by an idle worker while that one is busy
+		Pinned		// Always the worker which started it, for tasks touching thread local state (e.g. thread local allocators)
+	};
+
 	typedef void(*LIWFiberRunner)(LIWFiberWorker* thisFiber, void* param);
+	typedef void(*LIWFiberAwakeFunction)(void* awakeTarget, LIWFiberWorker* fiber);
 }
 
 #define LIW_FIBER_RUNNER_DEF(function_name)
\ No newline at end of file
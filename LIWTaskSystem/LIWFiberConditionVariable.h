@@ -0,0 +1,77 @@
+#pragma once
+#include <mutex>
+#include <list>
+#include <cassert>
+
+#include "LIWFiberCommon.h"
+#include "LIWFiberWorker.h"
+#include "LIWFiberMutex.h"
+
+namespace LIW {
+	/*
+	* A condition variable for fibers, used together with LIWFiberMutex.
+	* Waiting parks the fiber instead of blocking the worker thread.
+	* NOTE: wait must be called inside a fiber of a fiber pool.
+	*/
+	class LIWFiberConditionVariable {
+	private:
+		typedef std::lock_guard<std::mutex> lock_guard;
+		typedef std::unique_lock<std::mutex> uniq_lock;
+	public:
+		LIWFiberConditionVariable() = default;
+		LIWFiberConditionVariable(const LIWFiberConditionVariable&) = delete;
+		LIWFiberConditionVariable& operator=(const LIWFiberConditionVariable&) = delete;
+
+		/// <summary>
+		/// Unlock mtx and park the fiber until notified. mtx is locked again before returning.
+		/// </summary>
+		/// <param name="thisFiber"> fiber calling wait </param>
+		/// <param name="mtx"> mutex locked by caller </param>
+		void wait(LIWFiberWorker* thisFiber, LIWFiberMutex& mtx) {
+			assert(thisFiber); // Must be called inside a fiber
+			uniq_lock lk(m_mtxWaiters);
+			m_waiters.emplace_back(thisFiber); // Registered before mtx is released, so no notify can be missed
+			mtx.unlock();
+			thisFiber->YieldToMainAndUnlock(*lk.release());
+			mtx.lock(thisFiber);
+		}
+		/// <summary>
+		/// Wait until pred is satisfied.
+		/// </summary>
+		/// <param name="thisFiber"> fiber calling wait </param>
+		/// <param name="mtx"> mutex locked by caller </param>
+		/// <param name="pred"> predicate to satisfy </param>
+		template<class Predicate>
+		void wait(LIWFiberWorker* thisFiber, LIWFiberMutex& mtx, Predicate pred) {
+			while (!pred()) {
+				wait(thisFiber, mtx);
+			}
+		}
+
+		/// <summary>
+		/// Awake one parked fiber.
+		/// </summary>
+		void notify_one() {
+			lock_guard lk(m_mtxWaiters);
+			if (!m_waiters.empty()) {
+				LIWFiberWorker* fiber = m_waiters.front();
+				m_waiters.pop_front();
+				fiber->Awake();
+			}
+		}
+		/// <summary>
+		/// Awake all parked fibers.
+		/// </summary>
+		void notify_all() {
+			lock_guard lk(m_mtxWaiters);
+			while (!m_waiters.empty()) {
+				m_waiters.front()->Awake();
+				m_waiters.pop_front();
+			}
+		}
+
+	private:
+		std::mutex m_mtxWaiters; // Guards waiter list
+		std::list<LIWFiberWorker*> m_waiters; // Fibers parked on this condition variable
+	};
+}
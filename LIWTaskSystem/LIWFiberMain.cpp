@@ -1,17 +1,55 @@
 #include "LIWFiberMain.h"
 #include "LIWFiberWorker.h"
 
+LIW::LIWFiberState LIW::LIWFiberMain::YieldTo(LIWFiberWorker* fiberOther)
+{
+#ifdef _WIN32
+	SwitchToFiber(fiberOther->m_sysFiber);
+#else
+#ifdef LIW_FIBER_TSAN
+	while (fiberOther->m_tsanUnlocking.load(std::memory_order_acquire)) {}
+	__tsan_switch_to_fiber(fiberOther->m_tsanFiber, 0);
+#endif
+	swapcontext(&m_sysFiber, &fiberOther->m_sysFiber);
+#endif
+	const LIWFiberState state = fiberOther->m_state;
+	if (fiberOther->m_mtxUnlockOnYield) { // Fiber parked itself. Release the waiter list now that it is switched out. 
+		std::mutex* mtx = fiberOther->m_mtxUnlockOnYield;
+		fiberOther->m_mtxUnlockOnYield = nullptr;
+#ifdef LIW_FIBER_TSAN
+		fiberOther->m_tsanUnlocking.store(true, std::memory_order_relaxed);
+		__tsan_switch_to_fiber(fiberOther->m_tsanFiber, 0); // The fiber locked the mutex. Unlock on its behalf, or ThreadSanitizer sees a foreign unlock. 
+		mtx->unlock();
+		__tsan_switch_to_fiber(m_tsanFiber, 0);
+		fiberOther->m_tsanUnlocking.store(false, std::memory_order_release);
+#else
+		mtx->unlock();
+#endif
+	}
+	return state;
+}
+
 //
 // Win32
 //
 #ifdef _WIN32
-void LIW::LIWFiberMain::YieldTo(LIWFiberWorker* fiberOther)
+LIW::LIWFiberMain::LIWFiberMain()
 {
-	SwitchToFiber(fiberOther->m_sysFiber);
+	m_sysFiber = ConvertThreadToFiber(nullptr);
+}
+LIW::LIWFiberMain::~LIWFiberMain()
+{
+	ConvertFiberToThread();
 }
+//
+// POSIX
+//
+#else
 LIW::LIWFiberMain::LIWFiberMain()
 {
-	m_sysFiber = ConvertThreadToFiber(nullptr);
+#ifdef LIW_FIBER_TSAN
+	m_tsanFiber = __tsan_get_current_fiber();
+#endif
 }
 LIW::LIWFiberMain::~LIWFiberMain()
 {
@@ -1,13 +1,13 @@
 #pragma once
 #include "LIWFiberCommon.h"
 
-namespace LIW {
-//
-// Win32
-//
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <ucontext.h>
+#endif
 
+namespace LIW {
 	class LIWFiberMain final
 	{
 		friend class LIWFiberWorker;
@@ -17,13 +17,26 @@ namespace LIW {
 		static inline LIWFiberMain* InitThreadMainFiber() {
 			return new LIWFiberMain();
 		}
-		void YieldTo(LIWFiberWorker* fiberOther);
+		static inline void ReleaseThreadMainFiber(LIWFiberMain* fiberMain) {
+			delete fiberMain;
+		}
+		/// <summary>
+		/// Switch to a worker fiber. Returns when the fiber yields back.
+		/// </summary>
+		/// <returns> state of the fiber when it yielded back. Read before a parked fiber is released, since it may be awaken and resumed by another thread right after. </returns>
+		LIWFiberState YieldTo(LIWFiberWorker* fiberOther);
 	private:
 		LIWFiberMain();
 		~LIWFiberMain();
 	private:
+#ifdef _WIN32
 		LPVOID m_sysFiber;
+#else
+		ucontext_t m_sysFiber; // Saved context of the thread
+#ifdef LIW_FIBER_TSAN
+		void* m_tsanFiber = nullptr; // ThreadSanitizer fiber of the thread
+#endif
+#endif
 	};
-#endif 
 }
 
@@ -0,0 +1,97 @@
+#pragma once
+#include <mutex>
+#include <list>
+#include <atomic>
+#include <thread>
+#include <cassert>
+
+#include "LIWFiberCommon.h"
+#include "LIWFiberWorker.h"
+
+namespace LIW {
+	/*
+	* A mutex for fibers.
+	* Spin briefly when contended, then park the fiber on the waiter list so the worker thread can run other fibers.
+	* Unlock can be called from any thread, so the owning fiber is free to migrate between worker threads.
+	* NOTE: When lock is called outside fibers (thisFiber == nullptr), the thread yields instead of parking.
+	*/
+	class LIWFiberMutex {
+	private:
+		typedef std::lock_guard<std::mutex> lock_guard;
+		typedef std::unique_lock<std::mutex> uniq_lock;
+		static const int c_spinCount = 128;
+	public:
+		LIWFiberMutex() = default;
+		LIWFiberMutex(const LIWFiberMutex&) = delete;
+		LIWFiberMutex& operator=(const LIWFiberMutex&) = delete;
+
+		/// <summary>
+		/// Try to lock mutex without waiting.
+		/// </summary>
+		/// <returns> Is mutex locked by caller. </returns>
+		inline bool try_lock() {
+			bool expected = false;
+			return m_locked.compare_exchange_strong(expected, true, std::memory_order_seq_cst, std::memory_order_relaxed);
+		}
+
+		/// <summary>
+		/// Lock mutex. Spin briefly, then park the fiber until mutex is released.
+		/// </summary>
+		/// <param name="thisFiber"> fiber calling lock </param>
+		void lock(LIWFiberWorker* thisFiber) {
+			while (true) {
+				for (int i = 0; i < c_spinCount; ++i) {
+					if (!m_locked.load(std::memory_order_relaxed) && try_lock())
+						return;
+				}
+				if (!thisFiber) {
+					std::this_thread::yield();
+					continue;
+				}
+				uniq_lock lk(m_mtxWaiters);
+				m_countWaiters.fetch_add(1, std::memory_order_seq_cst);
+				if (try_lock()) { // Released while registering
+					m_countWaiters.fetch_sub(1, std::memory_order_relaxed);
+					return;
+				}
+				m_waiters.emplace_back(thisFiber);
+				thisFiber->YieldToMainAndUnlock(*lk.release()); // Awaken by unlock, then try again
+			}
+		}
+
+		/// <summary>
+		/// Unlock mutex. Awake one parked fiber if there is any.
+		/// </summary>
+		void unlock() {
+			m_locked.store(false, std::memory_order_seq_cst);
+			if (m_countWaiters.load(std::memory_order_seq_cst) > 0) {
+				lock_guard lk(m_mtxWaiters);
+				if (!m_waiters.empty()) {
+					LIWFiberWorker* fiber = m_waiters.front();
+					m_waiters.pop_front();
+					m_countWaiters.fetch_sub(1, std::memory_order_relaxed);
+					fiber->Awake();
+				}
+			}
+		}
+
+	private:
+		std::atomic<bool> m_locked{ false }; // Is mutex locked?
+		std::atomic<int> m_countWaiters{ 0 }; // Count of fibers parked (or about to park)
+		std::mutex m_mtxWaiters; // Guards waiter list
+		std::list<LIWFiberWorker*> m_waiters; // Fibers parked on this mutex
+	};
+
+	/*
+	* RAII lock guard for LIWFiberMutex.
+	*/
+	class LIWFiberLockGuard {
+	public:
+		LIWFiberLockGuard(LIWFiberMutex& mtx, LIWFiberWorker* thisFiber) : m_mtx(mtx) { m_mtx.lock(thisFiber); }
+		~LIWFiberLockGuard() { m_mtx.unlock(); }
+		LIWFiberLockGuard(const LIWFiberLockGuard&) = delete;
+		LIWFiberLockGuard& operator=(const LIWFiberLockGuard&) = delete;
+	private:
+		LIWFiberMutex& m_mtx;
+	};
+}
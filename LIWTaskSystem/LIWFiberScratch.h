@@ -0,0 +1,132 @@
+#pragma once
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+
+#include "LIWAllocation.h"
+
+namespace LIW {
+	/*
+	* LIWFiberScratch is a linear scratch arena owned by a fiber. 
+	* It is only touched by its fiber, so it needs no locks, and its allocations stay valid across waits whichever worker thread resumes the fiber. 
+	* Memory is taken on the first allocation, in chunks of at least the initial size. Reset frees everything at once (the fiber does it when its run function returns). 
+	* If a run needed more than one chunk, Reset replaces them with a single chunk of the peak size, so later runs bump in one chunk. 
+	*/
+	class LIWFiberScratch final
+	{
+	public:
+		explicit LIWFiberScratch(size_t sizeInitial = c_sizeDefault) :
+			m_sizeChunk(sizeInitial) { }
+		~LIWFiberScratch() {
+			FreeChunks();
+		}
+		LIWFiberScratch(const LIWFiberScratch& other) = delete;
+		LIWFiberScratch& operator=(const LIWFiberScratch& other) = delete;
+
+		/// <summary>
+		/// Allocate a size of memory, valid until the next Reset. 
+		/// </summary>
+		/// <param name="size"> size of memory to allocate </param>
+		/// <param name="align"> alignment (power of 2) </param>
+		/// <returns> allocated memory start pointer (nullptr if out of memory) </returns>
+		inline void* Allocate(size_t size, size_t align = alignof(max_align_t)) {
+			char* const ptr = liw_align_pointer(m_ptrTop, align);
+			if (m_ptrTop && ptr <= m_ptrEnd && (size_t)(m_ptrEnd - ptr) >= size) {
+				m_ptrTop = ptr + size;
+				return ptr;
+			}
+			return AllocateFromNewChunk(size, align);
+		}
+
+		/// <summary>
+		/// Free all allocations. 
+		/// </summary>
+		inline void Reset() {
+			if (!m_chunk) {
+				return;
+			}
+			if (m_chunk->m_next) { // Grew past one chunk. Replace them with one chunk of the peak size. 
+				const size_t sizeUsed = GetSizeUsed();
+				if (sizeUsed > m_sizeChunk) {
+					m_sizeChunk = sizeUsed;
+				}
+				FreeChunks();
+				return;
+			}
+			m_ptrTop = GetChunkData(m_chunk);
+		}
+
+		/// <summary>
+		/// Get the size in use (allocated or padding) since the last Reset. 
+		/// </summary>
+		inline size_t GetSizeUsed() const {
+			size_t size = m_chunk ? m_ptrTop - GetChunkData(m_chunk) : 0;
+			for (const LIWFiberScratchChunk* chunk = m_chunk ? m_chunk->m_next : nullptr; chunk; chunk = chunk->m_next) {
+				size += chunk->m_sizeUsed;
+			}
+			return size;
+		}
+
+		/// <summary>
+		/// Get the size a chunk is allocated with (grows to the peak usage of a run). 
+		/// </summary>
+		inline size_t GetSizeChunk() const { return m_sizeChunk; }
+
+	public:
+		static const size_t c_sizeDefault = 16 * 1024; // Default initial size of the arena
+
+	private:
+		/// <summary>
+		/// Header of a chunk. Its data follows, aligned to max_align_t. 
+		/// </summary>
+		struct alignas(max_align_t) LIWFiberScratchChunk {
+			LIWFiberScratchChunk* m_next	{ nullptr }; // Previous chunk
+			size_t m_sizeUsed				{ 0 }; // Size used in this chunk when it was left
+		};
+
+		static inline char* GetChunkData(LIWFiberScratchChunk* chunk) { return (char*)(chunk + 1); }
+		static inline const char* GetChunkData(const LIWFiberScratchChunk* chunk) { return (const char*)(chunk + 1); }
+
+		/// <summary>
+		/// Allocate from a new chunk when the current chunk cannot fit the request. 
+		/// </summary>
+		void* AllocateFromNewChunk(size_t size, size_t align) {
+			const size_t sizeRequired = size + (align > alignof(max_align_t) ? align - alignof(max_align_t) : 0); // Chunk data is aligned to max_align_t
+			const size_t sizeData = sizeRequired > m_sizeChunk ? sizeRequired : m_sizeChunk;
+			void* const chunkRaw = malloc(sizeof(LIWFiberScratchChunk) + sizeData);
+			if (!chunkRaw) {
+				return nullptr;
+			}
+			LIWFiberScratchChunk* const chunk = new(chunkRaw) LIWFiberScratchChunk();
+			if (m_chunk) {
+				m_chunk->m_sizeUsed = m_ptrTop - GetChunkData(m_chunk);
+			}
+			chunk->m_next = m_chunk;
+			m_chunk = chunk;
+			char* const ptr = liw_align_pointer(GetChunkData(chunk), align);
+			m_ptrTop = ptr + size;
+			m_ptrEnd = GetChunkData(chunk) + sizeData;
+			return ptr;
+		}
+
+		/// <summary>
+		/// Free all chunks. 
+		/// </summary>
+		inline void FreeChunks() {
+			while (m_chunk) {
+				LIWFiberScratchChunk* const next = m_chunk->m_next;
+				m_chunk->~LIWFiberScratchChunk();
+				free(m_chunk);
+				m_chunk = next;
+			}
+			m_ptrTop = nullptr;
+			m_ptrEnd = nullptr;
+		}
+
+	private:
+		char* m_ptrTop					{ nullptr }; // Pointer to the top of the current chunk. 
+		char* m_ptrEnd					{ nullptr }; // Pointer to the end of the current chunk. 
+		LIWFiberScratchChunk* m_chunk	{ nullptr }; // Current chunk (linked to the previous ones). 
+		size_t m_sizeChunk; // Size of new chunks. 
+	};
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "LIWMemory.h"
+#include "LIWFiberWorker.h"
+
+/*
+* These are the APIs for fiber mode (fiber) of LIW memory management subsystem, with the same names as the other modes (see LIWMemory.h). 
+* Fiber mode allocates from the scratch arena of the running fiber, so malloc/new take the fiber (thisFiber of the runner). 
+* Allocations stay valid across waits and are freed when the run function returns. It has no maintenance functions and is not in LIWMemAllocation. 
+*/
+
+
+//
+// Fiber scratch
+//
+
+inline void* liw_maddr_fiber(liw_hdl_type handle) {
+	return (void*)handle;
+}
+
+template<class T>
+inline void liw_mset_fiber(liw_hdl_type handle, const T& val) {
+	*((T*)handle) = val;
+}
+template<class T>
+inline void liw_mset_fiber(liw_hdl_type handle, T&& val) {
+	*((T*)handle) = val;
+}
+
+template<class T>
+inline T liw_mget_fiber(liw_hdl_type handle) {
+	return std::move(*((T*)handle));
+}
+
+inline liw_hdl_type liw_malloc_fiber(LIW::LIWFiberWorker* thisFiber, liw_memory_size_type size, size_t align = alignof(max_align_t)) {
+	assert(thisFiber); // Inline tasks have no fiber. Use a frame scope (liw_mscope_frame) instead. 
+	return (liw_hdl_type)thisFiber->GetScratch().Allocate(size, align);
+}
+
+inline void liw_free_fiber(liw_hdl_type handle) {
+
+}
+
+template<class T, class ... Args>
+inline liw_hdl_type liw_new_fiber(LIW::LIWFiberWorker* thisFiber, Args&&... args) {
+	T* ptr = (T*)liw_malloc_fiber(thisFiber, sizeof(T), alignof(T));
+	return (liw_hdl_type)(new(ptr)T(std::forward<Args>(args)...));
+}
+
+template<class T>
+inline void liw_delete_fiber(liw_hdl_type handle) {
+	((T*)handle)->~T();
+	liw_free_fiber(handle);
+}
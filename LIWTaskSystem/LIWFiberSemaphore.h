@@ -0,0 +1,95 @@
+#pragma once
+#include <mutex>
+#include <list>
+#include <atomic>
+#include <thread>
+
+#include "LIWFiberCommon.h"
+#include "LIWFiberWorker.h"
+
+namespace LIW {
+	/*
+	* A counting semaphore for fibers.
+	* Spin briefly when no permit is available, then park the fiber until a permit is released.
+	* NOTE: When acquire is called outside fibers (thisFiber == nullptr), the thread yields instead of parking.
+	*/
+	class LIWFiberSemaphore {
+	public:
+		typedef int counter_type;
+	private:
+		typedef std::lock_guard<std::mutex> lock_guard;
+		typedef std::unique_lock<std::mutex> uniq_lock;
+		static const int c_spinCount = 128;
+	public:
+		LIWFiberSemaphore(counter_type count = 0) : m_count(count) {}
+		LIWFiberSemaphore(const LIWFiberSemaphore&) = delete;
+		LIWFiberSemaphore& operator=(const LIWFiberSemaphore&) = delete;
+
+		/// <summary>
+		/// Try to acquire a permit without waiting.
+		/// </summary>
+		/// <returns> Is a permit acquired. </returns>
+		inline bool try_acquire() {
+			counter_type count = m_count.load(std::memory_order_relaxed);
+			while (count > 0) {
+				if (m_count.compare_exchange_weak(count, count - 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					return true;
+			}
+			return false;
+		}
+
+		/// <summary>
+		/// Acquire a permit. Spin briefly, then park the fiber until a permit is released.
+		/// </summary>
+		/// <param name="thisFiber"> fiber calling acquire </param>
+		void acquire(LIWFiberWorker* thisFiber) {
+			while (true) {
+				for (int i = 0; i < c_spinCount; ++i) {
+					if (try_acquire())
+						return;
+				}
+				if (!thisFiber) {
+					std::this_thread::yield();
+					continue;
+				}
+				uniq_lock lk(m_mtxWaiters);
+				m_countWaiters.fetch_add(1, std::memory_order_seq_cst);
+				if (try_acquire()) { // Released while registering
+					m_countWaiters.fetch_sub(1, std::memory_order_relaxed);
+					return;
+				}
+				m_waiters.emplace_back(thisFiber);
+				thisFiber->YieldToMainAndUnlock(*lk.release()); // Awaken by release, then try again
+			}
+		}
+
+		/// <summary>
+		/// Release permit(s). Awake as many parked fibers as permits released.
+		/// </summary>
+		/// <param name="count"> count of permits to release (>0) </param>
+		void release(counter_type count = 1) {
+			m_count.fetch_add(count, std::memory_order_seq_cst);
+			if (m_countWaiters.load(std::memory_order_seq_cst) > 0) {
+				lock_guard lk(m_mtxWaiters);
+				for (counter_type i = 0; i < count && !m_waiters.empty(); ++i) {
+					LIWFiberWorker* fiber = m_waiters.front();
+					m_waiters.pop_front();
+					m_countWaiters.fetch_sub(1, std::memory_order_relaxed);
+					fiber->Awake();
+				}
+			}
+		}
+
+		/// <summary>
+		/// Get count of available permits.
+		/// </summary>
+		/// <returns> count of available permits </returns>
+		inline counter_type GetCount() const { return m_count.load(std::memory_order_relaxed); }
+
+	private:
+		std::atomic<counter_type> m_count; // Available permits
+		std::atomic<int> m_countWaiters{ 0 }; // Count of fibers parked (or about to park)
+		std::mutex m_mtxWaiters; // Guards waiter list
+		std::list<LIWFiberWorker*> m_waiters; // Fibers parked on this semaphore
+	};
+}
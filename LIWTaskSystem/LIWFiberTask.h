@@ -1,9 +1,16 @@
 #pragma once
 #include "LIWFiberCommon.h"
+#include "LIWStats.h"
+#include "LIWTaskTag.h"
 
 namespace LIW {
 	struct LIWFiberTask {
 		LIWFiberRunner m_runner = nullptr;
 		void* m_param = nullptr;
+		const LIWTaskTag* m_tag = nullptr; // Tag for per-tag accounting in pool stats (nullptr means untagged)
+		LIWFiberStackClass m_stackClass = LIWFiberStackClass::Small; // Stack class of the fiber to run on (hint for deep tasks)
+		bool m_isInline = false; // Task never waits (on sync counters, fiber mutexes, channels...) or yields, so it runs right on the worker thread without a fiber. Its runner gets thisFiber == nullptr. 
+		LIWFiberAffinity m_affinity = LIWFiberAffinity::None; // Which worker resumes the fiber of the task after it waits (ignored for inline tasks)
+		LIW_STATS(uint64_t m_nsSubmit = 0;) // Time of submit, stamped by pools for latency stats
 	};
 }
\ No newline at end of file
@@ -9,7 +9,9 @@ LIW::LIWFiberThreadPool::LIWFiberThreadPool():
 
 LIW::LIWFiberThreadPool::~LIWFiberThreadPool()
 {
-
+	for (auto& fiber : m_fibersRegistered) { // Workers have been joined by WaitAndStop/Stop, so no fiber is running
+		delete fiber;
+	}
 }
 
 void LIW::LIWFiberThreadPool::Init(int numWorkers, int numFibers)
@@ -17,32 +19,96 @@ void LIW::LIWFiberThreadPool::Init(int numWorkers, int numFibers)
 	Init(numWorkers, numWorkers, numFibers, numFibers);
 }
 
-void LIW::LIWFiberThreadPool::Init(int minWorkers, int maxWorkers, int minFibers, int maxFibers)
+void LIW::LIWFiberThreadPool::Init(int minWorkers, int maxWorkers, int minFibers, [[maybe_unused]] int maxFibers, size_t stackSize)
+{
+	LIWFiberStackConfig config;
+	config.m_numFibers[(size_t)LIWFiberStackClass::Small] = minFibers;
+	config.m_stackSizes[(size_t)LIWFiberStackClass::Small] = stackSize;
+	Init(minWorkers, maxWorkers, config);
+}
+
+void LIW::LIWFiberThreadPool::Init(int minWorkers, int maxWorkers, const LIWFiberStackConfig& config)
 {
 	//TODO: Make this adaptive somehow
 	m_isRunning = true;
 
-	for (int i = 0; i < minFibers; ++i) {
-		LIWFiberWorker* worker = new LIWFiberWorker(i);
-		m_fibers.push_now(worker);
-		m_fibersRegistered.emplace_back(worker);
+	for (size_t idxClass = 0; idxClass < c_countFiberStackClasses; ++idxClass) {
+		for (int i = 0; i < config.m_numFibers[idxClass]; ++i) {
+			LIWFiberWorker* worker = new LIWFiberWorker((int)m_fibersRegistered.size(), config.m_stackSizes[idxClass]);
+			worker->SetAwakeFunction(AwakeFiberFromWorker, this);
+			m_fibers[idxClass].push_now(worker);
+			m_fibersRegistered.emplace_back(worker);
+			m_fiberStackClasses.emplace_back((uint8_t)idxClass);
+		}
+		m_hasStackClass[idxClass] = config.m_numFibers[idxClass] > 0;
 	}
 
+	m_countWorkers = minWorkers;
+	m_workersLocal.reset(new LIWWorkerLocal[minWorkers]);
+	LIW_STATS(m_workerCounters.reset(new Util::LIWWorkerCounters[minWorkers]));
 	for (int i = 0; i < minWorkers; ++i) {
-		m_workers.emplace_back(ProcessTask, this);
+		m_workers.emplace_back(ProcessTask, this, i);
 	}
 	
 	m_isInit = true;
 }
 
+LIW::Util::LIWLatencyStats LIW::LIWFiberThreadPool::GetLatencyStats() const
+{
+	Util::LIWLatencyStats stats;
+#ifdef LIW_ENABLE_STATS
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		m_workerCounters[i].MergeLatencyInto(stats);
+	}
+#endif
+	return stats;
+}
+
+std::vector<LIW::Util::LIWTagStats> LIW::LIWFiberThreadPool::GetTagStats() const
+{
+	std::vector<Util::LIWTagStats> stats;
+#ifdef LIW_ENABLE_STATS
+	stats = Util::liw_make_tag_stats();
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		m_workerCounters[i].MergeTagsInto(stats);
+	}
+	Util::liw_sort_tag_stats(stats);
+#endif
+	return stats;
+}
+
+std::vector<LIW::Util::LIWFiberStackStats> LIW::LIWFiberThreadPool::GetFiberStackStats() const
+{
+	std::vector<Util::LIWFiberStackStats> stats;
+	for (auto& fiber : m_fibersRegistered) {
+		Util::LIWFiberStackStats statsFiber;
+		statsFiber.m_idFiber = fiber->GetID();
+		statsFiber.m_stackClass = m_fiberStackClasses[fiber->GetID()];
+		statsFiber.m_size = fiber->GetStackSize();
+		statsFiber.m_peak = fiber->GetStackPeak();
+		stats.emplace_back(statsFiber);
+	}
+	return stats;
+}
+
+LIW::Util::LIWPoolStats LIW::LIWFiberThreadPool::GetStats() const
+{
+	Util::LIWPoolStats stats;
+#ifdef LIW_ENABLE_STATS
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		stats.m_workers.emplace_back(m_workerCounters[i].Snapshot());
+	}
+#endif
+	stats.m_tasks = m_tasks.get_stats();
+	stats.m_fibersAwake = m_fibersAwakeList.get_stats();
+	return stats;
+}
+
 void LIW::LIWFiberThreadPool::WaitAndStop()
 {
 	m_isRunning = false;
 	m_tasks.block_till_empty();
 	m_fibersAwakeList.block_till_empty();
-	for (auto& fiber : m_fibersRegistered) {
-		fiber->Stop();
-	}
 	using namespace std::chrono;
 	std::this_thread::sleep_for(1ms);
 	m_tasks.notify_stop();
@@ -51,6 +117,10 @@ void LIW::LIWFiberThreadPool::WaitAndStop()
 	for (int i = 0; i < m_workers.size(); ++i) {
 		m_workers[i].join();
 	}
+	// Stop fibers only once no worker can hand them a task: a stopped fiber leaves its run loop without running it. 
+	for (auto& fiber : m_fibersRegistered) {
+		fiber->Stop();
+	}
 }
 
 void LIW::LIWFiberThreadPool::Stop()
@@ -64,9 +134,6 @@ void LIW::LIWFiberThreadPool::Stop()
 		delete task;
 	}
 
-	for (auto& fiber : m_fibersRegistered) {
-		fiber->Stop();
-	}
 	using namespace std::chrono;
 	std::this_thread::sleep_for(1ms);
 	m_tasks.notify_stop();
@@ -74,57 +141,135 @@ void LIW::LIWFiberThreadPool::Stop()
 	for (int i = 0; i < m_workers.size(); ++i) {
 		m_workers[i].join();
 	}
+	// Stop fibers only once no worker can hand them a task: a stopped fiber leaves its run loop without running it. 
+	for (auto& fiber : m_fibersRegistered) {
+		fiber->Stop();
+	}
 }
 
 LIW::LIWFiberThreadPool::counter_type LIW::LIWFiberThreadPool::DecreaseSyncCounter(counter_size_type idxCounter, counter_type decrease)
 {
 	LIWFiberSyncCounter& counter = m_syncCounters[idxCounter];
-	int val = counter.m_counter.fetch_add(-decrease, std::memory_order_relaxed) - decrease;
+	int val = counter.m_counter.fetch_add(-decrease, std::memory_order_acq_rel) - decrease;
 	if (val <= 0) { // Counter reach 0, move all dependents to awake list
+		LIW_TRACE(Util::LIWTracer::Instant("SyncWake", idxCounter));
 		lock_guard_type lock(counter.m_mtx);
 		while (!counter.m_dependents.empty()) {
-			m_fibersAwakeList.push_now(counter.m_dependents.front());
+			AwakeFiber(counter.m_dependents.front());
 			counter.m_dependents.pop_front();
 		}
 	}
 	return val;
 }
 
-void LIW::LIWFiberThreadPool::ProcessTask(LIWFiberThreadPool* thisTP)
+void LIW::LIWFiberThreadPool::AwakeFiberFromWorker(void* thisTP, LIWFiberWorker* worker)
+{
+	reinterpret_cast<LIWFiberThreadPool*>(thisTP)->AwakeFiber(worker);
+}
+
+void LIW::LIWFiberThreadPool::ProcessTask(LIWFiberThreadPool* thisTP, int idxWorker)
 {
 	LIWFiberMain* fiberMain = LIWFiberMain::InitThreadMainFiber();
-	LIWFiberTask* task = nullptr;
+	LIWFiberTask* task = nullptr; // Task acquired, kept while waiting for an idle fiber of its stack class
 	LIWFiberWorker* fiber = nullptr;
-	while (!thisTP->m_tasks.empty() || 
-		   !thisTP->m_fibersAwakeList.empty() || 
-		   thisTP->m_isRunning) {
+	LIWWorkerLocal& local = thisTP->m_workersLocal[idxWorker];
+	int countPinned = 0; // Fibers pinned to this worker and not finished. Only this worker can resume them, so it stays until they finish. 
+	LIW_STATS(Util::LIWWorkerCounters& counters = thisTP->m_workerCounters[idxWorker]);
+	while (thisTP->m_isRunning || // Check running first: once it reads false, every task submitted before the stop is visible to the empty checks. 
+		   !thisTP->m_tasks.empty() || 
+		   !thisTP->m_fibersAwakeList.empty() ||
+		   task ||
+		   countPinned > 0 ||
+		   thisTP->HasFibersReady()) {
 		fiber = nullptr;
-		if (thisTP->m_fibersAwakeList.pop_now(fiber)) { // Acquire fiber from awake fiber list. 
+		LIW_STATS(const uint64_t tBeg = Util::liw_stats_now_ns(); uint64_t tExec = 0);
+		if (!local.m_fibersPinned.pop_now(fiber) && 
+			!local.m_fibersReady.pop_now(fiber) && 
+			!thisTP->m_fibersAwakeList.pop_now(fiber) && 
+			!task && thisTP->m_tasks.empty()) { // Nothing else to do, steal a fiber awaken for a busy worker
+			fiber = thisTP->StealFiber(idxWorker);
+			LIW_STATS(if (fiber) counters.OnSteal());
+		}
+		if (fiber) { // Acquired fiber from ready queues or awake fiber list. 
 			// Set fiber to perform task
 			fiber->SetMainFiber(fiberMain);
+			fiber->SetWorkerIndex(idxWorker);
 			
 			// Switch to fiber
-			fiberMain->YieldTo(fiber);
+			LIW_STATS(tExec = Util::liw_stats_now_ns(); counters.OnFiberSwitch());
+			LIW_TRACE(Util::LIWTracer::Begin("Fiber", fiber->GetID()));
+			local.m_isBusy.store(true, std::memory_order_relaxed);
+			const LIWFiberState stateFiber = fiberMain->YieldTo(fiber);
+			local.m_isBusy.store(false, std::memory_order_relaxed);
+			LIW_TRACE(Util::LIWTracer::End("Fiber", fiber->GetID()));
 
-			if (fiber->GetState() != LIWFiberState::Running) { // If fiber is not still running (meaning yielded manually), return for reuse. 
-				thisTP->m_fibers.push_now(fiber);
+			if (stateFiber != LIWFiberState::Running) { // If fiber is not still running (meaning yielded manually), return for reuse. 
+				LIW_TRACE(Util::LIWTracer::Instant("TaskEnd", fiber->GetID()));
+				LIW_STATS(counters.OnTaskFinished(fiber->GetTaskAccount(), Util::liw_stats_now_ns()));
+				if (fiber->GetAffinity() == LIWFiberAffinity::Pinned) {
+					--countPinned;
+				}
+				thisTP->ReleaseFiber(fiber);
+			}
+			else {
+				LIW_TRACE(Util::LIWTracer::Instant("FiberYield", fiber->GetID()));
 			}
 		}
-		else if (thisTP->m_fibers.pop_now(fiber)) { // Acquire fiber from idle fiber list. //TODO: Currently this is spinning when empty. Make it wait. 
-			if (thisTP->m_tasks.pop_now(task)) { // Acquite task
+		else if (task || thisTP->m_tasks.pop_now(task)) { // Acquire task (or keep the one acquired before)
+			if (task->m_isInline) { // Run on the worker thread, since the task never yields
+				LIW_STATS(tExec = Util::liw_stats_now_ns(); counters.OnTask(); counters.OnTaskStarted(tExec - task->m_nsSubmit));
+				LIW_STATS(const uint32_t idTag = LIWTaskTag::GetID(task->m_tag); const uint64_t cpuExec = Util::liw_stats_now_cpu());
+				LIW_TRACE(Util::LIWTracer::Begin("Task"));
+				local.m_isBusy.store(true, std::memory_order_relaxed);
+				task->m_runner(nullptr, task->m_param);
+				local.m_isBusy.store(false, std::memory_order_relaxed);
+				LIW_TRACE(Util::LIWTracer::End("Task"));
+				LIW_STATS(const uint64_t cpu = Util::liw_stats_now_cpu() - cpuExec; const uint64_t tEnd = Util::liw_stats_now_ns(); counters.OnTaskFinished(tEnd - tExec); counters.OnTaskAccounted(idTag, tEnd - tExec, tEnd - tExec, cpu));
+				delete task;
+				task = nullptr;
+			}
+			else if ((fiber = thisTP->AcquireFiber(task->m_stackClass)) != nullptr) { // Acquire fiber from idle fiber list of the class. //TODO: Currently this is spinning when none is idle. Make it wait.
 				// Set fiber to perform task
 				fiber->SetMainFiber(fiberMain);
+				fiber->SetWorkerIndex(idxWorker);
+				fiber->SetAffinity(task->m_affinity);
 				fiber->SetRunFunction(task->m_runner, task->m_param);
+				if (task->m_affinity == LIWFiberAffinity::Pinned) {
+					++countPinned;
+				}
 				
 				// Switch to fiber
-				fiberMain->YieldTo(fiber);
+				LIW_STATS(tExec = Util::liw_stats_now_ns(); counters.OnFiberSwitch(); counters.OnTask(); counters.OnTaskStarted(tExec - task->m_nsSubmit); fiber->GetTaskAccount().Reset(LIWTaskTag::GetID(task->m_tag), tExec));
+				LIW_TRACE(Util::LIWTracer::Instant("TaskBegin", fiber->GetID()));
+				LIW_TRACE(Util::LIWTracer::Begin("Fiber", fiber->GetID()));
+				local.m_isBusy.store(true, std::memory_order_relaxed);
+				const LIWFiberState stateFiber = fiberMain->YieldTo(fiber);
+				local.m_isBusy.store(false, std::memory_order_relaxed);
+				LIW_TRACE(Util::LIWTracer::End("Fiber", fiber->GetID()));
 
 				// Delete task, since everything was copied into call stack (fiber).
 				delete task;
-			}
-			if (fiber->GetState() != LIWFiberState::Running) { // If fiber is not still running (meaning yielded manually), return for reuse. 
-				thisTP->m_fibers.push_now(fiber);
+				task = nullptr;
+
+				if (stateFiber != LIWFiberState::Running) { // If fiber is not still running (meaning yielded manually), return for reuse. 
+					LIW_TRACE(Util::LIWTracer::Instant("TaskEnd", fiber->GetID()));
+					LIW_STATS(counters.OnTaskFinished(fiber->GetTaskAccount(), Util::liw_stats_now_ns()));
+					if (fiber->GetAffinity() == LIWFiberAffinity::Pinned) {
+						--countPinned;
+					}
+					thisTP->ReleaseFiber(fiber);
+				}
+				else {
+					LIW_TRACE(Util::LIWTracer::Instant("FiberYield", fiber->GetID()));
+				}
 			}
 		}
+		LIW_STATS(
+			const uint64_t tEnd = Util::liw_stats_now_ns();
+			if (tExec != 0) { counters.OnIdle(tExec - tBeg); counters.OnBusy(tEnd - tExec); }
+			else { counters.OnIdle(tEnd - tBeg); }
+		)
 	}
+	local.m_isBusy.store(true, std::memory_order_relaxed); // Never pops its ready queue again, so fibers awaken for it later may be stolen
+	LIWFiberMain::ReleaseThreadMainFiber(fiberMain);
 }
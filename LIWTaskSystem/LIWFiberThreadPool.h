@@ -3,8 +3,13 @@
 #include <functional>
 #include <vector>
 #include <array>
+#include <memory>
+#include <atomic>
+#include <cassert>
 
 #include "LIWThreadSafeQueue.h"
+#include "LIWStats.h"
+#include "LIWTracer.h"
 #include "LIWFiberTask.h"
 #include "LIWFiberMain.h"
 #include "LIWFiberWorker.h"
@@ -20,10 +25,15 @@ namespace LIW {
 		typedef std::atomic<counter_type> atomic_counter_type;
 		typedef std::lock_guard<std::mutex> lock_guard_type;
 	private:
+		struct LIWWorkerLocal {
+			Util::LIWThreadSafeQueue<LIWFiberWorker*> m_fibersReady; // Awaken fibers preferring this worker (may be stolen)
+			Util::LIWThreadSafeQueue<LIWFiberWorker*> m_fibersPinned; // Awaken fibers pinned to this worker
+			std::atomic<bool> m_isBusy{ false }; // Is the worker running a fiber or task? (Others only steal from busy workers)
+		};
 		struct LIWFiberSyncCounter {
 			friend class LIWFiberThreadPool;
 		private:
-			atomic_counter_type m_counter;
+			atomic_counter_type m_counter{ 0 };
 			std::mutex m_mtx;
 			std::list<LIWFiberWorker*> m_dependents;
 		};
@@ -37,7 +47,22 @@ namespace LIW {
 		/// <param name="numWorkers"> number of workers (threads) </param>
 		/// <param name="numFibers"> number of fibers (shared among threads) </param>
 		void Init(int numWorkers, int numFibers);
-		void Init(int minWorkers, int maxWorkers, int minFibers, int maxFibers);
+		/// <summary>
+		/// Initialize. 
+		/// </summary>
+		/// <param name="minWorkers"> number of minimum workers </param>
+		/// <param name="maxWorkers"> number of maximum workers </param>
+		/// <param name="minFibers"> number of minimum fibers </param>
+		/// <param name="maxFibers"> number of maximum fibers (unused: the pool keeps minFibers fibers) </param>
+		/// <param name="stackSize"> stack size of each fiber (bytes) </param>
+		void Init(int minWorkers, int maxWorkers, int minFibers, int maxFibers, size_t stackSize = LIWFiberWorker::c_stackSizeDefault);
+		/// <summary>
+		/// Initialize with fibers of several stack classes. Tasks run on fibers of the class they hint (LIWFiberTask::m_stackClass). 
+		/// </summary>
+		/// <param name="minWorkers"> number of minimum workers </param>
+		/// <param name="maxWorkers"> number of maximum workers </param>
+		/// <param name="config"> count and stack size of fibers of each class </param>
+		void Init(int minWorkers, int maxWorkers, const LIWFiberStackConfig& config);
 
 		/// <summary>
 		/// Is thread pool initialized? 
@@ -51,13 +76,41 @@ namespace LIW {
 		inline bool IsRunning() const { return m_isRunning; }
 
 		inline size_type GetTaskCount() const { return m_tasks.size(); }
+		/// <summary>
+		/// Get a snapshot of pool stats. (All zero unless LIW_ENABLE_STATS is defined)
+		/// </summary>
+		/// <returns> pool stats </returns>
+		Util::LIWPoolStats GetStats() const;
+		/// <summary>
+		/// Get a snapshot of task latencies (submit to start, start to finish), merged from all workers. (Empty unless LIW_ENABLE_STATS is defined)
+		/// Start to finish includes time the fiber spent parked. 
+		/// </summary>
+		/// <returns> latency stats </returns>
+		Util::LIWLatencyStats GetLatencyStats() const;
+		/// <summary>
+		/// Get a snapshot of per-tag accounting (count, wall time, running time, CPU time), merged from all workers and sorted by running time (descending). 
+		/// (Empty unless LIW_ENABLE_STATS is defined) Write it with Util::liw_write_tag_report. 
+		/// </summary>
+		/// <returns> stats of tags with at least one finished task </returns>
+		std::vector<Util::LIWTagStats> GetTagStats() const;
+		/// <summary>
+		/// Get size and peak usage of the stack of every fiber, to right-size stacks. (Peak is 0 unless LIW_ENABLE_STATS is defined) 
+		/// Call when no fiber is running, e.g. after WaitAndStop. 
+		/// </summary>
+		/// <returns> stack stats of fibers </returns>
+		std::vector<Util::LIWFiberStackStats> GetFiberStackStats() const;
 
 		/// <summary>
 		/// Submit task for the thread pool to execute. 
+		/// Fails if the pool has no fibers of the stack class the task hints (unless the task is inline). 
 		/// </summary>
 		/// <param name="task"> task to execute </param>
 		/// <returns> is operation successful? </returns>
 		inline bool Submit(LIWFiberTask* task) {
+			if (!task->m_isInline && !m_hasStackClass[(size_t)task->m_stackClass]) {
+				return false;
+			}
+			LIW_STATS(task->m_nsSubmit = Util::liw_stats_now_ns());
 			m_tasks.push_now(task);
 			return true;
 		}
@@ -76,6 +129,21 @@ namespace LIW {
 		* Fiber task waiting
 		*/
 		
+		/// <summary>
+		/// Awake a parked fiber worker by putting it into awake list, or the ready queue of the worker which last ran it (by its affinity). 
+		/// </summary>
+		/// <param name="worker"> fiber worker to awake </param>
+		/// <returns> is operation successful? </returns>
+		inline bool AwakeFiber(LIWFiberWorker* worker) {
+			switch (worker->GetAffinity()) {
+			case LIWFiberAffinity::Preferred:
+				return m_workersLocal[worker->GetWorkerIndex()].m_fibersReady.push_now(worker);
+			case LIWFiberAffinity::Pinned:
+				return m_workersLocal[worker->GetWorkerIndex()].m_fibersPinned.push_now(worker);
+			default:
+				return m_fibersAwakeList.push_now(worker);
+			}
+		}
 		/// <summary>
 		/// Add a fiber worker as the dependency of a sync counter. 
 		/// </summary>
@@ -83,12 +151,29 @@ namespace LIW {
 		/// <param name="worker"> dependent fiber worker </param>
 		/// <returns> is operation successful? </returns>
 		inline bool AddDependencyToSyncCounter(counter_size_type idxCounter, LIWFiberWorker* worker) {
+			LIW_TRACE(Util::LIWTracer::Instant("SyncWait", idxCounter));
 			LIWFiberSyncCounter& counter = m_syncCounters[idxCounter];
 			lock_guard_type lk(counter.m_mtx);
 			counter.m_dependents.emplace_back(worker);
 			return true;
 		}
 		/// <summary>
+		/// Park a fiber until a sync counter reaches 0. Return immediately if it is already 0. 
+		/// Unlike AddDependencyToSyncCounter followed by YieldToMain, the fiber cannot be awaken before it is switched out. 
+		/// </summary>
+		/// <param name="idxCounter"> index of the sync counter </param>
+		/// <param name="thisFiber"> fiber calling wait </param>
+		inline void WaitForSyncCounter(counter_size_type idxCounter, LIWFiberWorker* thisFiber) {
+			assert(thisFiber); // Must be called inside a fiber (not from an inline task)
+			LIWFiberSyncCounter& counter = m_syncCounters[idxCounter];
+			std::unique_lock<std::mutex> lk(counter.m_mtx);
+			if (counter.m_counter.load(std::memory_order_acquire) <= 0)
+				return;
+			LIW_TRACE(Util::LIWTracer::Instant("SyncWait", idxCounter));
+			counter.m_dependents.emplace_back(thisFiber);
+			thisFiber->YieldToMainAndUnlock(*lk.release()); // Awaken by DecreaseSyncCounter
+		}
+		/// <summary>
 		/// Increase a sync counter. 
 		/// </summary>
 		/// <param name="idxCounter"> index of the sync counter </param>
@@ -114,26 +199,86 @@ namespace LIW {
 			return m_syncCounters[idxCounter].m_counter.load(std::memory_order_relaxed);
 		}
 
+	private:
+		/// <summary>
+		/// Acquire an idle fiber of stackClass, or of the class one step up if none of stackClass is idle. 
+		/// Classes further up are left to the tasks which need them. 
+		/// </summary>
+		/// <param name="stackClass"> stack class hinted by the task (with fibers) </param>
+		/// <returns> idle fiber, or nullptr if there is none </returns>
+		inline LIWFiberWorker* AcquireFiber(LIWFiberStackClass stackClass) {
+			LIWFiberWorker* fiber = nullptr;
+			const size_t idxClass = (size_t)stackClass;
+			if (m_fibers[idxClass].pop_now(fiber))
+				return fiber;
+			if (idxClass + 1 < c_countFiberStackClasses && m_fibers[idxClass + 1].pop_now(fiber))
+				return fiber;
+			return nullptr;
+		}
+		/// <summary>
+		/// Return a fiber to the idle list of its class. 
+		/// </summary>
+		/// <param name="fiber"> idle fiber </param>
+		inline void ReleaseFiber(LIWFiberWorker* fiber) {
+			m_fibers[m_fiberStackClasses[fiber->GetID()]].push_now(fiber);
+		}
+		/// <summary>
+		/// Steal an awaken fiber from the ready queue of another worker, which is busy. 
+		/// </summary>
+		/// <param name="idxWorker"> index of the stealing worker </param>
+		/// <returns> stolen fiber, or nullptr if there is none </returns>
+		inline LIWFiberWorker* StealFiber(int idxWorker) {
+			LIWFiberWorker* fiber = nullptr;
+			for (int i = 1; i < m_countWorkers; ++i) {
+				LIWWorkerLocal& local = m_workersLocal[(idxWorker + i) % m_countWorkers];
+				if (local.m_isBusy.load(std::memory_order_relaxed) && local.m_fibersReady.pop_now(fiber))
+					return fiber;
+			}
+			return nullptr;
+		}
+		/// <summary>
+		/// Is any awaken fiber left in the ready queue of a worker? 
+		/// </summary>
+		inline bool HasFibersReady() const {
+			for (int i = 0; i < m_countWorkers; ++i) {
+				if (!m_workersLocal[i].m_fibersReady.empty())
+					return true;
+			}
+			return false;
+		}
+
 	private:
 		// Fiber Management
-		Util::LIWThreadSafeQueue<LIWFiberWorker*> m_fibers;
+		Util::LIWThreadSafeQueue<LIWFiberWorker*> m_fibers[c_countFiberStackClasses]; // Idle fibers of each stack class
 		std::vector<LIWFiberWorker*> m_fibersRegistered;
+		std::vector<uint8_t> m_fiberStackClasses; // Stack class of each fiber, by ID
+		bool m_hasStackClass[c_countFiberStackClasses] = {}; // Does the pool have fibers of each stack class?
 		// Fiber waiting Management
 		Util::LIWThreadSafeQueue<LIWFiberWorker*> m_fibersAwakeList;
 		std::array<LIWFiberSyncCounter, 1024> m_syncCounters;
 		// Worker threads
 		std::vector<std::thread> m_workers;
+		int m_countWorkers = 0;
+		std::unique_ptr<LIWWorkerLocal[]> m_workersLocal; // Ready queues of each worker
 		// Task queue
 		Util::LIWThreadSafeQueue<LIWFiberTask*> m_tasks;
+		// Stats
+		LIW_STATS(std::unique_ptr<Util::LIWWorkerCounters[]> m_workerCounters;)
 
 	private:
 		/// <summary>
 		/// Loop function to process task. 
 		/// </summary>
-		static void ProcessTask(LIWFiberThreadPool* thisTP);
+		/// <param name="thisTP"> the pool </param>
+		/// <param name="idxWorker"> index of the worker running the loop </param>
+		static void ProcessTask(LIWFiberThreadPool* thisTP, int idxWorker);
+		/// <summary>
+		/// Awake function registered to fiber workers of this pool. 
+		/// </summary>
+		static void AwakeFiberFromWorker(void* thisTP, LIWFiberWorker* worker);
 
 	private:
-		bool m_isRunning;
+		std::atomic<bool> m_isRunning;
 		bool m_isInit;
 	};
 }
@@ -3,8 +3,13 @@
 #include <functional>
 #include <vector>
 #include <array>
+#include <memory>
+#include <atomic>
+#include <cassert>
 
 #include "LIWThreadSafeQueueSized.h"
+#include "LIWStats.h"
+#include "LIWTracer.h"
 #include "LIWFiberTask.h"
 #include "LIWFiberMain.h"
 #include "LIWFiberWorker.h"
@@ -28,10 +33,15 @@ namespace LIW {
 		typedef std::atomic<counter_type> atomic_counter_type;
 		typedef std::lock_guard<std::mutex> lock_guard_type;
 	private:
+		struct LIWWorkerLocal {
+			awake_fiber_queue_type m_fibersReady; // Awaken fibers preferring this worker (may be stolen)
+			awake_fiber_queue_type m_fibersPinned; // Awaken fibers pinned to this worker
+			std::atomic<bool> m_isBusy{ false }; // Is the worker running a fiber or task? (Others only steal from busy workers)
+		};
 		struct LIWFiberSyncCounter {
 			friend class LIWFiberThreadPoolSized;
 		private:
-			atomic_counter_type m_counter;
+			atomic_counter_type m_counter{ 0 };
 			std::mutex m_mtx;
 			std::list<LIWFiberWorker*> m_dependents;
 		};
@@ -40,29 +50,63 @@ namespace LIW {
 
 	public:
 		LIWFiberThreadPoolSized() :
-			m_isRunning(false), m_isInit(false) {}
-		virtual ~LIWFiberThreadPoolSized() {}
+			m_isRunning(false), m_isInit(false) {
+			m_fibersRegistered.fill(nullptr);
+			m_fiberStackClasses.fill(0);
+		}
+		virtual ~LIWFiberThreadPoolSized() {
+			for (auto& fiber : m_fibersRegistered) { // Workers have been joined by WaitAndStop/Stop, so no fiber is running
+				delete fiber;
+			}
+		}
 
 		/// <summary>
 		/// Initialize. 
 		/// </summary>
 		/// <param name="numWorkers"> number of workers (threads) </param>
-		/// <param name="numFibers"> number of fibers (shared among threads) </param>
 		void Init(int numWorkers) {
 			Init(numWorkers, numWorkers);
 		}
-		void Init(int minWorkers, int maxWorkers) {
+		/// <summary>
+		/// Initialize. 
+		/// </summary>
+		/// <param name="minWorkers"> number of minimum workers </param>
+		/// <param name="maxWorkers"> number of maximum workers </param>
+		/// <param name="stackSize"> stack size of each fiber (bytes) </param>
+		void Init(int minWorkers, int maxWorkers, size_t stackSize = LIWFiberWorker::c_stackSizeDefault) {
+			LIWFiberStackConfig config;
+			config.m_numFibers[(size_t)LIWFiberStackClass::Small] = (int)FiberSize;
+			config.m_stackSizes[(size_t)LIWFiberStackClass::Small] = stackSize;
+			Init(minWorkers, maxWorkers, config);
+		}
+		/// <summary>
+		/// Initialize with fibers of several stack classes. Tasks run on fibers of the class they hint (LIWFiberTask::m_stackClass). 
+		/// </summary>
+		/// <param name="minWorkers"> number of minimum workers </param>
+		/// <param name="maxWorkers"> number of maximum workers </param>
+		/// <param name="config"> count and stack size of fibers of each class (FiberSize fibers at most in total) </param>
+		void Init(int minWorkers, int maxWorkers, const LIWFiberStackConfig& config) {
 			//TODO: Make this adaptive somehow
 			m_isRunning = true;
 
-			for (size_type i = 0; i < FiberSize; ++i) {
-				LIWFiberWorker* worker = new LIWFiberWorker(i);
-				m_fibers.push_now(worker);
-				m_fibersRegistered[i] = worker;
+			size_type countFibers = 0;
+			for (size_t idxClass = 0; idxClass < c_countFiberStackClasses; ++idxClass) {
+				for (int i = 0; i < config.m_numFibers[idxClass] && countFibers < FiberSize; ++i) {
+					LIWFiberWorker* worker = new LIWFiberWorker((int)countFibers, config.m_stackSizes[idxClass]);
+					worker->SetAwakeFunction(AwakeFiberFromWorker, this);
+					m_fibers[idxClass].push_now(worker);
+					m_fibersRegistered[countFibers] = worker;
+					m_fiberStackClasses[countFibers] = (uint8_t)idxClass;
+					++countFibers;
+					m_hasStackClass[idxClass] = true;
+				}
 			}
 
+			m_countWorkers = minWorkers;
+			m_workersLocal.reset(new LIWWorkerLocal[minWorkers]);
+			LIW_STATS(m_workerCounters.reset(new Util::LIWWorkerCounters[minWorkers]));
 			for (int i = 0; i < minWorkers; ++i) {
-				m_workers.emplace_back(ProcessTask, this);
+				m_workers.emplace_back(ProcessTask, this, i);
 			}
 
 			m_isInit = true;
@@ -80,13 +124,82 @@ namespace LIW {
 		inline bool IsRunning() const { return m_isRunning; }
 
 		inline size_type GetTaskCount() const { return m_tasks.size(); }
+		/// <summary>
+		/// Get a snapshot of pool stats. (All zero unless LIW_ENABLE_STATS is defined)
+		/// </summary>
+		/// <returns> pool stats </returns>
+		Util::LIWPoolStats GetStats() const {
+			Util::LIWPoolStats stats;
+#ifdef LIW_ENABLE_STATS
+			for (size_t i = 0; i < m_workers.size(); ++i) {
+				stats.m_workers.emplace_back(m_workerCounters[i].Snapshot());
+			}
+#endif
+			stats.m_tasks = m_tasks.get_stats();
+			stats.m_fibersAwake = m_fibersAwakeList.get_stats();
+			return stats;
+		}
+		/// <summary>
+		/// Get a snapshot of task latencies (submit to start, start to finish), merged from all workers. (Empty unless LIW_ENABLE_STATS is defined)
+		/// Start to finish includes time the fiber spent parked. 
+		/// </summary>
+		/// <returns> latency stats </returns>
+		Util::LIWLatencyStats GetLatencyStats() const {
+			Util::LIWLatencyStats stats;
+#ifdef LIW_ENABLE_STATS
+			for (size_t i = 0; i < m_workers.size(); ++i) {
+				m_workerCounters[i].MergeLatencyInto(stats);
+			}
+#endif
+			return stats;
+		}
+		/// <summary>
+		/// Get a snapshot of per-tag accounting (count, wall time, running time, CPU time), merged from all workers and sorted by running time (descending). 
+		/// (Empty unless LIW_ENABLE_STATS is defined) Write it with Util::liw_write_tag_report. 
+		/// </summary>
+		/// <returns> stats of tags with at least one finished task </returns>
+		std::vector<Util::LIWTagStats> GetTagStats() const {
+			std::vector<Util::LIWTagStats> stats;
+#ifdef LIW_ENABLE_STATS
+			stats = Util::liw_make_tag_stats();
+			for (size_t i = 0; i < m_workers.size(); ++i) {
+				m_workerCounters[i].MergeTagsInto(stats);
+			}
+			Util::liw_sort_tag_stats(stats);
+#endif
+			return stats;
+		}
+		/// <summary>
+		/// Get size and peak usage of the stack of every fiber, to right-size stacks. (Peak is 0 unless LIW_ENABLE_STATS is defined) 
+		/// Call when no fiber is running, e.g. after WaitAndStop. 
+		/// </summary>
+		/// <returns> stack stats of fibers </returns>
+		std::vector<Util::LIWFiberStackStats> GetFiberStackStats() const {
+			std::vector<Util::LIWFiberStackStats> stats;
+			for (auto& fiber : m_fibersRegistered) {
+				if (!fiber)
+					continue;
+				Util::LIWFiberStackStats statsFiber;
+				statsFiber.m_idFiber = fiber->GetID();
+				statsFiber.m_stackClass = m_fiberStackClasses[fiber->GetID()];
+				statsFiber.m_size = fiber->GetStackSize();
+				statsFiber.m_peak = fiber->GetStackPeak();
+				stats.emplace_back(statsFiber);
+			}
+			return stats;
+		}
 
 		/// <summary>
 		/// Submit task for the thread pool to execute. 
+		/// Fails if the pool has no fibers of the stack class the task hints (unless the task is inline). 
 		/// </summary>
 		/// <param name="task"> task to execute </param>
 		/// <returns> is operation successful? </returns>
 		inline bool Submit(LIWFiberTask* task) {
+			if (!task->m_isInline && !m_hasStackClass[(size_t)task->m_stackClass]) {
+				return false;
+			}
+			LIW_STATS(task->m_nsSubmit = Util::liw_stats_now_ns());
 			return m_tasks.push_now(task);
 		}
 
@@ -97,9 +210,6 @@ namespace LIW {
 			m_isRunning = false;
 			m_tasks.block_till_empty();
 			m_fibersAwakeList.block_till_empty();
-			for (auto& fiber : m_fibersRegistered) {
-				fiber->Stop();
-			}
 			using namespace std::chrono;
 			std::this_thread::sleep_for(1ms);
 			m_tasks.notify_stop();
@@ -108,6 +218,11 @@ namespace LIW {
 			for (int i = 0; i < m_workers.size(); ++i) {
 				m_workers[i].join();
 			}
+			// Stop fibers only once no worker can hand them a task: a stopped fiber leaves its run loop without running it. 
+			for (auto& fiber : m_fibersRegistered) {
+				if (fiber)
+					fiber->Stop();
+			}
 		}
 		/// <summary>
 		/// Stop after execution of currently executing tasks. Ignore others enqueued. 
@@ -122,9 +237,6 @@ namespace LIW {
 				delete task;
 			}
 
-			for (auto& fiber : m_fibersRegistered) {
-				fiber->Stop();
-			}
 			using namespace std::chrono;
 			std::this_thread::sleep_for(1ms);
 			m_tasks.notify_stop();
@@ -132,6 +244,11 @@ namespace LIW {
 			for (int i = 0; i < m_workers.size(); ++i) {
 				m_workers[i].join();
 			}
+			// Stop fibers only once no worker can hand them a task: a stopped fiber leaves its run loop without running it. 
+			for (auto& fiber : m_fibersRegistered) {
+				if (fiber)
+					fiber->Stop();
+			}
 		}
 
 
@@ -139,6 +256,21 @@ namespace LIW {
 		* Fiber task waiting
 		*/
 		
+		/// <summary>
+		/// Awake a parked fiber worker by putting it into awake list, or the ready queue of the worker which last ran it (by its affinity). 
+		/// </summary>
+		/// <param name="worker"> fiber worker to awake </param>
+		/// <returns> is operation successful? </returns>
+		inline bool AwakeFiber(LIWFiberWorker* worker) {
+			switch (worker->GetAffinity()) {
+			case LIWFiberAffinity::Preferred:
+				return m_workersLocal[worker->GetWorkerIndex()].m_fibersReady.push_now(worker);
+			case LIWFiberAffinity::Pinned:
+				return m_workersLocal[worker->GetWorkerIndex()].m_fibersPinned.push_now(worker);
+			default:
+				return m_fibersAwakeList.push_now(worker);
+			}
+		}
 		/// <summary>
 		/// Add a fiber worker as the dependency of a sync counter. 
 		/// </summary>
@@ -146,12 +278,29 @@ namespace LIW {
 		/// <param name="worker"> dependent fiber worker </param>
 		/// <returns> is operation successful? </returns>
 		inline bool AddDependencyToSyncCounter(counter_size_type idxCounter, LIWFiberWorker* worker) {
+			LIW_TRACE(Util::LIWTracer::Instant("SyncWait", idxCounter));
 			LIWFiberSyncCounter& counter = m_syncCounters[idxCounter];
 			lock_guard_type lk(counter.m_mtx);
 			counter.m_dependents.emplace_back(worker);
 			return true;
 		}
 		/// <summary>
+		/// Park a fiber until a sync counter reaches 0. Return immediately if it is already 0. 
+		/// Unlike AddDependencyToSyncCounter followed by YieldToMain, the fiber cannot be awaken before it is switched out. 
+		/// </summary>
+		/// <param name="idxCounter"> index of the sync counter </param>
+		/// <param name="thisFiber"> fiber calling wait </param>
+		inline void WaitForSyncCounter(counter_size_type idxCounter, LIWFiberWorker* thisFiber) {
+			assert(thisFiber); // Must be called inside a fiber (not from an inline task)
+			LIWFiberSyncCounter& counter = m_syncCounters[idxCounter];
+			std::unique_lock<std::mutex> lk(counter.m_mtx);
+			if (counter.m_counter.load(std::memory_order_acquire) <= 0)
+				return;
+			LIW_TRACE(Util::LIWTracer::Instant("SyncWait", idxCounter));
+			counter.m_dependents.emplace_back(thisFiber);
+			thisFiber->YieldToMainAndUnlock(*lk.release()); // Awaken by DecreaseSyncCounter
+		}
+		/// <summary>
 		/// Increase a sync counter. 
 		/// </summary>
 		/// <param name="idxCounter"> index of the sync counter </param>
@@ -169,11 +318,12 @@ namespace LIW {
 		/// <returns> sync counter after decrement </returns>
 		counter_type DecreaseSyncCounter(counter_size_type idxCounter, counter_type decrease = 1) {
 			LIWFiberSyncCounter& counter = m_syncCounters[idxCounter];
-			int val = counter.m_counter.fetch_add(-decrease, std::memory_order_relaxed) - decrease;
+			int val = counter.m_counter.fetch_add(-decrease, std::memory_order_acq_rel) - decrease;
 			if (val <= 0) { // Counter reach 0, move all dependents to awake list
+				LIW_TRACE(Util::LIWTracer::Instant("SyncWake", idxCounter));
 				lock_guard_type lock(counter.m_mtx);
 				while (!counter.m_dependents.empty()) {
-					m_fibersAwakeList.push_now(counter.m_dependents.front());
+					AwakeFiber(counter.m_dependents.front());
 					counter.m_dependents.pop_front();
 				}
 			}
@@ -188,62 +338,193 @@ namespace LIW {
 			return m_syncCounters[idxCounter].m_counter.load(std::memory_order_relaxed);
 		}
 
+	private:
+		/// <summary>
+		/// Acquire an idle fiber of stackClass, or of the class one step up if none of stackClass is idle. 
+		/// Classes further up are left to the tasks which need them. 
+		/// </summary>
+		/// <param name="stackClass"> stack class hinted by the task (with fibers) </param>
+		/// <returns> idle fiber, or nullptr if there is none </returns>
+		inline LIWFiberWorker* AcquireFiber(LIWFiberStackClass stackClass) {
+			LIWFiberWorker* fiber = nullptr;
+			const size_t idxClass = (size_t)stackClass;
+			if (m_fibers[idxClass].pop_now(fiber))
+				return fiber;
+			if (idxClass + 1 < c_countFiberStackClasses && m_fibers[idxClass + 1].pop_now(fiber))
+				return fiber;
+			return nullptr;
+		}
+		/// <summary>
+		/// Return a fiber to the idle list of its class. 
+		/// </summary>
+		/// <param name="fiber"> idle fiber </param>
+		inline void ReleaseFiber(LIWFiberWorker* fiber) {
+			m_fibers[m_fiberStackClasses[fiber->GetID()]].push_now(fiber);
+		}
+		/// <summary>
+		/// Steal an awaken fiber from the ready queue of another worker, which is busy. 
+		/// </summary>
+		/// <param name="idxWorker"> index of the stealing worker </param>
+		/// <returns> stolen fiber, or nullptr if there is none </returns>
+		inline LIWFiberWorker* StealFiber(int idxWorker) {
+			LIWFiberWorker* fiber = nullptr;
+			for (int i = 1; i < m_countWorkers; ++i) {
+				LIWWorkerLocal& local = m_workersLocal[(idxWorker + i) % m_countWorkers];
+				if (local.m_isBusy.load(std::memory_order_relaxed) && local.m_fibersReady.pop_now(fiber))
+					return fiber;
+			}
+			return nullptr;
+		}
+		/// <summary>
+		/// Is any awaken fiber left in the ready queue of a worker? 
+		/// </summary>
+		inline bool HasFibersReady() const {
+			for (int i = 0; i < m_countWorkers; ++i) {
+				if (!m_workersLocal[i].m_fibersReady.empty())
+					return true;
+			}
+			return false;
+		}
+
 	private:
 		// Fiber Management
-		fiber_queue_type m_fibers;
+		fiber_queue_type m_fibers[c_countFiberStackClasses]; // Idle fibers of each stack class
 		fiber_array_type m_fibersRegistered;
+		std::array<uint8_t, FiberSize> m_fiberStackClasses; // Stack class of each fiber, by ID
+		bool m_hasStackClass[c_countFiberStackClasses] = {}; // Does the pool have fibers of each stack class?
 		// Fiber waiting Management
 		awake_fiber_queue_type m_fibersAwakeList;
 		sync_counter_array_type m_syncCounters;
 		// Worker threads
 		std::vector<std::thread> m_workers;
+		int m_countWorkers = 0;
+		std::unique_ptr<LIWWorkerLocal[]> m_workersLocal; // Ready queues of each worker
 		// Task queue
 		task_queue_type m_tasks;
+		// Stats
+		LIW_STATS(std::unique_ptr<Util::LIWWorkerCounters[]> m_workerCounters;)
 
 	private:
 		/// <summary>
 		/// Loop function to process task. 
 		/// </summary>
-		static void ProcessTask(LIWFiberThreadPoolSized* thisTP) {
+		/// <param name="thisTP"> the pool </param>
+		/// <param name="idxWorker"> index of the worker running the loop </param>
+		static void ProcessTask(LIWFiberThreadPoolSized* thisTP, int idxWorker) {
 			LIWFiberMain* fiberMain = LIWFiberMain::InitThreadMainFiber();
-			LIWFiberTask* task = nullptr;
+			LIWFiberTask* task = nullptr; // Task acquired, kept while waiting for an idle fiber of its stack class
 			LIWFiberWorker* fiber = nullptr;
-			while (!thisTP->m_tasks.empty() ||
-				!thisTP->m_fibersAwakeList.empty() ||
-				thisTP->m_isRunning) {
+			LIWWorkerLocal& local = thisTP->m_workersLocal[idxWorker];
+			int countPinned = 0; // Fibers pinned to this worker and not finished. Only this worker can resume them, so it stays until they finish. 
+			LIW_STATS(Util::LIWWorkerCounters& counters = thisTP->m_workerCounters[idxWorker]);
+			while (thisTP->m_isRunning || // Check running first: once it reads false, every task submitted before the stop is visible to the empty checks. 
+				   !thisTP->m_tasks.empty() || 
+				   !thisTP->m_fibersAwakeList.empty() ||
+				   task ||
+				   countPinned > 0 ||
+				   thisTP->HasFibersReady()) {
 				fiber = nullptr;
-				if (thisTP->m_fibersAwakeList.pop_now(fiber)) { // Acquire fiber from awake fiber list. 
+				LIW_STATS(const uint64_t tBeg = Util::liw_stats_now_ns(); uint64_t tExec = 0);
+				if (!local.m_fibersPinned.pop_now(fiber) && 
+					!local.m_fibersReady.pop_now(fiber) && 
+					!thisTP->m_fibersAwakeList.pop_now(fiber) && 
+					!task && thisTP->m_tasks.empty()) { // Nothing else to do, steal a fiber awaken for a busy worker
+					fiber = thisTP->StealFiber(idxWorker);
+					LIW_STATS(if (fiber) counters.OnSteal());
+				}
+				if (fiber) { // Acquired fiber from ready queues or awake fiber list. 
 					// Set fiber to perform task
 					fiber->SetMainFiber(fiberMain);
+					fiber->SetWorkerIndex(idxWorker);
 
 					// Switch to fiber
-					fiberMain->YieldTo(fiber);
+					LIW_STATS(tExec = Util::liw_stats_now_ns(); counters.OnFiberSwitch());
+					LIW_TRACE(Util::LIWTracer::Begin("Fiber", fiber->GetID()));
+					local.m_isBusy.store(true, std::memory_order_relaxed);
+					const LIWFiberState stateFiber = fiberMain->YieldTo(fiber);
+					local.m_isBusy.store(false, std::memory_order_relaxed);
+					LIW_TRACE(Util::LIWTracer::End("Fiber", fiber->GetID()));
 
-					if (fiber->GetState() != LIWFiberState::Running) { // If fiber is not still running (meaning yielded manually), return for reuse. 
-						thisTP->m_fibers.push_now(fiber);
+					if (stateFiber != LIWFiberState::Running) { // If fiber is not still running (meaning yielded manually), return for reuse. 
+						LIW_TRACE(Util::LIWTracer::Instant("TaskEnd", fiber->GetID()));
+						LIW_STATS(counters.OnTaskFinished(fiber->GetTaskAccount(), Util::liw_stats_now_ns()));
+						if (fiber->GetAffinity() == LIWFiberAffinity::Pinned) {
+							--countPinned;
+						}
+						thisTP->ReleaseFiber(fiber);
+					}
+					else {
+						LIW_TRACE(Util::LIWTracer::Instant("FiberYield", fiber->GetID()));
 					}
 				}
-				else if (thisTP->m_fibers.pop_now(fiber)) { // Acquire fiber from idle fiber list. //TODO: Currently this is spinning when empty. Make it wait. 
-					if (thisTP->m_tasks.pop_now(task)) { // Acquite task
+				else if (task || thisTP->m_tasks.pop_now(task)) { // Acquire task (or keep the one acquired before)
+					if (task->m_isInline) { // Run on the worker thread, since the task never yields
+						LIW_STATS(tExec = Util::liw_stats_now_ns(); counters.OnTask(); counters.OnTaskStarted(tExec - task->m_nsSubmit));
+						LIW_STATS(const uint32_t idTag = LIWTaskTag::GetID(task->m_tag); const uint64_t cpuExec = Util::liw_stats_now_cpu());
+						LIW_TRACE(Util::LIWTracer::Begin("Task"));
+						local.m_isBusy.store(true, std::memory_order_relaxed);
+						task->m_runner(nullptr, task->m_param);
+						local.m_isBusy.store(false, std::memory_order_relaxed);
+						LIW_TRACE(Util::LIWTracer::End("Task"));
+						LIW_STATS(const uint64_t cpu = Util::liw_stats_now_cpu() - cpuExec; const uint64_t tEnd = Util::liw_stats_now_ns(); counters.OnTaskFinished(tEnd - tExec); counters.OnTaskAccounted(idTag, tEnd - tExec, tEnd - tExec, cpu));
+						delete task;
+						task = nullptr;
+					}
+					else if ((fiber = thisTP->AcquireFiber(task->m_stackClass)) != nullptr) { // Acquire fiber from idle fiber list of the class. //TODO: Currently this is spinning when none is idle. Make it wait.
 						// Set fiber to perform task
 						fiber->SetMainFiber(fiberMain);
+						fiber->SetWorkerIndex(idxWorker);
+						fiber->SetAffinity(task->m_affinity);
 						fiber->SetRunFunction(task->m_runner, task->m_param);
+						if (task->m_affinity == LIWFiberAffinity::Pinned) {
+							++countPinned;
+						}
 
 						// Switch to fiber
-						fiberMain->YieldTo(fiber);
+						LIW_STATS(tExec = Util::liw_stats_now_ns(); counters.OnFiberSwitch(); counters.OnTask(); counters.OnTaskStarted(tExec - task->m_nsSubmit); fiber->GetTaskAccount().Reset(LIWTaskTag::GetID(task->m_tag), tExec));
+						LIW_TRACE(Util::LIWTracer::Instant("TaskBegin", fiber->GetID()));
+						LIW_TRACE(Util::LIWTracer::Begin("Fiber", fiber->GetID()));
+						local.m_isBusy.store(true, std::memory_order_relaxed);
+						const LIWFiberState stateFiber = fiberMain->YieldTo(fiber);
+						local.m_isBusy.store(false, std::memory_order_relaxed);
+						LIW_TRACE(Util::LIWTracer::End("Fiber", fiber->GetID()));
 
 						// Delete task, since everything was copied into call stack (fiber).
 						delete task;
-					}
-					if (fiber->GetState() != LIWFiberState::Running) { // If fiber is not still running (meaning yielded manually), return for reuse. 
-						thisTP->m_fibers.push_now(fiber);
+						task = nullptr;
+
+						if (stateFiber != LIWFiberState::Running) { // If fiber is not still running (meaning yielded manually), return for reuse. 
+							LIW_TRACE(Util::LIWTracer::Instant("TaskEnd", fiber->GetID()));
+							LIW_STATS(counters.OnTaskFinished(fiber->GetTaskAccount(), Util::liw_stats_now_ns()));
+							if (fiber->GetAffinity() == LIWFiberAffinity::Pinned) {
+								--countPinned;
+							}
+							thisTP->ReleaseFiber(fiber);
+						}
+						else {
+							LIW_TRACE(Util::LIWTracer::Instant("FiberYield", fiber->GetID()));
+						}
 					}
 				}
+				LIW_STATS(
+					const uint64_t tEnd = Util::liw_stats_now_ns();
+					if (tExec != 0) { counters.OnIdle(tExec - tBeg); counters.OnBusy(tEnd - tExec); }
+					else { counters.OnIdle(tEnd - tBeg); }
+				)
 			}
+			local.m_isBusy.store(true, std::memory_order_relaxed); // Never pops its ready queue again, so fibers awaken for it later may be stolen
+			LIWFiberMain::ReleaseThreadMainFiber(fiberMain);
+		}
+
+		/// <summary>
+		/// Awake function registered to fiber workers of this pool. 
+		/// </summary>
+		static void AwakeFiberFromWorker(void* thisTP, LIWFiberWorker* worker) {
+			reinterpret_cast<LIWFiberThreadPoolSized*>(thisTP)->AwakeFiber(worker);
 		}
 
 	private:
-		bool m_isRunning;
+		std::atomic<bool> m_isRunning;
 		bool m_isInit;
 	};
 }
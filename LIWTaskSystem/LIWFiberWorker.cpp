@@ -1,28 +1,183 @@
 #include "LIWFiberWorker.h"
 #include "LIWFiberMain.h"
 
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+LIW::LIWFiberWorker::LIWFiberWorker():
+	LIWFiberWorker(-1)
+{
+}
+
 //
 // Win32
 //
 #ifdef _WIN32
-LIW::LIWFiberWorker::LIWFiberWorker()
+LIW::LIWFiberWorker::LIWFiberWorker(int id, size_t stackSize):
+	m_id(id),
+	m_isRunning(true),
+	m_stackSize(stackSize)
+{
+	m_sysFiber = CreateFiberEx(0, stackSize, 0, InternalFiberRun, this); // Reserve stackSize, commit on demand
+}
+LIW::LIWFiberWorker::~LIWFiberWorker()
+{
+	DeleteFiber(m_sysFiber);
+}
+size_t LIW::LIWFiberWorker::GetStackPeak() const
+{
+#ifdef LIW_ENABLE_STATS
+	return m_stackPeak.load(std::memory_order_relaxed);
+#else
+	return 0;
+#endif
+}
+void LIW::LIWFiberWorker::CheckStack()
+{
+#if defined(LIW_ENABLE_STATS) || defined(LIW_FIBER_STACK_CHECK)
+	const NT_TIB* tib = reinterpret_cast<const NT_TIB*>(NtCurrentTeb());
+	const size_t committed = (size_t)((const char*)tib->StackBase - (const char*)tib->StackLimit);
+#endif
+#ifdef LIW_ENABLE_STATS
+	if (committed > m_stackPeak.load(std::memory_order_relaxed)) {
+		m_stackPeak.store(committed, std::memory_order_relaxed);
+	}
+#endif
+#ifdef LIW_FIBER_STACK_CHECK
+	if (committed >= m_stackSize) { // Only the guard pages are left
+		fprintf(stderr, "LIWFiberWorker %d: stack overflow (%zu of %zu bytes committed)\n", m_id, committed, m_stackSize);
+		abort();
+	}
+#endif
+}
+void LIW::LIWFiberWorker::YieldToMain()
+{
+	CheckStack();
+	LIW_STATS(m_account.OnSwitchedOut());
+	SwitchToFiber(m_fiberMain->m_sysFiber);
+	LIW_STATS(m_account.OnSwitchedIn());
+}
+void LIW::LIWFiberWorker::YieldTo(LIWFiberWorker* fiberYieldTo)
 {
-	LIWFiberWorker(-1);
+	CheckStack();
+	LIW_STATS(m_account.OnSwitchedOut());
+	SwitchToFiber(fiberYieldTo->m_sysFiber);
+	LIW_STATS(m_account.OnSwitchedIn());
 }
-LIW::LIWFiberWorker::LIWFiberWorker(int id):
+//
+// POSIX
+//
+#else
+LIW::LIWFiberWorker::LIWFiberWorker(int id, size_t stackSize):
 	m_id(id),
 	m_isRunning(true)
 {
-	m_sysFiber = CreateFiber(0, InternalFiberRun, this);
+	// Pages of the mapping are only committed when touched. The guard page makes an overflow fault instead of corrupting memory. 
+	m_sizeGuard = (size_t)sysconf(_SC_PAGESIZE);
+	m_stackSize = (stackSize + m_sizeGuard - 1) / m_sizeGuard * m_sizeGuard;
+	void* mapping = mmap(nullptr, m_sizeGuard + m_stackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mapping == MAP_FAILED) {
+		fprintf(stderr, "LIWFiberWorker %d: failed to map a stack of %zu bytes\n", m_id, m_stackSize);
+		abort();
+	}
+	mprotect(mapping, m_sizeGuard, PROT_NONE);
+	m_stack = (char*)mapping + m_sizeGuard;
+#ifdef LIW_FIBER_STACK_CHECK
+	memset(m_stack, c_stackPaint, c_stackCanarySize);
+#endif
+	MakeContext();
+#ifdef LIW_FIBER_TSAN
+	m_tsanFiber = __tsan_create_fiber(0);
+#endif
 }
 LIW::LIWFiberWorker::~LIWFiberWorker()
 {
-	DeleteFiber(m_sysFiber);
+#ifdef LIW_FIBER_TSAN
+	__tsan_destroy_fiber(m_tsanFiber);
+#endif
+	munmap(m_stack - m_sizeGuard, m_sizeGuard + m_stackSize);
 }
-inline void LIW::LIWFiberWorker::YieldToMain()
+size_t LIW::LIWFiberWorker::GetStackPeak() const
 {
-	SwitchToFiber(m_fiberMain->m_sysFiber);
+#ifdef LIW_ENABLE_STATS
+	if (!m_isStackPainted) { // Never run
+		return 0;
+	}
+	const size_t sizePaint = m_stackSize < LIW_FIBER_STACK_PAINT_DEPTH ? m_stackSize : LIW_FIBER_STACK_PAINT_DEPTH;
+	size_t offset = m_stackSize - sizePaint; // The stack grows down, so the lowest overwritten byte marks the peak
+	while (offset < m_stackSize && (unsigned char)m_stack[offset] == c_stackPaint) {
+		++offset;
+	}
+	return m_stackSize - offset;
+#else
+	return 0;
+#endif
 }
-#endif 
-
-
+#ifdef LIW_ENABLE_STATS
+void LIW::LIWFiberWorker::PaintStack()
+{
+	const size_t sizePaint = m_stackSize < LIW_FIBER_STACK_PAINT_DEPTH ? m_stackSize : LIW_FIBER_STACK_PAINT_DEPTH;
+	memset(m_stack + m_stackSize - sizePaint, c_stackPaint, sizePaint);
+	m_isStackPainted = true;
+	MakeContext(); // makecontext wrote the entry frame at the top of the stack, which was just painted over
+}
+#endif
+void LIW::LIWFiberWorker::MakeContext()
+{
+	getcontext(&m_sysFiber);
+	m_sysFiber.uc_stack.ss_sp = m_stack;
+	m_sysFiber.uc_stack.ss_size = m_stackSize;
+	m_sysFiber.uc_link = nullptr;
+	const uint64_t ptrThis = (uint64_t)reinterpret_cast<uintptr_t>(this);
+	makecontext(&m_sysFiber, (void(*)())InternalFiberRun, 2, (unsigned int)(ptrThis >> 32), (unsigned int)(ptrThis & 0xFFFFFFFFu));
+}
+void LIW::LIWFiberWorker::CheckStack()
+{
+#ifdef LIW_FIBER_STACK_CHECK
+	const char probe = 0;
+	bool isOverflown = &probe < m_stack + c_stackCanarySize; // Running in the canary now
+	for (size_t i = 0; i < c_stackCanarySize && !isOverflown; ++i) { // Ran in the canary earlier (a large frame may even skip the guard page)
+		isOverflown = (unsigned char)m_stack[i] != c_stackPaint;
+	}
+	if (isOverflown) {
+		fprintf(stderr, "LIWFiberWorker %d: stack overflow (stack size %zu bytes)\n", m_id, m_stackSize);
+		abort();
+	}
+#endif
+}
+void LIW::LIWFiberWorker::YieldToMain()
+{
+	CheckStack();
+	LIW_STATS(m_account.OnSwitchedOut());
+#ifdef LIW_FIBER_TSAN
+	__tsan_switch_to_fiber(m_fiberMain->m_tsanFiber, 0);
+#endif
+	swapcontext(&m_sysFiber, &m_fiberMain->m_sysFiber);
+	LIW_STATS(m_account.OnSwitchedIn());
+}
+void LIW::LIWFiberWorker::YieldTo(LIWFiberWorker* fiberYieldTo)
+{
+	CheckStack();
+	LIW_STATS(m_account.OnSwitchedOut());
+#ifdef LIW_FIBER_TSAN
+	while (fiberYieldTo->m_tsanUnlocking.load(std::memory_order_acquire)) {}
+	__tsan_switch_to_fiber(fiberYieldTo->m_tsanFiber, 0);
+#endif
+	swapcontext(&m_sysFiber, &fiberYieldTo->m_sysFiber);
+	LIW_STATS(m_account.OnSwitchedIn());
+}
+void LIW::LIWFiberWorker::InternalFiberRun(unsigned int thisHi, unsigned int thisLo)
+{
+	LIWFiberWorker* thisFiber = reinterpret_cast<LIWFiberWorker*>((uintptr_t)(((uint64_t)thisHi << 32) | (uint64_t)thisLo));
+	thisFiber->Run();
+	while (true) { // Returning would end the thread (no uc_link). Stopped fibers are never resumed anyway. 
+		thisFiber->YieldToMain();
+	}
+}
+#endif
@@ -1,46 +1,89 @@
 #pragma once
 #include "LIWFiberCommon.h"
+#include "LIWFiberScratch.h"
+#include "LIWStats.h"
+#include "LIWTracer.h"
 
-/*
-* Here is a description of the standard API of LIWFiberWorker.
-* All platform-specific implementation should follow this api layout.
-*/
-/*
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <ucontext.h>
+#endif
 
+/*
+* LIWFiberWorker shares one API on all platforms. 
+* Only the system fiber (creation, switching) is platform-specific: 
+*	Win32: CreateFiberEx/SwitchToFiber
+*	POSIX: makecontext/swapcontext on an mmap-allocated stack, with a guard page below it
+* 
+* Stacks: 
+*	Size is given on construction (pools take it in Init). Pages are only committed when touched, so a large stack costs address space until used. 
+*	Peak usage (GetStackPeak) is measured when LIW_ENABLE_STATS is defined: 
+*		Win32: committed size of the stack, sampled on every switch out
+*		POSIX: the top LIW_FIBER_STACK_PAINT_DEPTH bytes of the stack are painted before the first run and scanned for the deepest overwritten byte. 
+*			Painting commits those pages (only for fibers which run), and peaks deeper than the painted range read as its depth. 
+*	Overflow is checked on every switch out when LIW_FIBER_STACK_CHECK is defined (by default in debug builds), and aborts with a message. 
+*		POSIX: the guard page faults, and a canary painted at the bottom of the stack catches frames which skip it. Neither needs LIW_ENABLE_STATS. 
+* 
+* Scratch: 
+*	Each fiber owns a linear arena (GetScratch) for temporaries of its task, reset when the run function returns. 
+*	Unlike thread local allocators, it stays valid across waits, whichever worker thread resumes the fiber. 
 */
 
 namespace LIW {
-//
-// Win32
-//
-#ifdef _WIN32
-#include <windows.h>
-
 	class LIWFiberWorker final
 	{
 		friend class LIWFiberMain;
 	public:
 		LIWFiberWorker();
-		LIWFiberWorker(int id);
+		LIWFiberWorker(int id, size_t stackSize = c_stackSizeDefault);
 		~LIWFiberWorker();
 		LIWFiberWorker(const LIWFiberWorker& other) = delete;
-		LIWFiberWorker(LIWFiberWorker&& other) = default;
+		LIWFiberWorker(LIWFiberWorker&& other) = delete; // The system fiber refers to this object, so it cannot be moved. 
 		LIWFiberWorker& operator=(const LIWFiberWorker& other) = delete;
-		LIWFiberWorker& operator=(LIWFiberWorker&& other) = default;
+		LIWFiberWorker& operator=(LIWFiberWorker&& other) = delete;
 
 		//Set the run function for fiber
 		inline void SetRunFunction(LIWFiberRunner runFunc, void* param = nullptr) {
 			m_runFunction = runFunc;
 			m_param = param;
 			m_state = LIWFiberState::Idle;
+#if defined(LIW_ENABLE_STATS) && !defined(_WIN32)
+			if (!m_isStackPainted) { // First run. Painting now leaves the stacks of fibers which never run uncommitted. 
+				PaintStack();
+			}
+#endif
 		}
+		LIW_STATS(
+		//Get accounting of the current task (reset by the pool when a task starts, accumulated by this fiber when switched in and out)
+		inline Util::LIWTaskAccount& GetTaskAccount() { return m_account; }
+		)
 		//Set the main fiber when obtained by another fiber
 		inline void SetMainFiber(LIWFiberMain* fiberMain) { m_fiberMain = fiberMain; }
+		//Set the function used to awake this fiber after it has been parked (set by the owning pool)
+		inline void SetAwakeFunction(LIWFiberAwakeFunction awakeFunc, void* awakeTarget) {
+			m_awakeFunction = awakeFunc;
+			m_awakeTarget = awakeTarget;
+		}
+		//Set affinity of the current task (set by the owning pool when a task starts)
+		inline void SetAffinity(LIWFiberAffinity affinity) { m_affinity = affinity; }
+		//Get affinity of the current task
+		inline LIWFiberAffinity GetAffinity() const { return m_affinity; }
+		//Set index of the worker thread running this fiber (set by the owning pool on every switch in)
+		inline void SetWorkerIndex(int idxWorker) { m_idxWorker = idxWorker; }
+		//Get index of the worker thread which last ran this fiber
+		inline int GetWorkerIndex() const { return m_idxWorker; }
+		//Awake this fiber (parked by a sync primitive) by handing it back to the owning pool
+		inline void Awake() {
+			m_awakeFunction(m_awakeTarget, this);
+		}
 		//A loop which will yield after finishing runnning a run function
 		inline void Run() {
+			LIW_STATS(m_account.OnSwitchedIn());
 			while (m_isRunning) {
 				m_state = LIWFiberState::Running;
 				m_runFunction(this, m_param);
+				m_scratch.Reset();
 				m_state = LIWFiberState::Idle;
 				YieldToMain();
 			}
@@ -50,13 +93,29 @@ namespace LIW {
 			m_isRunning = false;
 		}
 		//Yield
-		inline void YieldToMain();
-		//Yield to a specific fiber
-		inline void YieldTo(LIWFiberWorker* fiberYieldTo) {
-			SwitchToFiber(fiberYieldTo->m_sysFiber);
+		void YieldToMain();
+		//Yield, and unlock mtx only after this fiber has been switched out. 
+		//Used for parking on a waiter list guarded by mtx, so that no one can awake this fiber before it stops running. 
+		inline void YieldToMainAndUnlock(std::mutex& mtx) {
+			LIW_TRACE(Util::LIWTracer::Instant("FiberPark", m_id));
+			m_mtxUnlockOnYield = &mtx;
+			YieldToMain();
 		}
+		//Yield to a specific fiber
+		void YieldTo(LIWFiberWorker* fiberYieldTo);
 		//Get current state of the fiber
 		inline LIWFiberState GetState() const { return m_state; } 
+		//Get ID of the fiber
+		inline int GetID() const { return m_id; }
+		//Get stack size of the fiber
+		inline size_t GetStackSize() const { return m_stackSize; }
+		//Get scratch arena of the fiber (only use from this fiber; freed when the run function returns)
+		inline LIWFiberScratch& GetScratch() { return m_scratch; }
+		//Get peak stack usage of the fiber so far (0 unless LIW_ENABLE_STATS is defined). Call when the fiber is not running. 
+		size_t GetStackPeak() const;
+
+	public:
+		static const size_t c_stackSizeDefault = 256 * 1024; // Default stack size of a fiber
 
 	private:
 		LIWFiberState m_state = LIWFiberState::Uninit; // State of this fiber
@@ -64,18 +123,52 @@ namespace LIW {
 		void* m_param = nullptr; // Parameters for the running function
 		LIWFiberMain* m_fiberMain = nullptr; // Current main fiber of the thread this fiber is running on
 		int m_id = -1; // ID of the fiber
-		bool m_isRunning = true; // Is this fiber still running? (Has it not been terminated?) 
+		std::atomic<bool> m_isRunning{ true }; // Is this fiber still running? (Has it not been terminated?) 
+		LIWFiberAwakeFunction m_awakeFunction = nullptr; // Function to awake this fiber when parked
+		void* m_awakeTarget = nullptr; // Target passed to the awake function (the owning pool)
+		std::mutex* m_mtxUnlockOnYield = nullptr; // Mutex to unlock by the main fiber after this fiber yields
+		LIWFiberAffinity m_affinity = LIWFiberAffinity::None; // Affinity of the current task
+		int m_idxWorker = -1; // Index of the worker thread which last ran this fiber
+		LIW_STATS(Util::LIWTaskAccount m_account;) // Accounting of the current task
+		size_t m_stackSize = 0; // Stack size of this fiber
+		LIWFiberScratch m_scratch; // Scratch arena of the current task
 
 	private:
+		//Check the stack of this fiber for overflow, before switching out
+		void CheckStack();
+//
+// Win32
+//
+#ifdef _WIN32
 		static void __stdcall InternalFiberRun(LPVOID param) {
 			LIWFiberWorker* thisFiber = reinterpret_cast<LIWFiberWorker*>(param);
 			thisFiber->Run();
 		}
 	private:
 		LPVOID m_sysFiber;
-	};
-
+		LIW_STATS(std::atomic<size_t> m_stackPeak{ 0 };) // Peak committed size of the stack
+//
+// POSIX
+//
+#else
+		// makecontext only passes int arguments, so this pointer is split into two halves. 
+		static void InternalFiberRun(unsigned int thisHi, unsigned int thisLo);
+	private:
+		ucontext_t m_sysFiber; // Saved context of this fiber
+		char* m_stack = nullptr; // Stack of this fiber (lowest address, after the guard page)
+		size_t m_sizeGuard = 0; // Size of the guard page below the stack
+		LIW_STATS(bool m_isStackPainted = false;) // Has the top of the stack been painted to measure peak usage? 
+		LIW_STATS(void PaintStack();) // Paint the top of the stack (LIW_FIBER_STACK_PAINT_DEPTH bytes). Call before the first run. 
+		void MakeContext(); // Set the system fiber to enter InternalFiberRun on the stack
+#ifdef LIW_FIBER_TSAN
+		void* m_tsanFiber = nullptr; // ThreadSanitizer fiber of this fiber
+		std::atomic<bool> m_tsanUnlocking{ false }; // Is a main fiber unlocking on behalf of this fiber? It must not be resumed until done. 
+#endif
+	public:
+		static const unsigned char c_stackPaint = 0xCD; // Byte painted over unused stack
+		static const size_t c_stackCanarySize = 256; // Bytes at the bottom of the stack which must stay painted
 #endif 
+	};
 }
 
 
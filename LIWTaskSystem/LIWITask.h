@@ -1,5 +1,8 @@
 #pragma once
 #include <functional>
+#include <cstdint>
+#include "LIWStats.h"
+#include "LIWTaskTag.h"
 
 namespace LIW {
 	typedef std::function<void* (void*)> LIWThreadTask;
@@ -13,5 +16,13 @@ namespace LIW {
 		//virtual void BlockForDependencies() = 0;
 		virtual void Execute(void*) = 0;
 		//virtual void SignalDependents() = 0;
+
+		//Tag the task for per-tag accounting in pool stats
+		inline void SetTag(const LIWTaskTag& tag) { m_tag = &tag; }
+		inline const LIWTaskTag* GetTag() const { return m_tag; }
+
+		LIW_STATS(uint64_t m_nsSubmit = 0;) // Time of submit, stamped by pools for latency stats
+	private:
+		const LIWTaskTag* m_tag = nullptr; // Tag of the task (nullptr means untagged)
 	};
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 * Freelist Allocator with Handle
 */
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <atomic>
 #include <mutex>
@@ -465,7 +466,7 @@ namespace LIW {
 							if (segCur->m_handle) { // If handle is not null, seg is not free
 								// Move memory and defrag
 								if (segCur != segDefragTo) {
-									memmove_s(segDefragTo, sizeSeg, segCur, sizeSeg);
+									memmove(segDefragTo, segCur, sizeSeg);
 									// Asjust handle
 									HandleData* const handle = segDefragTo->m_handle;
 									handle->m_ptr.seg = segDefragTo;
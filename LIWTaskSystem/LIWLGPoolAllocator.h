@@ -3,6 +3,7 @@
 #include <atomic>
 #include <mutex>
 #include <cassert>
+#include <cstdint>
 
 #include "LIWAllocation.h"
 
@@ -12,6 +13,7 @@ namespace LIW {
 		class LIWLGPoolAllocator {
 			static_assert(size_t(1) << (sizeof(IndexType) * 8) > CountElementPerBlock * CountBlock, "IndexType too small for pool of this size");
 			static_assert(SizeElement >= sizeof(IndexType), "SizeElement too small for storing index");
+			static_assert(CountBlock < (size_t(1) << 32), "CountBlock too large for tagged block index");
 
 		public:
 			typedef IndexType idx_type;
@@ -26,6 +28,17 @@ namespace LIW {
 			static const size_t c_poolSize		= c_blockSize * c_countBlock;
 		public:
 			class LocalPoolAllocator;
+			/*
+			* GlobalPoolAllocator keeps available blocks in a lock-free stack (Treiber stack). 
+			* The top is tagged with a generation (high 32 bits) over the block index (low 32 bits), 
+			* which changes on every push and pop, so a stale top cannot be swapped in (ABA). 
+			* Links between available blocks are kept out of the blocks, so popping never reads a block being initialized by its new owner. 
+			* 
+			* Blocks never fetched since the last clear are handed out by bumping a counter, so initializing or clearing the pool touches no block. 
+			* 
+			* A fetched block is owned by one LocalPoolAllocator. Elements returned on any other thread go to the block's remote free list (lock-free), 
+			* which the owner drains when it runs out of elements. Blocks whose elements are all returned go back to GlobalPoolAllocator. 
+			*/
 			class GlobalPoolAllocator {
 				friend class LocalPoolAllocator;
 			public:
@@ -38,41 +51,88 @@ namespace LIW {
 					assert(dataBufferRaw);
 					void* const dataBuffer = liw_align_pointer(dataBufferRaw, align);
 
-					m_dataBuffer = (char*)dataBuffer;
+					Init(dataBuffer);
 					m_dataBufferRaw = (char*)dataBufferRaw;
+				}
+
+				/// <summary>
+				/// Initialize on a memory buffer owned by the caller (not freed on cleanup). 
+				/// </summary>
+				/// <param name="dataBuffer"> buffer of c_poolSize bytes, aligned to max_align_t </param>
+				inline void Init(void* dataBuffer) {
+					assert(((uintptr_t)dataBuffer & (alignof(max_align_t) - 1)) == 0); // Buffer is aligned
+					m_dataBuffer = (char*)dataBuffer;
+					m_dataBufferRaw = nullptr;
+					m_blocksNext = new std::atomic<uint32_t>[c_countBlock]; // Only written when a block is returned
+					void* const blocksInfoRaw = malloc(sizeof(LIWPoolBlockInfo) * c_countBlock + alignof(LIWPoolBlockInfo)); // Constructed when a block is fetched
+					assert(blocksInfoRaw);
+					m_blocksInfo = (LIWPoolBlockInfo*)liw_align_pointer(blocksInfoRaw, alignof(LIWPoolBlockInfo));
+					m_blocksInfoRaw = (char*)blocksInfoRaw;
+					m_dataBufferEnd = m_dataBuffer + c_poolSize;
 					InitAllBlocks();
 				}
 
 				/// <summary>
-				/// Fetch a block. 
+				/// Fetch a block. Lock-free. 
 				/// </summary>
-				/// <returns> fetched block start pointer </returns>
+				/// <returns> fetched block start pointer (nullptr if no block is available) </returns>
 				void* FetchBlock() {
-					lkgd_type lk(m_mtx);
-					assert(m_availableList != m_dataBufferEnd); // No available block in pool
-					void* ptr = m_availableList;
-					const idx_type idxNext = *((idx_type*)ptr);
-					m_availableList = m_dataBuffer + idxNext * c_elementSize;
+					uint64_t top = m_blocksTop.load(std::memory_order_acquire);
+					uint32_t idxBlock;
+					do {
+						idxBlock = (uint32_t)top;
+						if (idxBlock == c_idxBlockNone) { // No returned block. Take a fresh one. 
+							if (m_countBlocksFresh.load(std::memory_order_relaxed) < c_countBlock) {
+								idxBlock = m_countBlocksFresh.fetch_add(1, std::memory_order_relaxed);
+								if (idxBlock < c_countBlock) {
+									break;
+								}
+							}
+							top = m_blocksTop.load(std::memory_order_acquire); // A block may be returned meanwhile
+							if ((uint32_t)top != c_idxBlockNone) {
+								continue;
+							}
+							assert(false); // No available block in pool
+							return nullptr;
+						}
+						// The link may be stale if the block was popped meanwhile, but then the generation changed and the exchange fails. 
+						const uint64_t topNew = NextTop(top, m_blocksNext[idxBlock].load(std::memory_order_relaxed));
+						if (m_blocksTop.compare_exchange_weak(top, topNew, std::memory_order_acquire, std::memory_order_acquire))
+							break;
+					} while (true);
+					void* const ptr = m_dataBuffer + idxBlock * c_blockSize;
 					InitBlock(ptr);
 					return ptr;
 				}
 
 				/// <summary>
-				/// Return a fetched block. 
+				/// Return a fetched block. Lock-free. 
 				/// </summary>
 				/// <param name="ptrBlock"> pointer to the fetched block </param>
 				void ReturnBlock(void* ptrBlock) {
-					lkgd_type lk(m_mtx);
-					const ptrdiff_t offset = (uintptr_t)m_availableList - (uintptr_t)m_dataBuffer;
-					const idx_type idxOffset = offset / c_elementSize;
-					assert(idxOffset * c_elementSize == offset); // First available element doesn't align with the pool
-					//memset(ptrBlock, 0, c_blockSize);
-					*((idx_type*)ptrBlock) = idxOffset;
-					m_availableList = (char*)ptrBlock;
+					const size_t offset = (size_t)((uintptr_t)ptrBlock - (uintptr_t)m_dataBuffer);
+					const uint32_t idxBlock = (uint32_t)(offset / c_blockSize);
+					assert(idxBlock * c_blockSize == offset); // Block doesn't align with the pool
+					uint64_t top = m_blocksTop.load(std::memory_order_relaxed);
+					do {
+						m_blocksNext[idxBlock].store((uint32_t)top, std::memory_order_relaxed);
+					} while (!m_blocksTop.compare_exchange_weak(top, NextTop(top, idxBlock), std::memory_order_release, std::memory_order_relaxed));
 				}
 
 				/// <summary>
-				/// Clear allocated blocks. 
+				/// Return an element without a local allocator, e.g. from a thread which only frees. Lock-free. 
+				/// The element goes to the remote list of its block, which the owner drains. 
+				/// </summary>
+				/// <param name="ptr"> pointer to the element (fetched by a local allocator) </param>
+				void ReturnRemote(void* ptr) {
+					const size_t offset = (size_t)((uintptr_t)ptr - (uintptr_t)m_dataBuffer);
+					const idx_type idxElement = (idx_type)(offset / c_elementSize);
+					assert(idxElement * c_elementSize == offset); // Element doesn't align with the pool
+					PushRemote(m_blocksInfo[idxElement / c_countPerBlock], ptr, idxElement);
+				}
+
+				/// <summary>
+				/// Clear allocated blocks. O(1). (Not thread safe)
 				/// </summary>
 				inline void Clear() {
 					InitAllBlocks();
@@ -83,50 +143,87 @@ namespace LIW {
 				/// </summary>
 				inline void Cleanup() {
 					free(m_dataBufferRaw);
+					delete[] m_blocksNext;
+					m_blocksNext = nullptr;
+					free(m_blocksInfoRaw);
+					m_blocksInfo = nullptr;
+					m_blocksInfoRaw = nullptr;
 				}
 
 			private:
+				static const uint32_t c_idxBlockNone = (uint32_t)c_countBlock; // Block index of the empty stack
+
+				/// <summary>
+				/// Per block state of a fetched block. 
+				/// </summary>
+				struct alignas(64) LIWPoolBlockInfo {
+					std::atomic<LocalPoolAllocator*> m_owner	{ nullptr }; // Owning local allocator. 
+					std::atomic<idx_type> m_remoteFree			{ c_countPerPool }; // Elements returned by other threads. (c_countPerPool if none)
+					idx_type m_localFree						{ c_countPerPool }; // Elements returned by the owner. (c_countPerPool if none) Owner only. 
+					idx_type m_bump								{ 0 }; // First element never handed out. Elements from here to m_bumpEnd are unlinked. Owner only. 
+					idx_type m_bumpEnd							{ 0 }; // End of the block's elements. 
+					idx_type m_countUsed						{ 0 }; // Elements handed out and not yet drained back. Owner only. 
+					uint32_t m_idxOwnedPrev						{ c_idxBlockNone }; // Owned block list of the owner. Owner only. 
+					uint32_t m_idxOwnedNext						{ c_idxBlockNone };
+				};
+
 				char* m_dataBuffer		{ nullptr }; // Pointer to allocated space. (aligned)
 				char* m_dataBufferEnd	{ nullptr }; // Pointer to the end of allocated space. (aligned)
 				char* m_dataBufferRaw	{ nullptr }; // Pointer to allocated space. (raw)
-				char* m_availableList	{ nullptr }; // Pointer to the first available block. 
-				mtx_type m_mtx;
+				std::atomic<uint64_t> m_blocksTop		{ c_idxBlockNone }; // Top of the available block stack. (generation << 32 | block index)
+				std::atomic<uint32_t>* m_blocksNext		{ nullptr }; // Index of the next available block, of each available block. 
+				std::atomic<uint32_t> m_countBlocksFresh	{ 0 }; // Blocks from here on were never fetched since the last clear. 
+				LIWPoolBlockInfo* m_blocksInfo			{ nullptr }; // State of each fetched block. (aligned)
+				char* m_blocksInfoRaw					{ nullptr }; // State of each fetched block. (raw)
+
+				/// <summary>
+				/// Get the top after an exchange (next generation, new block index). 
+				/// </summary>
+				static inline uint64_t NextTop(uint64_t top, uint32_t idxBlock) {
+					return (((top >> 32) + 1) << 32) | idxBlock;
+				}
+
+				/// <summary>
+				/// Push an element to the remote list of its block. 
+				/// </summary>
+				static inline void PushRemote(LIWPoolBlockInfo& info, void* ptr, idx_type idxElement) {
+					idx_type head = info.m_remoteFree.load(std::memory_order_relaxed);
+					do {
+						*((idx_type*)ptr) = head;
+					} while (!info.m_remoteFree.compare_exchange_weak(head, idxElement, std::memory_order_release, std::memory_order_relaxed));
+				}
 
 				/// <summary>
-				/// Initialize a block by linking the elements in the block. 
+				/// Initialize a fetched block. Only its state is written, elements are handed out by bumping. 
 				/// </summary>
 				/// <param name="ptrBlock"> pointer to the block </param>
 				void InitBlock(void* ptrBlock) {
-					char* ptrInit = (char*)ptrBlock;
-					const uintptr_t offsetByte = ((uintptr_t)ptrInit - (uintptr_t)m_dataBuffer);
+					const uintptr_t offsetByte = ((uintptr_t)ptrBlock - (uintptr_t)m_dataBuffer);
 					const idx_type idxOffset = (idx_type)(offsetByte / c_elementSize);
 					assert(idxOffset * c_elementSize == offsetByte); // ptrBlock is valid
-					const idx_type idxBlockEnd = idxOffset + c_countPerBlock;
-					assert(idxBlockEnd <= c_poolSize); // Block doesnt exceed max capacity
-					for (idx_type idx = idxOffset; idx < idxBlockEnd - 1; ++idx) { // Link elements
-						*((idx_type*)ptrInit) = idx + 1;
-						ptrInit += c_elementSize;
-					}
-					*((idx_type*)ptrInit) = c_countPerPool; // The last of the block points to end pointer. 
+					assert(idxOffset + c_countPerBlock <= c_countPerPool); // Block doesnt exceed max capacity
+					LIWPoolBlockInfo* const info = new(&m_blocksInfo[idxOffset / c_countPerBlock]) LIWPoolBlockInfo();
+					info->m_bump = idxOffset;
+					info->m_bumpEnd = (idx_type)(idxOffset + c_countPerBlock);
 				}
 
 				/// <summary>
-				/// Initialize all blocks by linking the blocks. 
+				/// Mark all blocks fresh. 
 				/// </summary>
 				inline void InitAllBlocks() {
-					char* ptrInit = m_dataBuffer;
-					for (idx_type idxElement = 0; idxElement < c_countPerPool; idxElement += c_countPerBlock) { // Link PoolSize-1 elements
-						*((idx_type*)ptrInit) = idxElement + c_countPerBlock;
-						ptrInit += c_blockSize;
-					}
-					m_dataBufferEnd = ptrInit;
-					m_availableList = m_dataBuffer;
+					m_countBlocksFresh.store(0, std::memory_order_relaxed);
+					m_blocksTop.store(c_idxBlockNone, std::memory_order_release);
 				}
 			};
 
+			/*
+			* LocalPoolAllocator hands out elements from the blocks it owns. Not thread safe. Return may be called with elements of any local allocator. 
+			* NOTE: Elements must be returned before their owner is reset or cleaned up. Blocks of such an owner still in use are only reclaimed by GlobalPoolAllocator::Clear. 
+			*/
 			class LocalPoolAllocator {
 			private:
 				typedef LIWLGPoolAllocator<SizeElement, IndexType, CountElementPerBlock, CountBlock>::GlobalPoolAllocator globalAllocator_type;
+				typedef typename globalAllocator_type::LIWPoolBlockInfo blockInfo_type;
 			public:
 				/// <summary>
 				/// Initialize with a corresponding global allocator. 
@@ -134,7 +231,9 @@ namespace LIW {
 				/// <param name="globalAllocator"> pointer to a global allocator </param>
 				inline void Init(globalAllocator_type& globalAllocator) {
 					m_globalAllocator = &globalAllocator;
-					m_availableList = (char*)m_globalAllocator->FetchBlock();
+					m_dataBuffer = globalAllocator.m_dataBuffer;
+					m_idxBlocksOwned = globalAllocator_type::c_idxBlockNone;
+					OwnNewBlock();
 				}
 
 				/// <summary>
@@ -142,37 +241,221 @@ namespace LIW {
 				/// </summary>
 				/// <returns> pointer to the element </returns>
 				void* Fetch() {
-					if (m_availableList == m_globalAllocator->m_dataBufferEnd) { // Fetch new block from global allocator
-						m_availableList = (char*)m_globalAllocator->FetchBlock();
+					if (!HasFree(*m_infoCurrent)) { // Current block runs out
+						Refill();
 					}
-					void* const ptr = m_availableList;
-					const idx_type idxNext = *((idx_type*)ptr);
-					m_availableList = m_globalAllocator->m_dataBuffer + idxNext * c_elementSize;
+					blockInfo_type* const info = m_infoCurrent;
+					char* ptr;
+					if (info->m_localFree != c_countPerPool) {
+						ptr = m_dataBuffer + info->m_localFree * c_elementSize;
+						info->m_localFree = *((idx_type*)ptr);
+					}
+					else {
+						ptr = m_dataBuffer + info->m_bump++ * c_elementSize;
+					}
+					++info->m_countUsed;
 					return ptr;
 				}
 
 				/// <summary>
 				/// Return an element to the pool. 
 				/// </summary>
-				/// <param name="ptr"> pointer to the element </param>
+				/// <param name="ptr"> pointer to the element (may be fetched by another local allocator) </param>
 				void Return(void* ptr) {
-					const ptrdiff_t offset = (uintptr_t)m_availableList - (uintptr_t)(m_globalAllocator->m_dataBuffer);
-					const idx_type offsetIdx = (idx_type)(offset / c_elementSize);
-					assert(offsetIdx * c_elementSize == offset); // The first available element in available list doesn't align with the pool
-					*((idx_type*)ptr) = offsetIdx;
-					m_availableList = (char*)ptr;
+					const size_t offset = (size_t)((uintptr_t)ptr - (uintptr_t)m_dataBuffer);
+					const idx_type idxElement = (idx_type)(offset / c_elementSize);
+					assert(idxElement * c_elementSize == offset); // Element doesn't align with the pool
+					const uint32_t idxBlock = (uint32_t)(idxElement / c_countPerBlock);
+					blockInfo_type& info = m_globalAllocator->m_blocksInfo[idxBlock];
+					if (info.m_owner.load(std::memory_order_relaxed) == this) {
+						*((idx_type*)ptr) = info.m_localFree;
+						info.m_localFree = idxElement;
+						if (--info.m_countUsed == 0 && &info != m_infoCurrent) { // Give the wholly free block back
+							DisownBlock(idxBlock);
+						}
+					}
+					else { // Remote free. Push to the block's remote list, the owner drains it. 
+						globalAllocator_type::PushRemote(info, ptr, idxElement);
+					}
 				}
 
 				/// <summary>
-				/// Reset allocator. 
+				/// Fetch elements from the pool. 
+				/// </summary>
+				/// <param name="ptrs"> array to receive count pointers to the elements </param>
+				/// <param name="count"> count of elements </param>
+				void FetchN(void** ptrs, size_t count) {
+					size_t idx = 0;
+					while (idx < count) {
+						if (!HasFree(*m_infoCurrent)) { // Current block runs out
+							Refill();
+						}
+						blockInfo_type* const info = m_infoCurrent;
+						const size_t idxBeg = idx;
+						idx_type idxFree = info->m_localFree;
+						while (idx < count && idxFree != c_countPerPool) {
+							char* const ptr = m_dataBuffer + idxFree * c_elementSize;
+							idxFree = *((idx_type*)ptr);
+							ptrs[idx++] = ptr;
+						}
+						info->m_localFree = idxFree;
+						idx_type idxBump = info->m_bump;
+						while (idx < count && idxBump != info->m_bumpEnd) {
+							ptrs[idx++] = m_dataBuffer + idxBump++ * c_elementSize;
+						}
+						info->m_bump = idxBump;
+						info->m_countUsed += (idx_type)(idx - idxBeg);
+					}
+				}
+
+				/// <summary>
+				/// Return elements to the pool. 
+				/// </summary>
+				/// <param name="ptrs"> pointers to the elements (may be fetched by other local allocators) </param>
+				/// <param name="count"> count of elements </param>
+				void ReturnN(void* const* ptrs, size_t count) {
+					for (size_t idx = 0; idx < count; ++idx) {
+						Return(ptrs[idx]);
+					}
+				}
+
+				/// <summary>
+				/// Reset allocator. Gives back the owned blocks and starts on a new block. 
 				/// </summary>
 				inline void Reset() {
-					m_availableList = (char*)m_globalAllocator->FetchBlock();
+					ReleaseBlocks();
+					OwnNewBlock();
 				}
 
+				/// <summary>
+				/// Cleanup allocator. Gives back the owned blocks. 
+				/// </summary>
+				inline void Cleanup() {
+					ReleaseBlocks();
+					m_infoCurrent = nullptr;
+					m_globalAllocator = nullptr;
+				}
+
+				/// <summary>
+				/// Check if initialized (and not cleaned up). 
+				/// </summary>
+				inline bool IsInit() const { return m_globalAllocator != nullptr; }
+
 			private:
-				char* m_availableList					{ nullptr }; // Available list. 
+				blockInfo_type* m_infoCurrent			{ nullptr }; // Block to fetch from. 
+				char* m_dataBuffer						{ nullptr }; // Data buffer of the global allocator. 
+				uint32_t m_idxBlocksOwned				{ globalAllocator_type::c_idxBlockNone }; // Head of owned block list. (including the current block)
 				globalAllocator_type* m_globalAllocator	{ nullptr }; // Reference to its global allocator. 
+
+				/// <summary>
+				/// Check if an owned block has elements to hand out. 
+				/// </summary>
+				static inline bool HasFree(const blockInfo_type& info) {
+					return info.m_localFree != c_countPerPool || info.m_bump != info.m_bumpEnd;
+				}
+
+				/// <summary>
+				/// Move remote freed elements of an owned block to its local list. 
+				/// </summary>
+				/// <returns> if any element is drained </returns>
+				bool DrainRemote(uint32_t idxBlock) {
+					blockInfo_type& info = m_globalAllocator->m_blocksInfo[idxBlock];
+					if (info.m_remoteFree.load(std::memory_order_relaxed) == c_countPerPool) {
+						return false;
+					}
+					idx_type idxElement = info.m_remoteFree.exchange(c_countPerPool, std::memory_order_acquire);
+					idx_type count = 0;
+					while (idxElement != c_countPerPool) {
+						idx_type* const link = (idx_type*)(m_globalAllocator->m_dataBuffer + idxElement * c_elementSize);
+						const idx_type idxNext = *link;
+						*link = info.m_localFree;
+						info.m_localFree = idxElement;
+						idxElement = idxNext;
+						++count;
+					}
+					info.m_countUsed -= count;
+					return true;
+				}
+
+				/// <summary>
+				/// Give back wholly free owned blocks, and abandon the ones still in use. 
+				/// </summary>
+				void ReleaseBlocks() {
+					while (m_idxBlocksOwned != globalAllocator_type::c_idxBlockNone) {
+						const uint32_t idxBlock = m_idxBlocksOwned;
+						DrainRemote(idxBlock);
+						if (m_globalAllocator->m_blocksInfo[idxBlock].m_countUsed == 0) {
+							DisownBlock(idxBlock);
+						}
+						else { // Still in use. Abandon it. 
+							UnlinkBlock(idxBlock);
+						}
+					}
+				}
+
+				/// <summary>
+				/// Find a block to fetch from when the current block runs out: 
+				/// the current block's remote frees, then any other owned block's, then a new block. 
+				/// </summary>
+				void Refill() {
+					if (DrainRemote((uint32_t)(m_infoCurrent - m_globalAllocator->m_blocksInfo))) {
+						return;
+					}
+					uint32_t idxBlock = m_idxBlocksOwned;
+					while (idxBlock != globalAllocator_type::c_idxBlockNone) {
+						const uint32_t idxNext = m_globalAllocator->m_blocksInfo[idxBlock].m_idxOwnedNext;
+						DrainRemote(idxBlock);
+						if (HasFree(m_globalAllocator->m_blocksInfo[idxBlock])) {
+							m_infoCurrent = &m_globalAllocator->m_blocksInfo[idxBlock];
+							return;
+						}
+						idxBlock = idxNext;
+					}
+					OwnNewBlock();
+				}
+
+				/// <summary>
+				/// Fetch a new block from the global allocator and make it current. 
+				/// </summary>
+				void OwnNewBlock() {
+					char* const ptrBlock = (char*)m_globalAllocator->FetchBlock();
+					assert(ptrBlock); // No available block in pool
+					const uint32_t idxBlock = (uint32_t)((ptrBlock - m_globalAllocator->m_dataBuffer) / c_blockSize);
+					blockInfo_type& info = m_globalAllocator->m_blocksInfo[idxBlock];
+					info.m_owner.store(this, std::memory_order_relaxed);
+					info.m_idxOwnedPrev = globalAllocator_type::c_idxBlockNone;
+					info.m_idxOwnedNext = m_idxBlocksOwned;
+					if (m_idxBlocksOwned != globalAllocator_type::c_idxBlockNone) {
+						m_globalAllocator->m_blocksInfo[m_idxBlocksOwned].m_idxOwnedPrev = idxBlock;
+					}
+					m_idxBlocksOwned = idxBlock;
+					m_infoCurrent = &info;
+				}
+
+				/// <summary>
+				/// Remove a block from the owned block list. 
+				/// </summary>
+				void UnlinkBlock(uint32_t idxBlock) {
+					blockInfo_type& info = m_globalAllocator->m_blocksInfo[idxBlock];
+					if (info.m_idxOwnedPrev != globalAllocator_type::c_idxBlockNone) {
+						m_globalAllocator->m_blocksInfo[info.m_idxOwnedPrev].m_idxOwnedNext = info.m_idxOwnedNext;
+					}
+					else {
+						m_idxBlocksOwned = info.m_idxOwnedNext;
+					}
+					if (info.m_idxOwnedNext != globalAllocator_type::c_idxBlockNone) {
+						m_globalAllocator->m_blocksInfo[info.m_idxOwnedNext].m_idxOwnedPrev = info.m_idxOwnedPrev;
+					}
+					info.m_owner.store(nullptr, std::memory_order_relaxed);
+				}
+
+				/// <summary>
+				/// Give a wholly free owned block back to the global allocator. 
+				/// </summary>
+				void DisownBlock(uint32_t idxBlock) {
+					UnlinkBlock(idxBlock);
+					m_globalAllocator->ReturnBlock(m_globalAllocator->m_dataBuffer + idxBlock * c_blockSize);
+				}
 			};
 		};
 	}
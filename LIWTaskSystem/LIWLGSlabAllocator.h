@@ -0,0 +1,208 @@
+#pragma once
+#include <cstdlib>
+#include <cstdint>
+#include <tuple>
+#include <array>
+#include <utility>
+
+#include "LIWAllocation.h"
+#include "LIWLGPoolAllocator.h"
+
+namespace LIW {
+	namespace Util {
+		/*
+		* LIWLGSlabAllocator serves variable sized small allocations from a pool allocator per size class. 
+		* Size classes go from 16 to 4096 bytes, 16 apart up to 64, then 4 classes per doubling (25% steps). Every class is a multiple of 16, so allocations are aligned to 16. 
+		* All classes share one buffer, each taking a span of CountBlock blocks of at most SizeBlock bytes, so the class of a pointer is found from its address. 
+		* Allocations larger than the largest class go to the system heap. 
+		* Like the pool allocator, each thread allocates from its own LocalSlabAllocator, and allocations may be freed on any thread. 
+		* A thread only takes blocks of the classes it allocates from, so a thread which only frees holds no blocks. 
+		*/
+		template<size_t SizeBlock, size_t CountBlock>
+		class LIWLGSlabAllocator {
+		public:
+			static const size_t c_countClasses	= 28;
+			static const size_t c_sizeMin		= 16;
+			static const size_t c_sizeMax		= 4096;
+			static const size_t c_blockSize		= SizeBlock;
+			static const size_t c_countBlock	= CountBlock;
+			static const size_t c_classSpan		= SizeBlock * CountBlock; // Bytes of the buffer taken by each class
+			static const size_t c_totalSize		= c_classSpan * c_countClasses;
+			static_assert(SizeBlock >= c_sizeMax && SizeBlock % alignof(max_align_t) == 0, "SizeBlock must hold an element of the largest class and keep spans aligned");
+
+			/// <summary>
+			/// Get the element size of a size class. 
+			/// </summary>
+			static constexpr size_t GetClassSize(size_t idxClass) {
+				return idxClass < 4 ? 16 * (idxClass + 1) : (size_t(64) << ((idxClass - 4) / 4)) + (size_t(16) << ((idxClass - 4) / 4)) * ((idxClass - 4) % 4 + 1);
+			}
+
+			/// <summary>
+			/// Get the smallest size class fitting a size. 
+			/// </summary>
+			/// <param name="size"> size in bytes (1 to c_sizeMax) </param>
+			static inline size_t GetClass(size_t size) {
+				if (size <= 64) {
+					return size <= 16 ? 0 : (size - 1) / 16;
+				}
+				const size_t sizeLess = size - 1;
+				size_t log2 = 6;
+				while ((sizeLess >> (log2 + 1)) != 0) ++log2;
+				return 4 + (log2 - 6) * 4 + ((sizeLess - (size_t(1) << log2)) >> (log2 - 2));
+			}
+
+			static_assert(GetClassSize(c_countClasses - 1) == c_sizeMax, "Size classes must end at c_sizeMax");
+
+		private:
+			template<size_t IdxClass>
+			using pool_type = LIWLGPoolAllocator<GetClassSize(IdxClass), uint32_t, SizeBlock / GetClassSize(IdxClass), CountBlock>;
+
+			template<class Seq> struct PoolTuple;
+			template<size_t... IdxClasses>
+			struct PoolTuple<std::index_sequence<IdxClasses...>> {
+				typedef std::tuple<typename pool_type<IdxClasses>::GlobalPoolAllocator...> global_type;
+				typedef std::tuple<typename pool_type<IdxClasses>::LocalPoolAllocator...> local_type;
+			};
+			typedef std::make_index_sequence<c_countClasses> class_sequence;
+
+		public:
+			class LocalSlabAllocator;
+			class GlobalSlabAllocator {
+				friend class LocalSlabAllocator;
+			public:
+				/// <summary>
+				/// Initialize memory buffer (with alignment) and the pool of each class. 
+				/// </summary>
+				void Init() {
+					size_t align = sizeof(max_align_t);
+					void* const dataBufferRaw = malloc(c_totalSize + align);
+					assert(dataBufferRaw);
+					void* const dataBuffer = liw_align_pointer(dataBufferRaw, align);
+
+					m_dataBuffer = (char*)dataBuffer;
+					m_dataBufferRaw = (char*)dataBufferRaw;
+					InitPools(class_sequence());
+				}
+
+				/// <summary>
+				/// Cleanup allocator. 
+				/// </summary>
+				void Cleanup() {
+					CleanupPools(class_sequence());
+					free(m_dataBufferRaw);
+					m_dataBuffer = nullptr;
+					m_dataBufferRaw = nullptr;
+				}
+
+			private:
+				char* m_dataBuffer		{ nullptr }; // Pointer to allocated space. (aligned)
+				char* m_dataBufferRaw	{ nullptr }; // Pointer to allocated space. (raw)
+				typename PoolTuple<class_sequence>::global_type m_pools; // Pool of each class
+
+				template<size_t... IdxClasses>
+				inline void InitPools(std::index_sequence<IdxClasses...>) {
+					(std::get<IdxClasses>(m_pools).Init(m_dataBuffer + IdxClasses * c_classSpan), ...);
+				}
+
+				template<size_t... IdxClasses>
+				inline void CleanupPools(std::index_sequence<IdxClasses...>) {
+					(std::get<IdxClasses>(m_pools).Cleanup(), ...);
+				}
+			};
+
+			class LocalSlabAllocator {
+			private:
+				typedef void* (*fetch_type)(LocalSlabAllocator&);
+				typedef void (*return_type)(LocalSlabAllocator&, void*);
+			public:
+				/// <summary>
+				/// Initialize with a corresponding global allocator. The pool of a class is only set up on its first use. 
+				/// </summary>
+				/// <param name="globalAllocator"> global allocator </param>
+				inline void Init(GlobalSlabAllocator& globalAllocator) {
+					m_globalAllocator = &globalAllocator;
+				}
+
+				/// <summary>
+				/// Allocate memory. 
+				/// </summary>
+				/// <param name="size"> size in bytes </param>
+				/// <returns> pointer to the allocation (aligned to 16) </returns>
+				inline void* Allocate(size_t size) {
+					if (size > c_sizeMax) {
+						return malloc(size);
+					}
+					return s_fetches[GetClass(size)](*this);
+				}
+
+				/// <summary>
+				/// Free memory. 
+				/// </summary>
+				/// <param name="ptr"> pointer to the allocation (may be allocated on another thread) </param>
+				inline void Free(void* ptr) {
+					const uintptr_t offset = (uintptr_t)ptr - (uintptr_t)m_globalAllocator->m_dataBuffer;
+					if (offset >= c_totalSize) { // Not from a class. Also true below the buffer, as the offset wraps around. 
+						free(ptr);
+						return;
+					}
+					s_returns[offset / c_classSpan](*this, ptr);
+				}
+
+				/// <summary>
+				/// Cleanup allocator. Gives back the blocks of each class. 
+				/// </summary>
+				inline void Cleanup() {
+					CleanupPools(class_sequence());
+					m_globalAllocator = nullptr;
+				}
+
+			private:
+				GlobalSlabAllocator* m_globalAllocator	{ nullptr }; // Reference to its global allocator. 
+				typename PoolTuple<class_sequence>::local_type m_pools; // Pool of each class
+
+				template<size_t IdxClass>
+				inline auto& GetPool() {
+					auto& pool = std::get<IdxClass>(m_pools);
+					if (!pool.IsInit()) {
+						pool.Init(std::get<IdxClass>(m_globalAllocator->m_pools));
+					}
+					return pool;
+				}
+
+				template<size_t IdxClass>
+				static void* FetchFrom(LocalSlabAllocator& allocator) {
+					return allocator.GetPool<IdxClass>().Fetch();
+				}
+
+				template<size_t IdxClass>
+				static void ReturnTo(LocalSlabAllocator& allocator, void* ptr) {
+					auto& pool = std::get<IdxClass>(allocator.m_pools);
+					if (pool.IsInit()) {
+						pool.Return(ptr);
+					}
+					else { // Never allocated from this class. Do not take a block just to free, push to the owner's remote list instead. 
+						std::get<IdxClass>(allocator.m_globalAllocator->m_pools).ReturnRemote(ptr);
+					}
+				}
+
+				template<size_t... IdxClasses>
+				static constexpr std::array<fetch_type, c_countClasses> MakeFetches(std::index_sequence<IdxClasses...>) {
+					return { { &FetchFrom<IdxClasses>... } };
+				}
+
+				template<size_t... IdxClasses>
+				static constexpr std::array<return_type, c_countClasses> MakeReturns(std::index_sequence<IdxClasses...>) {
+					return { { &ReturnTo<IdxClasses>... } };
+				}
+
+				template<size_t... IdxClasses>
+				inline void CleanupPools(std::index_sequence<IdxClasses...>) {
+					((std::get<IdxClasses>(m_pools).IsInit() ? std::get<IdxClasses>(m_pools).Cleanup() : void()), ...);
+				}
+
+				static constexpr std::array<fetch_type, c_countClasses> s_fetches = MakeFetches(class_sequence()); // Fetch of each class
+				static constexpr std::array<return_type, c_countClasses> s_returns = MakeReturns(class_sequence()); // Return of each class
+			};
+		};
+	}
+}
@@ -5,26 +5,55 @@
 #include <cstdio>
 #include <atomic>
 #include <vector>
+#include <mutex>
 
 #include "LIWAllocation.h"
 
 namespace LIW {
 	namespace Util {
+		/// <summary>
+		/// Allocation stats of a LocalStackAllocator. 
+		/// </summary>
+		struct LIWStackAllocatorStats {
+			size_t m_sizeAllocated	{ 0 }; // Bytes handed out. 
+			size_t m_sizePadding	{ 0 }; // Bytes skipped for alignment. 
+			size_t m_sizeWaste		{ 0 }; // Bytes left unused at the end of blocks given up. 
+			size_t m_countBlocks	{ 0 }; // Blocks taken from the global allocator. 
+			size_t m_countLarge		{ 0 }; // Requests served from their own blocks. 
+		};
+
+		/// <summary>
+		/// Position of a LocalStackAllocator to roll back to. 
+		/// </summary>
+		struct LIWStackMarker {
+			char* m_ptrBeg	{ nullptr }; // Start of the block at the time. 
+			char* m_ptrTop	{ nullptr }; // Top at the time. 
+		};
+
 		template<size_t SizeTotal, size_t SizeBlock>
 		class LIWLGStackAllocator {
 		
 		public:
 			static const size_t c_totalSize = SizeTotal;
 			static const size_t c_blockSize = SizeBlock;
+			static_assert(SizeBlock % alignof(max_align_t) == 0, "SizeBlock must keep blocks aligned to max_align_t");
+			static const size_t c_overflowSize = (SizeTotal / 4 + SizeBlock - 1) / SizeBlock * SizeBlock; // Least size of an overflow region
 		public:
 			class LocalStackAllocator;
+			/*
+			* GlobalStackAllocator hands out blocks by bumping the stack top with compare-exchange, never past the end of the buffer. 
+			* Once the buffer is used up, requests fail (nullptr) unless overflow chaining is on, 
+			* in which case they are served from additional regions allocated on demand and freed on Clear. 
+			* Every Clear starts a new epoch. Locals notice it on their next allocation and take a new block, instead of bumping a block handed out before the clear. 
+			*/
 			class GlobalStackAllocator {
 				friend class LocalStackAllocator;
 			public:
 				/// <summary>
 				/// Initialize memory buffer (with alignment). 
 				/// </summary>
-				void Init() {
+				/// <param name="isOverflowChained"> if requests past the buffer are served from additional regions </param>
+				void Init(bool isOverflowChained = false) {
 					size_t align = sizeof(max_align_t);
 					void* const dataBufferRaw = malloc(c_totalSize + align);
 					assert(dataBufferRaw);
@@ -35,75 +64,278 @@ namespace LIW {
 					m_dataBufferRaw = (char*)dataBufferRaw;
 					m_shift = (uintptr_t)dataBuffer - (uintptr_t)dataBufferRaw;
 					m_ptrTop = m_dataBuffer;
+					m_isOverflowChained = isOverflowChained;
 				}
 
 				/// <summary>
-				/// Allocate blocks of SizeBlock. 
+				/// Allocate blocks of SizeBlock. Lock-free unless a new overflow region is needed. 
 				/// </summary>
 				/// <param name="count"> number of blocks to allocate </param>
-				/// <returns> allocated block start pointer </returns>
+				/// <returns> allocated block start pointer (nullptr if out of space) </returns>
 				inline void* AllocateBlocks(size_t count) {
-					assert((uintptr_t)m_ptrTop.load(std::memory_order_relaxed) < (uintptr_t)m_dataBufferEnd); // Check stack top pointer still usable
-					return (void*)m_ptrTop.fetch_add(c_blockSize * count, std::memory_order_relaxed); // Return the next block
+					const size_t size = c_blockSize * count;
+					char* top = m_ptrTop.load(std::memory_order_relaxed);
+					do {
+						if ((size_t)(m_dataBufferEnd - top) < size) { // Past the buffer
+							return AllocateOverflow(size);
+						}
+					} while (!m_ptrTop.compare_exchange_weak(top, top + size, std::memory_order_relaxed));
+					return top;
 				}
 
 				/// <summary>
-				/// Clear allocated blocks. 
+				/// Clear allocated blocks and start a new epoch. Frees the overflow regions. (Not thread safe with allocations from this allocator)
 				/// </summary>
 				inline void Clear() {
 					//memset(m_dataBuffer, 0, sizeof(char) * c_totalSize);
 					m_ptrTop = m_dataBuffer;
+					FreeOverflowRegions();
+					m_epoch.fetch_add(1, std::memory_order_release);
 				}
 
 				/// <summary>
 				/// Cleanup allocator. 
 				/// </summary>
 				inline void Cleanup() {
+					FreeOverflowRegions();
 					free(m_dataBufferRaw);
 				}
+
+				/// <summary>
+				/// Get the number of requests that did not fit in the buffer (since Init). 
+				/// </summary>
+				inline uint64_t GetCountOverflows() const { return m_countOverflows.load(std::memory_order_relaxed); }
+
+				/// <summary>
+				/// Get the number of Clear calls (since Init). 
+				/// </summary>
+				inline uint64_t GetEpoch() const { return m_epoch.load(std::memory_order_acquire); }
+
+			private:
+				/// <summary>
+				/// Additional region for requests past the buffer. 
+				/// </summary>
+				struct LIWStackOverflowRegion {
+					LIWStackOverflowRegion* m_next		{ nullptr }; // Previously added region
+					std::atomic<char*> m_ptrTop			{ nullptr }; // Pointer to top of stack. 
+					char* m_dataBufferEnd				{ nullptr }; // Pointer to the end of the region. 
+				};
+
+				/// <summary>
+				/// Serve a request past the buffer. 
+				/// </summary>
+				/// <param name="size"> size of the request </param>
+				/// <returns> allocated block start pointer (nullptr if overflow chaining is off) </returns>
+				void* AllocateOverflow(size_t size) {
+					m_countOverflows.fetch_add(1, std::memory_order_relaxed);
+					if (!m_isOverflowChained) {
+						return nullptr;
+					}
+					LIWStackOverflowRegion* region = m_regionOverflow.load(std::memory_order_acquire);
+					while (true) {
+						if (region) {
+							char* top = region->m_ptrTop.load(std::memory_order_relaxed);
+							while ((size_t)(region->m_dataBufferEnd - top) >= size) {
+								if (region->m_ptrTop.compare_exchange_weak(top, top + size, std::memory_order_relaxed)) {
+									return top;
+								}
+							}
+						}
+						std::lock_guard<std::mutex> lk(m_mtxOverflow);
+						LIWStackOverflowRegion* const regionNow = m_regionOverflow.load(std::memory_order_acquire);
+						if (regionNow != region) { // Another thread added a region meanwhile
+							region = regionNow;
+							continue;
+						}
+						const size_t sizeRegion = size > c_overflowSize ? size : c_overflowSize;
+						const size_t align = sizeof(max_align_t);
+						char* const regionRaw = (char*)malloc(sizeof(LIWStackOverflowRegion) + align + sizeRegion);
+						if (!regionRaw) {
+							return nullptr;
+						}
+						region = new(regionRaw) LIWStackOverflowRegion();
+						char* const dataBuffer = liw_align_pointer(regionRaw + sizeof(LIWStackOverflowRegion), align);
+						region->m_next = regionNow;
+						region->m_ptrTop.store(dataBuffer + size, std::memory_order_relaxed); // This request takes the bottom
+						region->m_dataBufferEnd = dataBuffer + sizeRegion;
+						m_regionOverflow.store(region, std::memory_order_release);
+						return dataBuffer;
+					}
+				}
+
+				/// <summary>
+				/// Free all overflow regions. 
+				/// </summary>
+				inline void FreeOverflowRegions() {
+					LIWStackOverflowRegion* region = m_regionOverflow.exchange(nullptr, std::memory_order_acquire);
+					while (region) {
+						LIWStackOverflowRegion* const next = region->m_next;
+						region->~LIWStackOverflowRegion();
+						free(region);
+						region = next;
+					}
+				}
+
 			private:
 				char* m_dataBuffer			{ nullptr }; // Pointer to allocated space. (aligned)
 				char* m_dataBufferEnd		{ nullptr }; // Pointer to the end of allocated space. (aligned)
 				char* m_dataBufferRaw		{ nullptr }; // Pointer to allocated space. (raw)
 				ptrdiff_t m_shift			{ 0 }; // Shift from raw. 
 				std::atomic<char*> m_ptrTop	{ nullptr }; // Pointer to top of stack. 
+				bool m_isOverflowChained	{ false }; // If requests past the buffer are served from overflow regions. 
+				std::atomic<LIWStackOverflowRegion*> m_regionOverflow	{ nullptr }; // Latest overflow region (linked to the previous ones). 
+				std::mutex m_mtxOverflow; // Guards adding overflow regions. 
+				std::atomic<uint64_t> m_countOverflows	{ 0 }; // Requests that did not fit in the buffer. 
+				std::atomic<uint64_t> m_epoch			{ 0 }; // Count of Clear calls. 
 			};
 
+			/*
+			* LocalStackAllocator bumps within its current block. 
+			* Requests over half a block are served from their own blocks, and the current block is kept unless the new blocks leave a larger tail. 
+			* Allocations made after a marker can be freed at once with FreeToMarker, so markers nest like a stack. 
+			* Blocks taken after a marker are not given back to the global allocator, except the current one, which is reused. 
+			*/
 			class LocalStackAllocator {
 			public:
 				typedef LIWLGStackAllocator<SizeTotal, SizeBlock>::GlobalStackAllocator globalAllocator_type;
 			public:
 				/// <summary>
-				/// Initialize with a corresponding global allocator. 
+				/// Initialize with a corresponding global allocator. Resets stats. 
 				/// </summary>
 				/// <param name="globalAllocator"> pointer to a global allocator </param>
 				inline void Init(globalAllocator_type& globalAllocator) {
 					m_globalAllocator = &globalAllocator;
-					m_dataBuffer = (char*)m_globalAllocator->AllocateBlocks(1);
-					m_ptrTop = m_dataBuffer;
+					m_stats = LIWStackAllocatorStats();
+					m_sizeConsumed = 0;
+					m_epoch = m_globalAllocator->GetEpoch();
+					m_ptrTop = (char*)m_globalAllocator->AllocateBlocks(1);
+					m_ptrBeg = m_ptrTop;
+					m_ptrEnd = m_ptrTop ? m_ptrTop + c_blockSize : nullptr;
+					m_stats.m_countBlocks += m_ptrTop ? 1 : 0;
 				}
 
 				/// <summary>
 				/// Allocate a size of memory. 
 				/// </summary>
 				/// <param name="size"> size of memory to allocate </param>
-				/// <returns> allocated memory start pointer </returns>
-				inline void* Allocate(size_t size) {
-					size_t tmp = m_ptrTop - m_dataBuffer;
-					if (m_ptrTop - m_dataBuffer + size > c_blockSize) {
-						size_t blockCount = (size + c_blockSize - 1) / c_blockSize;
-						m_dataBuffer = (char*)m_globalAllocator->AllocateBlocks(blockCount); // Fetch block(s) from global allocator (which will incur contention)
-						m_ptrTop = m_dataBuffer; // Reset marker (Note: could cause memory waste in the last block)
+				/// <param name="align"> alignment (power of 2) </param>
+				/// <returns> allocated memory start pointer (nullptr if out of space) </returns>
+				inline void* Allocate(size_t size, size_t align = alignof(max_align_t)) {
+					if (m_epoch != m_globalAllocator->GetEpoch()) { // Cleared since the current block was taken
+						ReleaseBlock();
+					}
+					char* const ptr = liw_align_pointer(m_ptrTop, align);
+					if (ptr <= m_ptrEnd && (size_t)(m_ptrEnd - ptr) >= size && m_ptrTop) {
+						m_stats.m_sizeAllocated += size;
+						m_ptrTop = ptr + size;
+						return ptr;
 					}
-					char* m_ptrTopTmp = m_ptrTop;
-					m_ptrTop += size;
-					return m_ptrTopTmp;
+					return AllocateFromNewBlocks(size, align);
 				}
+
+				/// <summary>
+				/// Give up the current block, and take the epoch of the global allocator. The next allocation takes a new block. 
+				/// </summary>
+				inline void ReleaseBlock() {
+					m_stats.m_sizeWaste += m_ptrEnd - m_ptrTop;
+					m_sizeConsumed += m_ptrTop - m_ptrBeg;
+					m_ptrTop = nullptr;
+					m_ptrBeg = nullptr;
+					m_ptrEnd = nullptr;
+					m_epoch = m_globalAllocator->GetEpoch();
+				}
+
+				/// <summary>
+				/// Get a marker of the current position. Valid until the global allocator is cleared or this allocator is re-initialized. 
+				/// </summary>
+				inline LIWStackMarker GetMarker() const {
+					return LIWStackMarker{ m_ptrBeg, m_ptrTop };
+				}
+
+				/// <summary>
+				/// Free all allocations made after a marker. Markers taken after it become invalid. 
+				/// </summary>
+				/// <param name="marker"> marker from GetMarker of this allocator </param>
+				inline void FreeToMarker(const LIWStackMarker& marker) {
+					if (marker.m_ptrBeg == m_ptrBeg) { // Still in the same block
+						assert(marker.m_ptrTop <= m_ptrTop); // Marker must be older than the top
+						m_sizeConsumed += m_ptrTop - marker.m_ptrTop;
+						m_ptrTop = marker.m_ptrTop;
+					}
+					else { // The current block was taken after the marker, so it is all free again and at least as large as the tail of the marker's block. 
+						m_sizeConsumed += m_ptrTop - m_ptrBeg;
+						m_ptrTop = m_ptrBeg;
+					}
+				}
+
+				/// <summary>
+				/// Get allocation stats since Init. Bytes reused after FreeToMarker are counted again. 
+				/// </summary>
+				inline LIWStackAllocatorStats GetStats() const {
+					LIWStackAllocatorStats stats = m_stats;
+					stats.m_sizePadding = m_sizeConsumed + (m_ptrTop - m_ptrBeg) - stats.m_sizeAllocated; // Padding is not counted per allocation to keep it cheap
+					return stats;
+				}
+
 			private:
-				char* m_dataBuffer						{ nullptr }; // Pointer to allocated space. 
 				char* m_ptrTop							{ nullptr }; // Pointer to the end of allocated space. 
+				char* m_ptrBeg							{ nullptr }; // Pointer to the start of the current block. 
+				char* m_ptrEnd							{ nullptr }; // Pointer to the end of the current block. 
 				globalAllocator_type* m_globalAllocator	{ nullptr }; // Pointer to the global allocator.
+				LIWStackAllocatorStats m_stats; // Allocation stats of this allocator (padding excluded). 
+				size_t m_sizeConsumed					{ 0 }; // Bytes used (allocated or padding) in blocks given up. 
+				uint64_t m_epoch						{ 0 }; // Epoch of the global allocator when the current block was taken. 
+
+				/// <summary>
+				/// Allocate from new block(s) when the current block cannot fit the request. 
+				/// </summary>
+				void* AllocateFromNewBlocks(size_t size, size_t align) {
+					const size_t sizeRequired = size + (align > alignof(max_align_t) ? align - alignof(max_align_t) : 0); // Blocks are aligned to max_align_t
+					const size_t sizeRemaining = m_ptrTop ? m_ptrEnd - m_ptrTop : 0;
+					const size_t countBlocks = sizeRequired > c_blockSize / 2 ? (sizeRequired + c_blockSize - 1) / c_blockSize : 1;
+					char* const blocks = (char*)m_globalAllocator->AllocateBlocks(countBlocks); // Fetch block(s) from global allocator (which will incur contention)
+					if (!blocks) { // Out of space
+						return nullptr;
+					}
+					char* const blocksEnd = blocks + countBlocks * c_blockSize;
+					char* const ptr = liw_align_pointer(blocks, align);
+					m_stats.m_countBlocks += countBlocks;
+					m_stats.m_sizeAllocated += size;
+					if (sizeRequired > c_blockSize / 2) { // Large. Keep the larger of the two tails. 
+						++m_stats.m_countLarge;
+						if ((size_t)(blocksEnd - (ptr + size)) <= sizeRemaining) {
+							m_stats.m_sizeWaste += blocksEnd - (ptr + size);
+							m_sizeConsumed += ptr + size - blocks;
+							return ptr;
+						}
+					}
+					m_stats.m_sizeWaste += sizeRemaining;
+					m_sizeConsumed += m_ptrTop - m_ptrBeg;
+					m_ptrTop = ptr + size;
+					m_ptrBeg = blocks;
+					m_ptrEnd = blocksEnd;
+					return ptr;
+				}
 			};
 		};
+
+		/*
+		* LIWStackScope frees the allocations made in its lifetime on exit. Scopes of the same allocator must nest. 
+		*/
+		template<class LocalAllocator>
+		class LIWStackScope {
+		public:
+			explicit LIWStackScope(LocalAllocator& allocator) :
+				m_allocator(allocator), m_marker(allocator.GetMarker()) { }
+			~LIWStackScope() {
+				m_allocator.FreeToMarker(m_marker);
+			}
+			LIWStackScope(const LIWStackScope&) = delete;
+			LIWStackScope& operator=(const LIWStackScope&) = delete;
+
+		private:
+			LocalAllocator& m_allocator; // Allocator to roll back. 
+			LIWStackMarker m_marker; // Position on entry. 
+		};
 	}
 }
@@ -0,0 +1,40 @@
+#include "LIWMemory.h"
+
+//
+// Default memory allocation
+//
+DefaultBufferAllocator::GlobalGPAllocator DefaultMemBuffer::s_defaultBufferGAllocator;
+thread_local DefaultBufferAllocator::LocalGPAllocator DefaultMemBuffer::tl_defaultBufferLAllocator;
+
+//
+// Static buffer
+//
+StaticBufferAllocator::GlobalStackAllocator StaticMemBuffer::s_staticBufferGAllocator;
+thread_local StaticBufferAllocator::LocalStackAllocator StaticMemBuffer::tl_staticBufferLAllocator;
+
+//
+// Per frame buffer
+//
+FrameBufferAllocator::GlobalStackAllocator FrameMemBuffer::s_frameBufferGAllocator;
+thread_local FrameBufferAllocator::LocalStackAllocator FrameMemBuffer::tl_frameBufferLAllocator;
+
+//
+// Multi frame buffer
+//
+std::atomic<uint64_t> DFrameBuffer::g_dframeEpoch{ 0 };
+DFrameBufferAllocator::GlobalStackAllocator DFrameBuffer::g_dframeBufferGAllocator[COUNT_MEM_DFRAME_BUFFER];
+thread_local DFrameBufferAllocator::LocalStackAllocator DFrameBuffer::tl_dframeBufferLAllocator[COUNT_MEM_DFRAME_BUFFER];
+
+//
+// Pool
+//
+std::mutex PoolMemBuffer::s_mtxCleanups;
+std::vector<void(*)()> PoolMemBuffer::s_cleanups;
+std::atomic<uint64_t> PoolMemBuffer::s_generation{ 1 };
+thread_local std::vector<void(*)()> PoolMemBuffer::tl_cleanups;
+
+//
+// Slab
+//
+SlabBufferAllocator::GlobalSlabAllocator SlabMemBuffer::s_slabBufferGAllocator;
+thread_local SlabBufferAllocator::LocalSlabAllocator SlabMemBuffer::tl_slabBufferLAllocator;
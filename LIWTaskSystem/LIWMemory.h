@@ -1,12 +1,16 @@
 #pragma once
 #include <memory>
+#include <mutex>
+#include <vector>
 #include "LIWTypes.h"
 #include "LIWLGStackAllocator.h"
 #include "LIWLGGPAllocator.h"
+#include "LIWObjectPool.h"
+#include "LIWLGSlabAllocator.h"
 
-inline const liw_memory_size_type operator""_KB(liw_memory_size_type const x) { return 1024 * x; }
-inline const liw_memory_size_type operator""_MB(liw_memory_size_type const x) { return 1024 * 1024 * x; }
-inline const liw_memory_size_type operator""_GB(liw_memory_size_type const x) { return 1024 * 1024 * 1024 * x; }
+inline const liw_memory_size_type operator""_KB(unsigned long long const x) { return (liw_memory_size_type)(1024 * x); }
+inline const liw_memory_size_type operator""_MB(unsigned long long const x) { return (liw_memory_size_type)(1024 * 1024 * x); }
+inline const liw_memory_size_type operator""_GB(unsigned long long const x) { return (liw_memory_size_type)(1024 * 1024 * 1024 * x); }
 
 
 /*
@@ -20,6 +24,12 @@ inline const liw_memory_size_type operator""_GB(liw_memory_size_type const x) {
 * liw_minit_MODE_thd:		initialize (once per run per thread)
 * liw_mupdate_MODE_thd:		update (once per post frame per thread)
 * liw_mclnup_MODE_thd:		cleanup (once per run per thread)
+* liw_mstats_MODE_thd:		allocation stats of this thread (stack modes: static, frame, dframe)
+* 
+* // Scratch functions (static, frame)
+* liw_mmarker_MODE:			get a marker of this thread
+* liw_mfree_to_marker_MODE:	free allocations of this thread made after a marker
+* liw_mscope_MODE:			get a scope freeing allocations of this thread made in it on exit
 * 
 * // Memory access functions
 * liw_maddr_MODE:			get raw address
@@ -29,6 +39,9 @@ inline const liw_memory_size_type operator""_GB(liw_memory_size_type const x) {
 * liw_free_MODE:			free
 * liw_new_MODE:				new
 * liw_delete_MODE:			delete
+* 
+* NOTE: Pool mode (pool) only has typed new/delete. 
+* NOTE: Fiber mode (fiber) is in LIWFiberScratchMemory.h, so the memory subsystem does not depend on fibers. 
 */
 
 
@@ -88,8 +101,6 @@ struct DefaultMemBuffer
 	static DefaultBufferAllocator::GlobalGPAllocator s_defaultBufferGAllocator;
 	static thread_local DefaultBufferAllocator::LocalGPAllocator tl_defaultBufferLAllocator;
 };
-DefaultBufferAllocator::GlobalGPAllocator DefaultMemBuffer::s_defaultBufferGAllocator;
-thread_local DefaultBufferAllocator::LocalGPAllocator DefaultMemBuffer::tl_defaultBufferLAllocator;
 
 inline void liw_minit_def() {
 	DefaultMemBuffer::s_defaultBufferGAllocator.Init();
@@ -170,11 +181,9 @@ struct StaticMemBuffer
 	static StaticBufferAllocator::GlobalStackAllocator s_staticBufferGAllocator;
 	static thread_local StaticBufferAllocator::LocalStackAllocator tl_staticBufferLAllocator;
 };
-StaticBufferAllocator::GlobalStackAllocator StaticMemBuffer::s_staticBufferGAllocator;
-thread_local StaticBufferAllocator::LocalStackAllocator StaticMemBuffer::tl_staticBufferLAllocator;
 
 inline void liw_minit_static() {
-	StaticMemBuffer::s_staticBufferGAllocator.Init();
+	StaticMemBuffer::s_staticBufferGAllocator.Init(true);
 }
 
 inline void liw_mupdate_static() {
@@ -198,6 +207,10 @@ inline void liw_mclnup_static_thd() {
 
 }
 
+inline LIW::Util::LIWStackAllocatorStats liw_mstats_static_thd() {
+	return StaticMemBuffer::tl_staticBufferLAllocator.GetStats();
+}
+
 inline void* liw_maddr_static(liw_hdl_type handle) {
 	return (void*)handle;
 }
@@ -216,8 +229,20 @@ inline T liw_mget_static(liw_hdl_type handle) {
 	return std::move(*((T*)handle));
 }
 
-inline liw_hdl_type liw_malloc_static(liw_memory_size_type size) {
-	return (liw_hdl_type)StaticMemBuffer::tl_staticBufferLAllocator.Allocate(size);
+inline liw_hdl_type liw_malloc_static(liw_memory_size_type size, size_t align = alignof(max_align_t)) {
+	return (liw_hdl_type)StaticMemBuffer::tl_staticBufferLAllocator.Allocate(size, align);
+}
+
+inline LIW::Util::LIWStackMarker liw_mmarker_static() {
+	return StaticMemBuffer::tl_staticBufferLAllocator.GetMarker();
+}
+
+inline void liw_mfree_to_marker_static(const LIW::Util::LIWStackMarker& marker) {
+	StaticMemBuffer::tl_staticBufferLAllocator.FreeToMarker(marker);
+}
+
+inline LIW::Util::LIWStackScope<StaticBufferAllocator::LocalStackAllocator> liw_mscope_static() {
+	return LIW::Util::LIWStackScope<StaticBufferAllocator::LocalStackAllocator>(StaticMemBuffer::tl_staticBufferLAllocator);
 }
 
 inline void liw_free_static(liw_hdl_type handle) {
@@ -226,7 +251,7 @@ inline void liw_free_static(liw_hdl_type handle) {
 
 template<class T, class ... Args>
 inline liw_hdl_type liw_new_static(Args&&... args) {
-	T* ptr = (T*)liw_malloc_static(sizeof(T));
+	T* ptr = (T*)liw_malloc_static(sizeof(T), alignof(T));
 	return (liw_hdl_type)(new(ptr)T(std::forward<Args>(args)...));
 }
 
@@ -248,11 +273,9 @@ struct FrameMemBuffer
 	static FrameBufferAllocator::GlobalStackAllocator s_frameBufferGAllocator;
 	static thread_local FrameBufferAllocator::LocalStackAllocator tl_frameBufferLAllocator;
 };
-FrameBufferAllocator::GlobalStackAllocator FrameMemBuffer::s_frameBufferGAllocator;
-thread_local FrameBufferAllocator::LocalStackAllocator FrameMemBuffer::tl_frameBufferLAllocator;
 
 inline void liw_minit_frame() {
-	FrameMemBuffer::s_frameBufferGAllocator.Init();
+	FrameMemBuffer::s_frameBufferGAllocator.Init(true); // A frame spike overflows into additional regions until the next clear
 }
 
 inline void liw_mupdate_frame() {
@@ -276,6 +299,10 @@ inline void liw_mclnup_frame_thd() {
 
 }
 
+inline LIW::Util::LIWStackAllocatorStats liw_mstats_frame_thd() {
+	return FrameMemBuffer::tl_frameBufferLAllocator.GetStats();
+}
+
 inline void* liw_maddr_frame(liw_hdl_type handle) {
 	return (void*)handle;
 }
@@ -294,8 +321,20 @@ inline T liw_mget_frame(liw_hdl_type handle) {
 	return std::move(*((T*)handle));
 }
 
-inline liw_hdl_type liw_malloc_frame(liw_memory_size_type size) {
-	return (liw_hdl_type)FrameMemBuffer::tl_frameBufferLAllocator.Allocate(size);
+inline liw_hdl_type liw_malloc_frame(liw_memory_size_type size, size_t align = alignof(max_align_t)) {
+	return (liw_hdl_type)FrameMemBuffer::tl_frameBufferLAllocator.Allocate(size, align);
+}
+
+inline LIW::Util::LIWStackMarker liw_mmarker_frame() {
+	return FrameMemBuffer::tl_frameBufferLAllocator.GetMarker();
+}
+
+inline void liw_mfree_to_marker_frame(const LIW::Util::LIWStackMarker& marker) {
+	FrameMemBuffer::tl_frameBufferLAllocator.FreeToMarker(marker);
+}
+
+inline LIW::Util::LIWStackScope<FrameBufferAllocator::LocalStackAllocator> liw_mscope_frame() {
+	return LIW::Util::LIWStackScope<FrameBufferAllocator::LocalStackAllocator>(FrameMemBuffer::tl_frameBufferLAllocator);
 }
 
 inline void liw_free_frame(liw_hdl_type handle) {
@@ -304,7 +343,7 @@ inline void liw_free_frame(liw_hdl_type handle) {
 
 template<class T, class ... Args>
 inline liw_hdl_type liw_new_frame(Args&&... args) {
-	T* ptr = (T*)liw_malloc_frame(sizeof(T));
+	T* ptr = (T*)liw_malloc_frame(sizeof(T), alignof(T));
 	return (liw_hdl_type)(new(ptr)T(std::forward<Args>(args)...));
 }
 
@@ -316,40 +355,45 @@ inline void liw_delete_frame(liw_hdl_type handle) {
 
 
 //
-// Double frame buffer
+// Multi frame buffer
+// An allocation made in a frame stays valid for COUNT_MEM_DFRAME_BUFFER frames (this one and the following ones), each frame using its own buffer in turn. 
+// liw_mupdate_dframe clears the buffer of the next frame, then moves the frame epoch on. Locals take new blocks lazily when their buffer has been cleared. 
+// It may run while other threads allocate, as long as a single allocation does not span COUNT_MEM_DFRAME_BUFFER - 1 updates. 
 //
 
 const size_t SIZE_MEM_DFRAME_BUFFER = size_t{ 1 } << 26; // 64MB
 const size_t SIZE_MEM_DFRAME_BUFFER_BLOCK = size_t{ 1 } << 16; // 64KB
+const size_t COUNT_MEM_DFRAME_BUFFER = 3; // Frames an allocation lives for
 typedef LIW::Util::LIWLGStackAllocator<SIZE_MEM_DFRAME_BUFFER, SIZE_MEM_DFRAME_BUFFER_BLOCK> DFrameBufferAllocator;
 struct DFrameBuffer {
-	static DFrameBufferAllocator::GlobalStackAllocator g_dframeBufferGAllocator[2];
-	static thread_local DFrameBufferAllocator::LocalStackAllocator tl_dframeBufferLAllocator[2];
-	static int g_dframeIdx;
+	static DFrameBufferAllocator::GlobalStackAllocator g_dframeBufferGAllocator[COUNT_MEM_DFRAME_BUFFER];
+	static thread_local DFrameBufferAllocator::LocalStackAllocator tl_dframeBufferLAllocator[COUNT_MEM_DFRAME_BUFFER];
+	static std::atomic<uint64_t> g_dframeEpoch; // Current frame. Its buffer is g_dframeEpoch % COUNT_MEM_DFRAME_BUFFER. 
 };
-int DFrameBuffer::g_dframeIdx{ 0 };
-DFrameBufferAllocator::GlobalStackAllocator DFrameBuffer::g_dframeBufferGAllocator[2];
-thread_local DFrameBufferAllocator::LocalStackAllocator DFrameBuffer::tl_dframeBufferLAllocator[2];
 
 inline void liw_minit_dframe() {
-	DFrameBuffer::g_dframeBufferGAllocator[0].Init();
-	DFrameBuffer::g_dframeBufferGAllocator[1].Init();
-	DFrameBuffer::g_dframeIdx = 0;
+	for (size_t idx = 0; idx < COUNT_MEM_DFRAME_BUFFER; ++idx) {
+		DFrameBuffer::g_dframeBufferGAllocator[idx].Init(true);
+	}
+	DFrameBuffer::g_dframeEpoch.store(0, std::memory_order_relaxed);
 }
 
 inline void liw_mupdate_dframe() {
-	DFrameBuffer::g_dframeBufferGAllocator[DFrameBuffer::g_dframeIdx].Clear();
-	DFrameBuffer::g_dframeIdx = !DFrameBuffer::g_dframeIdx;
+	const uint64_t epochNext = DFrameBuffer::g_dframeEpoch.load(std::memory_order_relaxed) + 1;
+	DFrameBuffer::g_dframeBufferGAllocator[epochNext % COUNT_MEM_DFRAME_BUFFER].Clear(); // Allocations in it have expired
+	DFrameBuffer::g_dframeEpoch.store(epochNext, std::memory_order_release);
 }
 
 inline void liw_mclnup_dframe() {
-	DFrameBuffer::g_dframeBufferGAllocator[0].Cleanup();
-	DFrameBuffer::g_dframeBufferGAllocator[1].Cleanup();
+	for (size_t idx = 0; idx < COUNT_MEM_DFRAME_BUFFER; ++idx) {
+		DFrameBuffer::g_dframeBufferGAllocator[idx].Cleanup();
+	}
 }
 
 inline void liw_minit_dframe_thd() {
-	DFrameBuffer::tl_dframeBufferLAllocator[0].Init(DFrameBuffer::g_dframeBufferGAllocator[0]);
-	DFrameBuffer::tl_dframeBufferLAllocator[1].Init(DFrameBuffer::g_dframeBufferGAllocator[1]);
+	for (size_t idx = 0; idx < COUNT_MEM_DFRAME_BUFFER; ++idx) {
+		DFrameBuffer::tl_dframeBufferLAllocator[idx].Init(DFrameBuffer::g_dframeBufferGAllocator[idx]);
+	}
 }
 
 inline void liw_mupdate_dframe_thd() {
@@ -360,6 +404,19 @@ inline void liw_mclnup_dframe_thd() {
 
 }
 
+inline LIW::Util::LIWStackAllocatorStats liw_mstats_dframe_thd() {
+	LIW::Util::LIWStackAllocatorStats stats = DFrameBuffer::tl_dframeBufferLAllocator[0].GetStats();
+	for (size_t idx = 1; idx < COUNT_MEM_DFRAME_BUFFER; ++idx) {
+		const LIW::Util::LIWStackAllocatorStats statsBuffer = DFrameBuffer::tl_dframeBufferLAllocator[idx].GetStats();
+		stats.m_sizeAllocated += statsBuffer.m_sizeAllocated;
+		stats.m_sizePadding += statsBuffer.m_sizePadding;
+		stats.m_sizeWaste += statsBuffer.m_sizeWaste;
+		stats.m_countBlocks += statsBuffer.m_countBlocks;
+		stats.m_countLarge += statsBuffer.m_countLarge;
+	}
+	return stats;
+}
+
 inline void* liw_maddr_dframe(liw_hdl_type handle) {
 	return (void*)handle;
 }
@@ -378,8 +435,9 @@ inline T liw_mget_dframe(liw_hdl_type handle) {
 	return std::move(*((T*)handle));
 }
 
-inline liw_hdl_type liw_malloc_dframe(liw_memory_size_type size) {
-	return (liw_hdl_type)DFrameBuffer::tl_dframeBufferLAllocator[DFrameBuffer::g_dframeIdx].Allocate(size);
+inline liw_hdl_type liw_malloc_dframe(liw_memory_size_type size, size_t align = alignof(max_align_t)) {
+	const uint64_t epoch = DFrameBuffer::g_dframeEpoch.load(std::memory_order_acquire);
+	return (liw_hdl_type)DFrameBuffer::tl_dframeBufferLAllocator[epoch % COUNT_MEM_DFRAME_BUFFER].Allocate(size, align);
 }
 
 inline void liw_free_dframe(liw_hdl_type handle) {
@@ -388,7 +446,7 @@ inline void liw_free_dframe(liw_hdl_type handle) {
 
 template<class T, class ... Args>
 inline liw_hdl_type liw_new_dframe(Args&&... args) {
-	T* ptr = (T*)liw_malloc_dframe(sizeof(T));
+	T* ptr = (T*)liw_malloc_dframe(sizeof(T), alignof(T));
 	return (liw_hdl_type)(new(ptr)T(std::forward<Args>(args)...));
 }
 
@@ -399,6 +457,219 @@ inline void liw_delete_dframe(liw_hdl_type handle) {
 }
 
 
+//
+// Pool (fixed size objects, a pool per type)
+//
+
+const size_t COUNT_MEM_POOL_ELEMENT_BLOCK = 256; // Objects per block
+const size_t COUNT_MEM_POOL_BLOCK = 1024; // Blocks per type (around 256K objects)
+struct PoolMemBuffer {
+	static std::mutex s_mtxCleanups;
+	static std::vector<void(*)()> s_cleanups; // Cleanups of the global pools initialized
+	static std::atomic<uint64_t> s_generation; // Run of the pools (starts at 1). liw_mclnup_pool moves it on, so pools of a type are initialized again on their next use. 
+	static thread_local std::vector<void(*)()> tl_cleanups; // Cleanups of the local pools initialized on this thread
+};
+template<class T>
+struct PoolMemBufferOf {
+	typedef LIW::Util::LIWObjectPool<T, COUNT_MEM_POOL_ELEMENT_BLOCK, COUNT_MEM_POOL_BLOCK> PoolAllocator;
+	static typename PoolAllocator::GlobalObjectPool s_poolGAllocator;
+	static std::atomic<uint64_t> s_poolGeneration; // Run the global pool is initialized for (0 if never)
+	static thread_local typename PoolAllocator::LocalObjectPool tl_poolLAllocator;
+	static thread_local uint64_t tl_poolGeneration; // Run the local pool is initialized for (0 if not)
+
+	// Get the local pool of this thread. Pools of a type are initialized on its first use in a run. 
+	static inline typename PoolAllocator::LocalObjectPool& GetLocal() {
+		const uint64_t generation = PoolMemBuffer::s_generation.load(std::memory_order_acquire);
+		if (tl_poolGeneration != generation) {
+			InitLocal(generation);
+		}
+		return tl_poolLAllocator;
+	}
+
+	// Destroy an object and return it. A thread which has not fetched T in this run returns it remotely, rather than taking a block just to free. 
+	static inline void Return(T* ptr) {
+		if (tl_poolGeneration != PoolMemBuffer::s_generation.load(std::memory_order_acquire)) {
+			ptr->~T();
+			s_poolGAllocator.ReturnRemote(ptr); // Fetched in this run, so the global pool is initialized
+			return;
+		}
+		tl_poolLAllocator.Return(ptr);
+	}
+
+	static void InitLocal(uint64_t generation) {
+		if (s_poolGeneration.load(std::memory_order_acquire) != generation) {
+			std::lock_guard<std::mutex> lk(PoolMemBuffer::s_mtxCleanups);
+			if (s_poolGeneration.load(std::memory_order_relaxed) != generation) {
+				s_poolGAllocator.Init();
+				PoolMemBuffer::s_cleanups.push_back([]() { s_poolGAllocator.Cleanup(); });
+				s_poolGeneration.store(generation, std::memory_order_release);
+			}
+		}
+		if (tl_poolGeneration == 0) {
+			PoolMemBuffer::tl_cleanups.push_back(CleanupLocal);
+		}
+		tl_poolLAllocator = typename PoolAllocator::LocalObjectPool(); // Drop a pool left from a previous run. Its global pool is gone, so it must not be cleaned up. 
+		tl_poolLAllocator.Init(s_poolGAllocator);
+		tl_poolGeneration = generation;
+	}
+
+	static void CleanupLocal() {
+		if (tl_poolGeneration == PoolMemBuffer::s_generation.load(std::memory_order_acquire)) {
+			tl_poolLAllocator.Cleanup();
+		}
+		tl_poolLAllocator = typename PoolAllocator::LocalObjectPool();
+		tl_poolGeneration = 0;
+	}
+};
+template<class T>
+typename PoolMemBufferOf<T>::PoolAllocator::GlobalObjectPool PoolMemBufferOf<T>::s_poolGAllocator;
+template<class T>
+std::atomic<uint64_t> PoolMemBufferOf<T>::s_poolGeneration{ 0 };
+template<class T>
+thread_local typename PoolMemBufferOf<T>::PoolAllocator::LocalObjectPool PoolMemBufferOf<T>::tl_poolLAllocator;
+template<class T>
+thread_local uint64_t PoolMemBufferOf<T>::tl_poolGeneration{ 0 };
+
+inline void liw_minit_pool() {
+
+}
+
+inline void liw_mupdate_pool() {
+
+}
+
+// No thread may use pool mode meanwhile. Local pools of the run are dropped on their next use (or liw_mclnup_pool_thd) without touching the freed global pools. 
+inline void liw_mclnup_pool() {
+	std::lock_guard<std::mutex> lk(PoolMemBuffer::s_mtxCleanups);
+	for (auto cleanup : PoolMemBuffer::s_cleanups) {
+		cleanup();
+	}
+	PoolMemBuffer::s_cleanups.clear();
+	PoolMemBuffer::s_generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+inline void liw_minit_pool_thd() {
+
+}
+
+inline void liw_mupdate_pool_thd() {
+
+}
+
+inline void liw_mclnup_pool_thd() {
+	for (auto cleanup : PoolMemBuffer::tl_cleanups) {
+		cleanup();
+	}
+	PoolMemBuffer::tl_cleanups.clear();
+}
+
+inline void* liw_maddr_pool(liw_hdl_type handle) {
+	return (void*)handle;
+}
+
+template<class T>
+inline void liw_mset_pool(liw_hdl_type handle, const T& val) {
+	*((T*)handle) = val;
+}
+template<class T>
+inline void liw_mset_pool(liw_hdl_type handle, T&& val) {
+	*((T*)handle) = val;
+}
+
+template<class T>
+inline T liw_mget_pool(liw_hdl_type handle) {
+	return std::move(*((T*)handle));
+}
+
+template<class T, class ... Args>
+inline liw_hdl_type liw_new_pool(Args&&... args) {
+	return (liw_hdl_type)PoolMemBufferOf<T>::GetLocal().Fetch(std::forward<Args>(args)...);
+}
+
+template<class T>
+inline void liw_delete_pool(liw_hdl_type handle) {
+	PoolMemBufferOf<T>::Return((T*)handle);
+}
+
+
+//
+// Slab (small variable size allocations in size classes)
+//
+
+const size_t SIZE_MEM_SLAB_BLOCK = size_t{ 1 } << 16; // 64KB
+const size_t COUNT_MEM_SLAB_BLOCK = 1024; // Blocks per size class (64MB each)
+typedef LIW::Util::LIWLGSlabAllocator<SIZE_MEM_SLAB_BLOCK, COUNT_MEM_SLAB_BLOCK> SlabBufferAllocator;
+struct SlabMemBuffer
+{
+	static SlabBufferAllocator::GlobalSlabAllocator s_slabBufferGAllocator;
+	static thread_local SlabBufferAllocator::LocalSlabAllocator tl_slabBufferLAllocator;
+};
+
+inline void liw_minit_slab() {
+	SlabMemBuffer::s_slabBufferGAllocator.Init();
+}
+
+inline void liw_mupdate_slab() {
+
+}
+
+inline void liw_mclnup_slab() {
+	SlabMemBuffer::s_slabBufferGAllocator.Cleanup();
+}
+
+inline void liw_minit_slab_thd() {
+	SlabMemBuffer::tl_slabBufferLAllocator.Init(SlabMemBuffer::s_slabBufferGAllocator);
+}
+
+inline void liw_mupdate_slab_thd() {
+
+}
+
+inline void liw_mclnup_slab_thd() {
+	SlabMemBuffer::tl_slabBufferLAllocator.Cleanup();
+}
+
+inline void* liw_maddr_slab(liw_hdl_type handle) {
+	return (void*)handle;
+}
+
+template<class T>
+inline void liw_mset_slab(liw_hdl_type handle, const T& val) {
+	*((T*)handle) = val;
+}
+template<class T>
+inline void liw_mset_slab(liw_hdl_type handle, T&& val) {
+	*((T*)handle) = val;
+}
+
+template<class T>
+inline T liw_mget_slab(liw_hdl_type handle) {
+	return std::move(*((T*)handle));
+}
+
+inline liw_hdl_type liw_malloc_slab(liw_memory_size_type size) {
+	return (liw_hdl_type)SlabMemBuffer::tl_slabBufferLAllocator.Allocate(size);
+}
+
+inline void liw_free_slab(liw_hdl_type handle) {
+	SlabMemBuffer::tl_slabBufferLAllocator.Free((void*)handle);
+}
+
+template<class T, class ... Args>
+inline liw_hdl_type liw_new_slab(Args&&... args) {
+	static_assert(alignof(T) <= 16, "Over-aligned T is not supported by slab mode (allocations are aligned to 16)");
+	T* ptr = (T*)liw_malloc_slab(sizeof(T));
+	return (liw_hdl_type)(new(ptr)T(std::forward<Args>(args)...));
+}
+
+template<class T>
+inline void liw_delete_slab(liw_hdl_type handle) {
+	static_assert(alignof(T) <= 16, "Over-aligned T is not supported by slab mode (allocations are aligned to 16)");
+	((T*)handle)->~T();
+	liw_free_slab(handle);
+}
+
+
 //
 // LIW memory interface
 //
@@ -408,6 +679,8 @@ enum LIWMemAllocation {
 	LIWMem_Static,
 	LIWMem_Frame,
 	LIWMem_DFrame,
+	LIWMem_Pool,
+	LIWMem_Slab,
 	LIWMem_Max
 };
 
@@ -415,107 +688,155 @@ enum LIWMemAllocation {
 template<LIWMemAllocation MemAlloc>
 inline void* liw_maddr(liw_hdl_type handle) {
 	static_assert(MemAlloc < LIWMem_Max, "Must use a valid LIWMemAllocation enum. ");
-	switch (MemAlloc)
-	{
-	case LIWMem_System:
+	if constexpr (MemAlloc == LIWMem_System) {
 		return liw_maddr_sys(handle);
-	case LIWMem_Default:
+	}
+	else if constexpr (MemAlloc == LIWMem_Default) {
 		return liw_maddr_def(handle);
-	case LIWMem_Static:
+	}
+	else if constexpr (MemAlloc == LIWMem_Static) {
 		return liw_maddr_static(handle);
-	case LIWMem_Frame:
+	}
+	else if constexpr (MemAlloc == LIWMem_Frame) {
 		return liw_maddr_frame(handle);
-	case LIWMem_DFrame:
+	}
+	else if constexpr (MemAlloc == LIWMem_DFrame) {
 		return liw_maddr_dframe(handle);
 	}
+	else if constexpr (MemAlloc == LIWMem_Pool) {
+		return liw_maddr_pool(handle);
+	}
+	else if constexpr (MemAlloc == LIWMem_Slab) {
+		return liw_maddr_slab(handle);
+	}
 }
 
 template<LIWMemAllocation MemAlloc, class T>
 inline void liw_mset(liw_hdl_type handle, T&& val) {
 	static_assert(MemAlloc < LIWMem_Max, "Must use a valid LIWMemAllocation enum. ");
-	switch (MemAlloc)
-	{
-	case LIWMem_System:
-		liw_mset_sys<T>(handle, std::forward<T>(val)); break;
-	case LIWMem_Default:
-		liw_mset_def<T>(handle, std::forward<T>(val)); break;
-	case LIWMem_Static:
-		liw_mset_static<T>(handle, std::forward<T>(val)); break;
-	case LIWMem_Frame:
-		liw_mset_frame<T>(handle, std::forward<T>(val)); break;
-	case LIWMem_DFrame:
-		liw_mset_dframe<T>(handle, std::forward<T>(val)); break;
+	if constexpr (MemAlloc == LIWMem_System) {
+		liw_mset_sys<T>(handle, std::forward<T>(val));
+	}
+	else if constexpr (MemAlloc == LIWMem_Default) {
+		liw_mset_def<T>(handle, std::forward<T>(val));
+	}
+	else if constexpr (MemAlloc == LIWMem_Static) {
+		liw_mset_static<T>(handle, std::forward<T>(val));
+	}
+	else if constexpr (MemAlloc == LIWMem_Frame) {
+		liw_mset_frame<T>(handle, std::forward<T>(val));
+	}
+	else if constexpr (MemAlloc == LIWMem_DFrame) {
+		liw_mset_dframe<T>(handle, std::forward<T>(val));
+	}
+	else if constexpr (MemAlloc == LIWMem_Pool) {
+		liw_mset_pool<T>(handle, std::forward<T>(val));
+	}
+	else if constexpr (MemAlloc == LIWMem_Slab) {
+		liw_mset_slab<T>(handle, std::forward<T>(val));
 	}
 }
 template<LIWMemAllocation MemAlloc, class T>
 inline void liw_mset(liw_hdl_type handle, const T& val) {
 	static_assert(MemAlloc < LIWMem_Max, "Must use a valid LIWMemAllocation enum. ");
-	switch (MemAlloc)
-	{
-	case LIWMem_System:
-		liw_mset_sys<T>(handle, std::forward<T>(val)); break;
-	case LIWMem_Default:
-		liw_mset_def<T>(handle, std::forward<T>(val)); break;
-	case LIWMem_Static:
-		liw_mset_static<T>(handle, std::forward<T>(val)); break;
-	case LIWMem_Frame:
-		liw_mset_frame<T>(handle, std::forward<T>(val)); break;
-	case LIWMem_DFrame:
-		liw_mset_dframe<T>(handle, std::forward<T>(val)); break;
+	if constexpr (MemAlloc == LIWMem_System) {
+		liw_mset_sys<T>(handle, std::forward<T>(val));
+	}
+	else if constexpr (MemAlloc == LIWMem_Default) {
+		liw_mset_def<T>(handle, std::forward<T>(val));
+	}
+	else if constexpr (MemAlloc == LIWMem_Static) {
+		liw_mset_static<T>(handle, std::forward<T>(val));
+	}
+	else if constexpr (MemAlloc == LIWMem_Frame) {
+		liw_mset_frame<T>(handle, std::forward<T>(val));
+	}
+	else if constexpr (MemAlloc == LIWMem_DFrame) {
+		liw_mset_dframe<T>(handle, std::forward<T>(val));
+	}
+	else if constexpr (MemAlloc == LIWMem_Pool) {
+		liw_mset_pool<T>(handle, std::forward<T>(val));
+	}
+	else if constexpr (MemAlloc == LIWMem_Slab) {
+		liw_mset_slab<T>(handle, std::forward<T>(val));
 	}
 }
 
 template<LIWMemAllocation MemAlloc, class T>
 inline T liw_mget(liw_hdl_type handle) {
 	static_assert(MemAlloc < LIWMem_Max, "Must use a valid LIWMemAllocation enum. ");
-	switch (MemAlloc)
-	{
-	case LIWMem_System:
-		return std::move(liw_mget_sys<T>(handle)); 
-	case LIWMem_Default:
+	if constexpr (MemAlloc == LIWMem_System) {
+		return std::move(liw_mget_sys<T>(handle));
+	}
+	else if constexpr (MemAlloc == LIWMem_Default) {
 		return std::move(liw_mget_def<T>(handle));
-	case LIWMem_Static:
+	}
+	else if constexpr (MemAlloc == LIWMem_Static) {
 		return std::move(liw_mget_static<T>(handle));
-	case LIWMem_Frame:
+	}
+	else if constexpr (MemAlloc == LIWMem_Frame) {
 		return std::move(liw_mget_frame<T>(handle));
-	case LIWMem_DFrame:
+	}
+	else if constexpr (MemAlloc == LIWMem_DFrame) {
 		return std::move(liw_mget_dframe<T>(handle));
 	}
+	else if constexpr (MemAlloc == LIWMem_Pool) {
+		return std::move(liw_mget_pool<T>(handle));
+	}
+	else if constexpr (MemAlloc == LIWMem_Slab) {
+		return std::move(liw_mget_slab<T>(handle));
+	}
 }
 
 
 template<LIWMemAllocation MemAlloc, class T, class ... Args>
 inline liw_hdl_type liw_new(Args&&... args) {
 	static_assert(MemAlloc < LIWMem_Max, "Must use a valid LIWMemAllocation enum. ");
-	switch (MemAlloc)
-	{
-	case LIWMem_System:
+	if constexpr (MemAlloc == LIWMem_System) {
 		return liw_new_sys<T>(std::forward<Args>(args)...);
-	case LIWMem_Default:
+	}
+	else if constexpr (MemAlloc == LIWMem_Default) {
 		return liw_new_def<T>(std::forward<Args>(args)...);
-	case LIWMem_Static:
+	}
+	else if constexpr (MemAlloc == LIWMem_Static) {
 		return liw_new_static<T>(std::forward<Args>(args)...);
-	case LIWMem_Frame:
+	}
+	else if constexpr (MemAlloc == LIWMem_Frame) {
 		return liw_new_frame<T>(std::forward<Args>(args)...);
-	case LIWMem_DFrame:
+	}
+	else if constexpr (MemAlloc == LIWMem_DFrame) {
 		return liw_new_dframe<T>(std::forward<Args>(args)...);
 	}
+	else if constexpr (MemAlloc == LIWMem_Pool) {
+		return liw_new_pool<T>(std::forward<Args>(args)...);
+	}
+	else if constexpr (MemAlloc == LIWMem_Slab) {
+		return liw_new_slab<T>(std::forward<Args>(args)...);
+	}
 }
 
 template<LIWMemAllocation MemAlloc, class T>
 inline void liw_delete(liw_hdl_type handle) {
 	static_assert(MemAlloc < LIWMem_Max, "Must use a valid LIWMemAllocation enum. ");
-	switch (MemAlloc)
-	{
-	case LIWMem_System:
-		liw_delete_sys<T>(handle); break;
-	case LIWMem_Default:
-		liw_delete_def<T>(handle); break;
-	case LIWMem_Static:
-		liw_delete_static<T>(handle); break;
-	case LIWMem_Frame:
-		liw_delete_frame<T>(handle); break;
-	case LIWMem_DFrame:
-		liw_delete_dframe<T>(handle); break;
+	if constexpr (MemAlloc == LIWMem_System) {
+		liw_delete_sys<T>(handle);
+	}
+	else if constexpr (MemAlloc == LIWMem_Default) {
+		liw_delete_def<T>(handle);
+	}
+	else if constexpr (MemAlloc == LIWMem_Static) {
+		liw_delete_static<T>(handle);
+	}
+	else if constexpr (MemAlloc == LIWMem_Frame) {
+		liw_delete_frame<T>(handle);
+	}
+	else if constexpr (MemAlloc == LIWMem_DFrame) {
+		liw_delete_dframe<T>(handle);
+	}
+	else if constexpr (MemAlloc == LIWMem_Pool) {
+		liw_delete_pool<T>(handle);
+	}
+	else if constexpr (MemAlloc == LIWMem_Slab) {
+		liw_delete_slab<T>(handle);
 	}
 }
\ No newline at end of file
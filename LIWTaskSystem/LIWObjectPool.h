@@ -0,0 +1,102 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "LIWLGPoolAllocator.h"
+
+namespace LIW {
+	namespace Util {
+		/*
+		* LIWObjectPool is a typed pool of T over LIWLGPoolAllocator. 
+		* Element size and alignment are derived from T. Objects are constructed and destroyed in place. 
+		* Like the pool allocator, GlobalObjectPool is shared and each thread fetches from its own LocalObjectPool. 
+		* Objects may be returned on any thread. 
+		*/
+		template<class T, size_t CountElementPerBlock, size_t CountBlock>
+		class LIWObjectPool {
+			static_assert(alignof(T) <= alignof(max_align_t), "Over-aligned T is not supported by LIWObjectPool");
+
+		public:
+			typedef T value_type;
+			typedef uint32_t idx_type;
+		public:
+			static const size_t c_elementAlign	= alignof(T) > alignof(idx_type) ? alignof(T) : alignof(idx_type);
+			static const size_t c_elementSize	= ((sizeof(T) > sizeof(idx_type) ? sizeof(T) : sizeof(idx_type)) + c_elementAlign - 1) / c_elementAlign * c_elementAlign; // Stride keeps every element aligned
+		public:
+			typedef LIWLGPoolAllocator<c_elementSize, idx_type, CountElementPerBlock, CountBlock> allocator_type;
+			typedef typename allocator_type::GlobalPoolAllocator GlobalObjectPool;
+
+			class LocalObjectPool {
+			public:
+				/// <summary>
+				/// Initialize with a corresponding global pool. 
+				/// </summary>
+				/// <param name="globalPool"> global pool </param>
+				inline void Init(GlobalObjectPool& globalPool) {
+					m_allocator.Init(globalPool);
+				}
+
+				/// <summary>
+				/// Fetch an object and construct it in place. 
+				/// </summary>
+				/// <param name="...args"> constructor arguments </param>
+				/// <returns> pointer to the object </returns>
+				template<class ... Args>
+				inline T* Fetch(Args&&... args) {
+					return new(m_allocator.Fetch()) T(std::forward<Args>(args)...);
+				}
+
+				/// <summary>
+				/// Destroy an object and return it to the pool. 
+				/// </summary>
+				/// <param name="ptr"> pointer to the object (may be fetched on another thread) </param>
+				inline void Return(T* ptr) {
+					ptr->~T();
+					m_allocator.Return(ptr);
+				}
+
+				/// <summary>
+				/// Fetch objects, each constructed in place with the same arguments. 
+				/// </summary>
+				/// <param name="ptrs"> array to receive count pointers to the objects </param>
+				/// <param name="count"> count of objects </param>
+				/// <param name="...args"> constructor arguments (copied to each object) </param>
+				template<class ... Args>
+				inline void FetchN(T** ptrs, size_t count, const Args&... args) {
+					m_allocator.FetchN((void**)ptrs, count);
+					for (size_t idx = 0; idx < count; ++idx) {
+						new(ptrs[idx]) T(args...);
+					}
+				}
+
+				/// <summary>
+				/// Destroy objects and return them to the pool. 
+				/// </summary>
+				/// <param name="ptrs"> pointers to the objects (may be fetched on other threads) </param>
+				/// <param name="count"> count of objects </param>
+				inline void ReturnN(T* const* ptrs, size_t count) {
+					for (size_t idx = 0; idx < count; ++idx) {
+						ptrs[idx]->~T();
+					}
+					m_allocator.ReturnN((void* const*)ptrs, count);
+				}
+
+				/// <summary>
+				/// Cleanup pool. All objects fetched from this pool must have been returned. 
+				/// </summary>
+				inline void Cleanup() {
+					m_allocator.Cleanup();
+				}
+
+				/// <summary>
+				/// Check if initialized (and not cleaned up). 
+				/// </summary>
+				inline bool IsInit() const { return m_allocator.IsInit(); }
+
+			private:
+				typename allocator_type::LocalPoolAllocator m_allocator;
+			};
+		};
+	}
+}
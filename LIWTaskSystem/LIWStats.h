@@ -0,0 +1,480 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <ostream>
+#include <iomanip>
+#include <cstdint>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "LIWTaskTag.h"
+
+/*
+* Optional instrumentation of queues and pools.
+* Define LIW_ENABLE_STATS to enable. When disabled, counters are compiled out and snapshots are all zero.
+*/
+#ifdef LIW_ENABLE_STATS
+#define LIW_STATS(...) __VA_ARGS__
+#else
+#define LIW_STATS(...)
+#endif
+
+namespace LIW {
+	namespace Util {
+		/// <summary>
+		/// Snapshot of queue stats.
+		/// </summary>
+		struct LIWQueueStats {
+			uint64_t m_countEnqueue{ 0 };		// Count of values enqueued
+			uint64_t m_countDequeue{ 0 };		// Count of values dequeued
+			uint64_t m_countContention{ 0 };	// Count of lock acquisitions which found the lock taken
+			uint64_t m_nsWaited{ 0 };			// Time spent blocked in push/pop waiting for space/values (ns)
+			uint64_t m_highWaterMark{ 0 };		// Max size reached
+		};
+
+		/// <summary>
+		/// Snapshot of a pool worker (thread) stats.
+		/// </summary>
+		struct LIWWorkerStats {
+			uint64_t m_countTasks{ 0 };			// Count of tasks executed
+			uint64_t m_countFiberSwitches{ 0 };	// Count of switches into fibers
+			uint64_t m_countSteals{ 0 };		// Count of tasks/fibers stolen from other workers
+			uint64_t m_nsBusy{ 0 };				// Time spent executing tasks/fibers (ns)
+			uint64_t m_nsIdle{ 0 };				// Time spent looking for work (ns)
+
+			inline double GetBusyRatio() const {
+				const uint64_t total = m_nsBusy + m_nsIdle;
+				return total == 0 ? 0.0 : (double)m_nsBusy / (double)total;
+			}
+		};
+
+		/// <summary>
+		/// Snapshot of pool stats.
+		/// </summary>
+		struct LIWPoolStats {
+			std::vector<LIWWorkerStats> m_workers;	// Stats per worker (thread)
+			LIWQueueStats m_tasks;					// Stats of task queue
+			LIWQueueStats m_fibersAwake;			// Stats of awake fiber queue (fiber pools only)
+
+			inline uint64_t GetTaskCount() const {
+				uint64_t count = 0;
+				for (auto& worker : m_workers) count += worker.m_countTasks;
+				return count;
+			}
+			inline double GetBusyRatio() const {
+				uint64_t busy = 0, total = 0;
+				for (auto& worker : m_workers) { busy += worker.m_nsBusy; total += worker.m_nsBusy + worker.m_nsIdle; }
+				return total == 0 ? 0.0 : (double)busy / (double)total;
+			}
+		};
+
+		/// <summary>
+		/// Latency histogram (HDR-style, log-linear buckets). 
+		/// Values below 32ns are exact. Above, each power of 2 is split into 32 buckets, so a value is reported within ~3%. 
+		/// Not thread-safe. Used for snapshots merged from per-thread recorders. 
+		/// </summary>
+		class LIWLatencyHistogram {
+		public:
+			static const uint32_t c_subBucketBits = 5;
+			static const uint64_t c_subBucketCount = 1ull << c_subBucketBits;
+			static const uint64_t c_bucketCount = c_subBucketCount + (64 - c_subBucketBits) * c_subBucketCount;
+
+		public:
+			LIWLatencyHistogram() : m_buckets(c_bucketCount, 0) {}
+
+			/// <summary>
+			/// Get the bucket a value falls in. 
+			/// </summary>
+			static inline uint64_t GetBucketIndex(uint64_t val) {
+				if (val < c_subBucketCount)
+					return val;
+				const uint32_t msb = GetMSB(val);
+				const uint32_t shift = msb - c_subBucketBits;
+				return c_subBucketCount + shift * c_subBucketCount + ((val >> shift) - c_subBucketCount);
+			}
+			/// <summary>
+			/// Get the highest value which falls in a bucket. 
+			/// </summary>
+			static inline uint64_t GetBucketMax(uint64_t idx) {
+				if (idx < c_subBucketCount)
+					return idx;
+				const uint64_t shift = (idx - c_subBucketCount) / c_subBucketCount;
+				const uint64_t sub = (idx - c_subBucketCount) % c_subBucketCount;
+				return ((c_subBucketCount + sub + 1) << shift) - 1;
+			}
+
+			inline void Record(uint64_t val, uint64_t count = 1) {
+				m_buckets[GetBucketIndex(val)] += count;
+				OnRecorded(val, count);
+			}
+			/// <summary>
+			/// Add the values of another histogram into this one. 
+			/// </summary>
+			void Merge(const LIWLatencyHistogram& other) {
+				for (uint64_t i = 0; i < c_bucketCount; ++i) {
+					m_buckets[i] += other.m_buckets[i];
+				}
+				if (other.m_count > 0) {
+					m_min = m_count == 0 || other.m_min < m_min ? other.m_min : m_min;
+					m_max = other.m_max > m_max ? other.m_max : m_max;
+					m_count += other.m_count;
+					m_sum += other.m_sum;
+				}
+			}
+
+			inline uint64_t GetCount() const { return m_count; }
+			inline uint64_t GetMin() const { return m_min; }
+			inline uint64_t GetMax() const { return m_max; }
+			inline double GetMean() const { return m_count == 0 ? 0.0 : (double)m_sum / (double)m_count; }
+			/// <summary>
+			/// Get the value at a percentile. 
+			/// </summary>
+			/// <param name="percentile"> percentile in [0, 100] </param>
+			/// <returns> highest value of the bucket the percentile falls in (capped by max), 0 when empty </returns>
+			uint64_t GetPercentile(double percentile) const {
+				if (m_count == 0)
+					return 0;
+				uint64_t rank = (uint64_t)(percentile / 100.0 * (double)m_count + 0.5);
+				rank = rank < 1 ? 1 : (rank > m_count ? m_count : rank);
+				uint64_t countSeen = 0;
+				for (uint64_t i = 0; i < c_bucketCount; ++i) {
+					countSeen += m_buckets[i];
+					if (countSeen >= rank) {
+						const uint64_t valMax = GetBucketMax(i);
+						return valMax < m_max ? valMax : m_max;
+					}
+				}
+				return m_max;
+			}
+			inline uint64_t GetP50() const { return GetPercentile(50.0); }
+			inline uint64_t GetP99() const { return GetPercentile(99.0); }
+			inline uint64_t GetP999() const { return GetPercentile(99.9); }
+
+		private:
+			friend class LIWLatencyRecorder;
+			inline void OnRecorded(uint64_t val, uint64_t count) {
+				m_min = m_count == 0 || val < m_min ? val : m_min;
+				m_max = val > m_max ? val : m_max;
+				m_count += count;
+				m_sum += val * count;
+			}
+			static inline uint32_t GetMSB(uint64_t val) {
+#ifdef _MSC_VER
+				unsigned long idx;
+				_BitScanReverse64(&idx, val);
+				return (uint32_t)idx;
+#else
+				return 63u - (uint32_t)__builtin_clzll(val);
+#endif
+			}
+		private:
+			std::vector<uint64_t> m_buckets;
+			uint64_t m_count{ 0 };
+			uint64_t m_sum{ 0 };
+			uint64_t m_min{ 0 };
+			uint64_t m_max{ 0 };
+		};
+
+		/// <summary>
+		/// Snapshot of pool task latencies, merged from all workers. 
+		/// </summary>
+		struct LIWLatencyStats {
+			LIWLatencyHistogram m_submitToStart;	// From Submit to a worker starting the task (ns)
+			LIWLatencyHistogram m_startToFinish;	// From start to finish of the task (ns). For fibers, includes time parked. 
+		};
+
+		/// <summary>
+		/// Snapshot of the tasks of a tag. 
+		/// </summary>
+		struct LIWTagStats {
+			uint32_t m_idTag{ 0 };				// ID of the tag
+			const char* m_name{ nullptr };		// Name of the tag
+			uint64_t m_countTasks{ 0 };			// Count of tasks finished
+			uint64_t m_nsWall{ 0 };				// Time from start to finish of tasks (ns)
+			uint64_t m_nsRunning{ 0 };			// Time tasks were running on a worker (ns)
+			uint64_t m_cpu{ 0 };				// CPU time of worker threads running tasks (ns; cycles on Win32). Unlike m_nsRunning, excludes time the thread was descheduled. 
+
+			/// <summary>
+			/// Time tasks spent suspended (fibers parked or waiting to be resumed). Always 0 for thread pool tasks. 
+			/// </summary>
+			inline uint64_t GetNsSuspended() const { return m_nsWall > m_nsRunning ? m_nsWall - m_nsRunning : 0; }
+		};
+
+		/// <summary>
+		/// Snapshot of the stack of a fiber. 
+		/// </summary>
+		struct LIWFiberStackStats {
+			int m_idFiber{ -1 };				// ID of the fiber
+			uint32_t m_stackClass{ 0 };			// Stack class of the fiber (LIWFiberStackClass)
+			size_t m_size{ 0 };					// Stack size (bytes)
+			size_t m_peak{ 0 };					// Peak stack usage (bytes). 0 unless LIW_ENABLE_STATS is defined. 
+		};
+
+		/// <summary>
+		/// Add to a counter with a single writer, so no read-modify-write is required. 
+		/// </summary>
+		inline void liw_stats_increase(std::atomic<uint64_t>& counter, uint64_t val) {
+			counter.store(counter.load(std::memory_order_relaxed) + val, std::memory_order_relaxed);
+		}
+
+		/// <summary>
+		/// Live latency histogram. Written only by its own thread, read (merged) by any thread. 
+		/// </summary>
+		class LIWLatencyRecorder {
+		public:
+			LIWLatencyRecorder() : m_buckets(new std::atomic<uint64_t>[LIWLatencyHistogram::c_bucketCount]) {
+				for (uint64_t i = 0; i < LIWLatencyHistogram::c_bucketCount; ++i) {
+					m_buckets[i].store(0, std::memory_order_relaxed);
+				}
+			}
+			~LIWLatencyRecorder() { delete[] m_buckets; }
+			LIWLatencyRecorder(const LIWLatencyRecorder&) = delete;
+			LIWLatencyRecorder& operator=(const LIWLatencyRecorder&) = delete;
+
+			inline void Record(uint64_t val) {
+				liw_stats_increase(m_buckets[LIWLatencyHistogram::GetBucketIndex(val)], 1);
+				liw_stats_increase(m_sum, val);
+				if (val < m_min.load(std::memory_order_relaxed)) m_min.store(val, std::memory_order_relaxed);
+				if (val > m_max.load(std::memory_order_relaxed)) m_max.store(val, std::memory_order_relaxed);
+			}
+			/// <summary>
+			/// Merge recorded values into a histogram. Values being recorded concurrently may be missed. 
+			/// </summary>
+			void MergeInto(LIWLatencyHistogram& histogram) const {
+				uint64_t count = 0;
+				for (uint64_t i = 0; i < LIWLatencyHistogram::c_bucketCount; ++i) {
+					const uint64_t countBucket = m_buckets[i].load(std::memory_order_relaxed);
+					histogram.m_buckets[i] += countBucket;
+					count += countBucket;
+				}
+				if (count > 0) {
+					const uint64_t valMin = m_min.load(std::memory_order_relaxed);
+					const uint64_t valMax = m_max.load(std::memory_order_relaxed);
+					histogram.m_min = histogram.m_count == 0 || valMin < histogram.m_min ? valMin : histogram.m_min;
+					histogram.m_max = valMax > histogram.m_max ? valMax : histogram.m_max;
+					histogram.m_count += count;
+					histogram.m_sum += m_sum.load(std::memory_order_relaxed);
+				}
+			}
+		private:
+			std::atomic<uint64_t>* m_buckets;
+			std::atomic<uint64_t> m_sum{ 0 };
+			std::atomic<uint64_t> m_min{ UINT64_MAX };
+			std::atomic<uint64_t> m_max{ 0 };
+		};
+
+		/// <summary>
+		/// Get a timestamp for stats (ns).
+		/// </summary>
+		inline uint64_t liw_stats_now_ns() {
+			return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		/// <summary>
+		/// Live counters of a queue. Updated by any thread.
+		/// </summary>
+		class LIWQueueCounters {
+		public:
+			inline void OnEnqueue(uint64_t sizeAfter, uint64_t count = 1) {
+				m_countEnqueue.fetch_add(count, std::memory_order_relaxed);
+				uint64_t highWaterMark = m_highWaterMark.load(std::memory_order_relaxed);
+				while (sizeAfter > highWaterMark && !m_highWaterMark.compare_exchange_weak(highWaterMark, sizeAfter, std::memory_order_relaxed)) {}
+			}
+			inline void OnDequeue(uint64_t count = 1) { m_countDequeue.fetch_add(count, std::memory_order_relaxed); }
+			inline void OnContention() { m_countContention.fetch_add(1, std::memory_order_relaxed); }
+			inline void OnWaited(uint64_t ns) { m_nsWaited.fetch_add(ns, std::memory_order_relaxed); }
+
+			/// <summary>
+			/// Lock a mutex, counting contention when it is already taken.
+			/// </summary>
+			template<class Mutex>
+			inline void Lock(Mutex& mtx) {
+				if (!mtx.try_lock()) {
+					OnContention();
+					mtx.lock();
+				}
+			}
+
+			LIWQueueStats Snapshot() const {
+				LIWQueueStats stats;
+				stats.m_countEnqueue = m_countEnqueue.load(std::memory_order_relaxed);
+				stats.m_countDequeue = m_countDequeue.load(std::memory_order_relaxed);
+				stats.m_countContention = m_countContention.load(std::memory_order_relaxed);
+				stats.m_nsWaited = m_nsWaited.load(std::memory_order_relaxed);
+				stats.m_highWaterMark = m_highWaterMark.load(std::memory_order_relaxed);
+				return stats;
+			}
+		private:
+			std::atomic<uint64_t> m_countEnqueue{ 0 };
+			std::atomic<uint64_t> m_countDequeue{ 0 };
+			std::atomic<uint64_t> m_countContention{ 0 };
+			std::atomic<uint64_t> m_nsWaited{ 0 };
+			std::atomic<uint64_t> m_highWaterMark{ 0 };
+		};
+
+		/// <summary>
+		/// Get the CPU time of this thread, to take deltas of on the same thread (ns; cycles on Win32).
+		/// </summary>
+		inline uint64_t liw_stats_now_cpu() {
+#ifdef _WIN32
+			ULONG64 cycles = 0;
+			QueryThreadCycleTime(GetCurrentThread(), &cycles);
+			return (uint64_t)cycles;
+#else
+			timespec ts;
+			clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+			return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+		}
+
+		/// <summary>
+		/// Accounting of the task a fiber is running. 
+		/// Reset by the pool when the task starts, accumulated by the fiber itself each time it is switched in and out. 
+		/// </summary>
+		struct LIWTaskAccount {
+			uint32_t m_idTag{ 0 };				// ID of the tag of the task
+			uint64_t m_nsStart{ 0 };			// Time the task started
+			uint64_t m_nsRunning{ 0 };			// Time running so far
+			uint64_t m_cpu{ 0 };				// CPU time running so far (of the threads which resumed the fiber)
+			uint64_t m_nsSwitchedIn{ 0 };		// Time the fiber was last switched in
+			uint64_t m_cpuSwitchedIn{ 0 };		// CPU time of the thread when the fiber was last switched in
+
+			inline void Reset(uint32_t idTag, uint64_t nsStart) {
+				m_idTag = idTag;
+				m_nsStart = nsStart;
+				m_nsRunning = 0;
+				m_cpu = 0;
+			}
+			inline void OnSwitchedIn() {
+				m_nsSwitchedIn = liw_stats_now_ns();
+				m_cpuSwitchedIn = liw_stats_now_cpu();
+			}
+			inline void OnSwitchedOut() {
+				m_cpu += liw_stats_now_cpu() - m_cpuSwitchedIn; // Same thread as switched in, so the delta is valid
+				m_nsRunning += liw_stats_now_ns() - m_nsSwitchedIn;
+			}
+		};
+
+		/// <summary>
+		/// Remove tags with no task, and sort by running time (descending). 
+		/// </summary>
+		inline void liw_sort_tag_stats(std::vector<LIWTagStats>& stats) {
+			stats.erase(std::remove_if(stats.begin(), stats.end(), [](const LIWTagStats& tag) { return tag.m_countTasks == 0; }), stats.end());
+			std::sort(stats.begin(), stats.end(), [](const LIWTagStats& a, const LIWTagStats& b) { return a.m_nsRunning > b.m_nsRunning; });
+		}
+
+		/// <summary>
+		/// Write tag stats as a table, sorted by running time (descending). Tags with no task are skipped. 
+		/// </summary>
+		inline void liw_write_tag_report(std::ostream& os, std::vector<LIWTagStats> stats) {
+			liw_sort_tag_stats(stats);
+			const std::ios_base::fmtflags flags = os.flags();
+			const std::streamsize precision = os.precision();
+			os << std::left << std::setw(24) << "tag" << std::right
+				<< std::setw(12) << "tasks"
+				<< std::setw(14) << "wall(ms)"
+				<< std::setw(14) << "running(ms)"
+				<< std::setw(14) << "suspend(ms)"
+				<< std::setw(16) << "cpu/task"
+				<< std::setw(14) << "us/task" << "\n";
+			os << std::fixed << std::setprecision(3);
+			for (auto& tag : stats) {
+				os << std::left << std::setw(24) << tag.m_name << std::right
+					<< std::setw(12) << tag.m_countTasks
+					<< std::setw(14) << (double)tag.m_nsWall / 1e6
+					<< std::setw(14) << (double)tag.m_nsRunning / 1e6
+					<< std::setw(14) << (double)tag.GetNsSuspended() / 1e6
+					<< std::setw(16) << tag.m_cpu / tag.m_countTasks
+					<< std::setw(14) << (double)tag.m_nsRunning / 1e3 / (double)tag.m_countTasks << "\n";
+			}
+			os.flags(flags);
+			os.precision(precision);
+		}
+
+		/// <summary>
+		/// Live counters of a pool worker. Written only by its own thread, read by any thread.
+		/// </summary>
+		class LIWWorkerCounters {
+		public:
+			inline void OnTask() { liw_stats_increase(m_countTasks, 1); }
+			inline void OnFiberSwitch() { liw_stats_increase(m_countFiberSwitches, 1); }
+			inline void OnSteal(uint64_t count = 1) { liw_stats_increase(m_countSteals, count); }
+			inline void OnBusy(uint64_t ns) { liw_stats_increase(m_nsBusy, ns); }
+			inline void OnIdle(uint64_t ns) { liw_stats_increase(m_nsIdle, ns); }
+			inline void OnTaskStarted(uint64_t nsSinceSubmit) { m_latencySubmitToStart.Record(nsSinceSubmit); }
+			inline void OnTaskFinished(uint64_t nsSinceStart) { m_latencyStartToFinish.Record(nsSinceStart); }
+			/// <summary>
+			/// Record a finished fiber task: start to finish latency, and its tag accounting. 
+			/// </summary>
+			inline void OnTaskFinished(const LIWTaskAccount& account, uint64_t nsEnd) {
+				OnTaskFinished(nsEnd - account.m_nsStart);
+				OnTaskAccounted(account.m_idTag, nsEnd - account.m_nsStart, account.m_nsRunning, account.m_cpu);
+			}
+			inline void OnTaskAccounted(uint32_t idTag, uint64_t nsWall, uint64_t nsRunning, uint64_t cpu) {
+				TagCounters& tag = m_tags[idTag];
+				liw_stats_increase(tag.m_countTasks, 1);
+				liw_stats_increase(tag.m_nsWall, nsWall);
+				liw_stats_increase(tag.m_nsRunning, nsRunning);
+				liw_stats_increase(tag.m_cpu, cpu);
+			}
+
+			LIWWorkerStats Snapshot() const {
+				LIWWorkerStats stats;
+				stats.m_countTasks = m_countTasks.load(std::memory_order_relaxed);
+				stats.m_countFiberSwitches = m_countFiberSwitches.load(std::memory_order_relaxed);
+				stats.m_countSteals = m_countSteals.load(std::memory_order_relaxed);
+				stats.m_nsBusy = m_nsBusy.load(std::memory_order_relaxed);
+				stats.m_nsIdle = m_nsIdle.load(std::memory_order_relaxed);
+				return stats;
+			}
+			/// <summary>
+			/// Add tag counters into stats (indexed by tag ID, at least LIWTaskTag::GetCount() long). 
+			/// </summary>
+			void MergeTagsInto(std::vector<LIWTagStats>& stats) const {
+				for (size_t i = 0; i < stats.size(); ++i) {
+					const TagCounters& tag = m_tags[i];
+					stats[i].m_countTasks += tag.m_countTasks.load(std::memory_order_relaxed);
+					stats[i].m_nsWall += tag.m_nsWall.load(std::memory_order_relaxed);
+					stats[i].m_nsRunning += tag.m_nsRunning.load(std::memory_order_relaxed);
+					stats[i].m_cpu += tag.m_cpu.load(std::memory_order_relaxed);
+				}
+			}
+			void MergeLatencyInto(LIWLatencyStats& stats) const {
+				m_latencySubmitToStart.MergeInto(stats.m_submitToStart);
+				m_latencyStartToFinish.MergeInto(stats.m_startToFinish);
+			}
+		private:
+			std::atomic<uint64_t> m_countTasks{ 0 };
+			std::atomic<uint64_t> m_countFiberSwitches{ 0 };
+			std::atomic<uint64_t> m_countSteals{ 0 };
+			std::atomic<uint64_t> m_nsBusy{ 0 };
+			std::atomic<uint64_t> m_nsIdle{ 0 };
+			LIWLatencyRecorder m_latencySubmitToStart;
+			LIWLatencyRecorder m_latencyStartToFinish;
+			struct TagCounters {
+				std::atomic<uint64_t> m_countTasks{ 0 };
+				std::atomic<uint64_t> m_nsWall{ 0 };
+				std::atomic<uint64_t> m_nsRunning{ 0 };
+				std::atomic<uint64_t> m_cpu{ 0 };
+			};
+			TagCounters m_tags[LIWTaskTag::c_maxTags];
+		};
+
+		/// <summary>
+		/// Make empty tag stats, indexed by tag ID, to merge worker counters into. 
+		/// </summary>
+		inline std::vector<LIWTagStats> liw_make_tag_stats() {
+			std::vector<LIWTagStats> stats(LIWTaskTag::GetCount());
+			for (uint32_t i = 0; i < (uint32_t)stats.size(); ++i) {
+				stats[i].m_idTag = i;
+				stats[i].m_name = LIWTaskTag::GetName(i);
+			}
+			return stats;
+		}
+	}
+}
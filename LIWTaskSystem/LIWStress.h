@@ -0,0 +1,182 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+
+/*
+* Deterministic stress harness.
+* Every iteration of a stress test gets its own seed, from which all random choices
+* (thread counts, capacities, op mixes, injected yields) are derived, so a failure can be replayed with --seed.
+* NOTE: Thread interleavings are still up to the OS. A seed reproduces the configuration, not the schedule.
+*/
+
+// Record a failure (with location) and return false from the stress test when cond is not satisfied.
+#define LIW_STRESS_CHECK(ctx, cond) \
+	do { if (!(cond)) { (ctx).Fail(__FILE__, __LINE__, #cond); return false; } } while (0)
+// Record a failure (with location) without returning. For use in worker threads/tasks.
+#define LIW_STRESS_EXPECT(ctx, cond) \
+	do { if (!(cond)) { (ctx).Fail(__FILE__, __LINE__, #cond); } } while (0)
+
+namespace LIW {
+	namespace Util {
+		/// <summary>
+		/// Small deterministic PRNG (xorshift64*).
+		/// </summary>
+		class LIWStressRandom {
+		public:
+			explicit LIWStressRandom(uint64_t seed) : m_state(seed * 0x9E3779B97F4A7C15ull + 0x2545F4914F6CDD1Dull) {
+				if (m_state == 0) m_state = 1;
+			}
+			inline uint64_t Next() {
+				m_state ^= m_state >> 12;
+				m_state ^= m_state << 25;
+				m_state ^= m_state >> 27;
+				return m_state * 0x2545F4914F6CDD1Dull;
+			}
+			/// <summary>
+			/// Get a random number in [lo, hi].
+			/// </summary>
+			inline uint64_t Range(uint64_t lo, uint64_t hi) { return lo + Next() % (hi - lo + 1); }
+			/// <summary>
+			/// Get true with a chance of 1/den.
+			/// </summary>
+			inline bool OneIn(uint64_t den) { return Next() % den == 0; }
+			/// <summary>
+			/// Derive an independent generator (e.g. for a thread).
+			/// </summary>
+			inline LIWStressRandom Fork() { return LIWStressRandom(Next()); }
+		private:
+			uint64_t m_state;
+		};
+
+		/// <summary>
+		/// Injected yield. Randomly yields or briefly sleeps to shake up interleavings.
+		/// </summary>
+		inline void liw_stress_yield(LIWStressRandom& rng) {
+			const uint64_t roll = rng.Next() % 64;
+			if (roll < 6) {
+				std::this_thread::yield();
+			}
+			else if (roll == 6) {
+				std::this_thread::sleep_for(std::chrono::microseconds(rng.Range(1, 50)));
+			}
+		}
+
+		/// <summary>
+		/// Context of one stress test iteration.
+		/// </summary>
+		class LIWStressContext {
+		public:
+			explicit LIWStressContext(uint64_t seed) : m_seed(seed), m_rng(seed) {}
+
+			inline uint64_t GetSeed() const { return m_seed; }
+			inline LIWStressRandom& GetRandom() { return m_rng; }
+			inline bool IsFailed() const { return m_isFailed.load(std::memory_order_acquire); }
+			inline const std::string& GetMessage() const { return m_message; }
+			/// <summary>
+			/// Record a failure. Thread-safe. Only the first failure is kept.
+			/// </summary>
+			void Fail(const char* file, int line, const char* msg) {
+				std::lock_guard<std::mutex> lk(m_mtx);
+				if (!m_isFailed.load(std::memory_order_relaxed)) {
+					m_message = std::string(file) + ":" + std::to_string(line) + ": " + msg;
+					m_isFailed.store(true, std::memory_order_release);
+				}
+			}
+		private:
+			uint64_t m_seed;
+			LIWStressRandom m_rng;
+			std::atomic<bool> m_isFailed{ false };
+			std::mutex m_mtx;
+			std::string m_message;
+		};
+
+		/// <summary>
+		/// Stress test function. Runs one iteration.
+		/// </summary>
+		/// <returns> is iteration passed? (also failed when ctx.Fail was called) </returns>
+		typedef bool(*LIWStressFunction)(LIWStressContext& ctx);
+
+		class LIWStressSuite {
+		private:
+			struct Entry {
+				std::string m_name;
+				LIWStressFunction m_func;
+			};
+		public:
+			/// <summary>
+			/// Register a stress test.
+			/// </summary>
+			/// <param name="name"> name of the test (group/name) </param>
+			/// <param name="func"> test function </param>
+			inline void Add(const char* name, LIWStressFunction func) {
+				m_entries.push_back(Entry{ name, func });
+			}
+
+			/// <summary>
+			/// Entry point of a stress test executable.
+			/// Options:
+			///		--filter <substr>		run only tests whose names contain substr
+			///		--iterations <n>		iterations per test (default 20)
+			///		--seed <seed>			base seed (default 1). Iteration i of a test runs with seed+i.
+			///		--list					list tests
+			/// </summary>
+			/// <returns> 0 when all passed </returns>
+			int Main(int argc, char** argv) const {
+				const char* filter = nullptr;
+				uint64_t countIterations = 20;
+				uint64_t seedBase = 1;
+				for (int i = 1; i < argc; ++i) {
+					const bool hasVal = i + 1 < argc;
+					if (!strcmp(argv[i], "--filter") && hasVal) filter = argv[++i];
+					else if (!strcmp(argv[i], "--iterations") && hasVal) countIterations = strtoull(argv[++i], nullptr, 10);
+					else if (!strcmp(argv[i], "--seed") && hasVal) seedBase = strtoull(argv[++i], nullptr, 10);
+					else if (!strcmp(argv[i], "--list")) {
+						for (auto& entry : m_entries) std::cout << entry.m_name << "\n";
+						return 0;
+					}
+					else {
+						std::cerr << "Usage: " << argv[0] << " [--filter substr] [--iterations n] [--seed seed] [--list]\n";
+						return 1;
+					}
+				}
+
+				int countFailed = 0;
+				int countRun = 0;
+				for (auto& entry : m_entries) {
+					if (filter && *filter && entry.m_name.find(filter) == std::string::npos)
+						continue;
+					++countRun;
+					std::cout << entry.m_name << " ..." << std::flush;
+					bool isPassed = true;
+					for (uint64_t i = 0; i < countIterations && isPassed; ++i) {
+						LIWStressContext ctx(seedBase + i);
+						isPassed = entry.m_func(ctx) && !ctx.IsFailed();
+						if (!isPassed) {
+							std::cout << " FAILED (replay with --filter " << entry.m_name << " --seed " << ctx.GetSeed() << " --iterations 1)\n"
+									  << "\t" << ctx.GetMessage() << std::endl;
+						}
+					}
+					if (isPassed) {
+						std::cout << " ok" << std::endl;
+					}
+					else {
+						++countFailed;
+					}
+				}
+				std::cout << countRun - countFailed << "/" << countRun << " passed" << std::endl;
+				return countFailed == 0 && countRun > 0 ? 0 : 1;
+			}
+
+		private:
+			std::vector<Entry> m_entries;
+		};
+	}
+}
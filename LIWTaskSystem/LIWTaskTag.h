@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace LIW {
+	/// <summary>
+	/// Tag naming a type of task (e.g. a subsystem), for per-tag accounting in pool stats.
+	/// Tags get dense IDs on construction, so create them once, with static storage. E.g.
+	///		static LIWTaskTag s_tagPhysics("Physics");
+	///		task->SetTag(s_tagPhysics);
+	/// ID 0 is reserved for untagged tasks. Tags created beyond c_maxTags share ID 0 as well.
+	/// </summary>
+	class LIWTaskTag {
+	public:
+		static const uint32_t c_maxTags = 128;
+		static const uint32_t c_idUntagged = 0;
+
+	public:
+		/// <param name="name"> static string naming the tag </param>
+		explicit LIWTaskTag(const char* name) : m_name(name), m_id(Register(name)) {}
+		LIWTaskTag(const LIWTaskTag&) = delete;
+		LIWTaskTag& operator=(const LIWTaskTag&) = delete;
+
+		inline uint32_t GetID() const { return m_id; }
+		inline const char* GetName() const { return m_name; }
+
+		/// <summary>
+		/// Get ID of a tag (untagged when nullptr).
+		/// </summary>
+		static inline uint32_t GetID(const LIWTaskTag* tag) { return tag ? tag->m_id : c_idUntagged; }
+		/// <summary>
+		/// Get name of a tag by ID.
+		/// </summary>
+		static inline const char* GetName(uint32_t id) {
+			const char* name = id < c_maxTags ? Names()[id].load(std::memory_order_acquire) : nullptr;
+			return name ? name : "(untagged)";
+		}
+		/// <summary>
+		/// Get count of IDs in use (including untagged).
+		/// </summary>
+		static inline uint32_t GetCount() {
+			const uint32_t count = Counter().load(std::memory_order_acquire);
+			return count < c_maxTags ? count : c_maxTags;
+		}
+
+	private:
+		static inline uint32_t Register(const char* name) {
+			const uint32_t id = Counter().fetch_add(1, std::memory_order_acq_rel);
+			if (id >= c_maxTags)
+				return c_idUntagged;
+			Names()[id].store(name, std::memory_order_release);
+			return id;
+		}
+		static inline std::atomic<const char*>* Names() {
+			static std::atomic<const char*> s_names[c_maxTags]; // Zero initialized (static storage)
+			return s_names;
+		}
+		static inline std::atomic<uint32_t>& Counter() {
+			static std::atomic<uint32_t> s_count{ c_idUntagged + 1 };
+			return s_count;
+		}
+
+	private:
+		const char* m_name;
+		uint32_t m_id;
+	};
+}
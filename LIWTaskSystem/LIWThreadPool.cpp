@@ -21,14 +21,52 @@ void LIW::LIWThreadPool::Init(int minWorkers, int maxWorkers)
 {
 	//TODO: Make this adaptive somehow
 	__m_isRunning = true;
+	LIW_STATS(m_workerCounters.reset(new Util::LIWWorkerCounters[minWorkers]));
 	for (int i = 0; i < minWorkers; ++i) {
-		m_workers.emplace_back(std::thread(std::bind(&LIW::LIWThreadPool::ProcessTask, this)));
+		m_workers.emplace_back(std::thread(std::bind(&LIW::LIWThreadPool::ProcessTask, this, i)));
 	}
 	__m_isInit = true;
 }
 
+LIW::Util::LIWPoolStats LIW::LIWThreadPool::GetStats() const
+{
+	Util::LIWPoolStats stats;
+#ifdef LIW_ENABLE_STATS
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		stats.m_workers.emplace_back(m_workerCounters[i].Snapshot());
+	}
+#endif
+	stats.m_tasks = m_tasks.get_stats();
+	return stats;
+}
+
+LIW::Util::LIWLatencyStats LIW::LIWThreadPool::GetLatencyStats() const
+{
+	Util::LIWLatencyStats stats;
+#ifdef LIW_ENABLE_STATS
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		m_workerCounters[i].MergeLatencyInto(stats);
+	}
+#endif
+	return stats;
+}
+
+std::vector<LIW::Util::LIWTagStats> LIW::LIWThreadPool::GetTagStats() const
+{
+	std::vector<Util::LIWTagStats> stats;
+#ifdef LIW_ENABLE_STATS
+	stats = Util::liw_make_tag_stats();
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		m_workerCounters[i].MergeTagsInto(stats);
+	}
+	Util::liw_sort_tag_stats(stats);
+#endif
+	return stats;
+}
+
 bool LIW::LIWThreadPool::Submit(LIWITask* task)
 {
+	LIW_STATS(task->m_nsSubmit = Util::liw_stats_now_ns());
 	m_tasks.push_now(task);
 	return true;
 }
@@ -70,14 +108,26 @@ void LIW::LIWThreadPool::Stop()
 #include <string>
 #include <sstream>
 
-void LIW::LIWThreadPool::ProcessTask()
+void LIW::LIWThreadPool::ProcessTask(int idxWorker)
 {
+	LIW_STATS(Util::LIWWorkerCounters& counters = m_workerCounters[idxWorker]);
 	//TODO: Do task cleaning somewhere
-	while (!m_tasks.empty() || __m_isRunning) {
+	while (__m_isRunning || !m_tasks.empty()) { // Check running first: once it reads false, every task submitted before the stop is visible to the empty checks. 
 		LIWITask* task = nullptr;
+		LIW_STATS(const uint64_t tBeg = Util::liw_stats_now_ns());
 		if (m_tasks.pop(task)) {
+			LIW_STATS(const uint64_t tExec = Util::liw_stats_now_ns(); counters.OnTaskStarted(tExec - task->m_nsSubmit));
+			LIW_STATS(const uint32_t idTag = LIWTaskTag::GetID(task->GetTag()); const uint64_t cpuExec = Util::liw_stats_now_cpu());
+			LIW_TRACE(Util::LIWTracer::Begin("Task"));
 			task->Execute(nullptr);
+			LIW_TRACE(Util::LIWTracer::End("Task"));
+			LIW_STATS(const uint64_t cpu = Util::liw_stats_now_cpu() - cpuExec);
 			delete task;
+			LIW_STATS(const uint64_t tEnd = Util::liw_stats_now_ns(); counters.OnTask(); counters.OnTaskFinished(tEnd - tExec); counters.OnTaskAccounted(idTag, tEnd - tExec, tEnd - tExec, cpu));
+			LIW_STATS(counters.OnIdle(tExec - tBeg); counters.OnBusy(tEnd - tExec));
+		}
+		else {
+			LIW_STATS(counters.OnIdle(Util::liw_stats_now_ns() - tBeg));
 		}
 	}
 }
@@ -2,9 +2,13 @@
 #include <thread>
 #include <functional>
 #include <vector>
+#include <memory>
+#include <atomic>
 
 #include "LIWThreadSafeQueue.h"
 #include "LIWITask.h"
+#include "LIWStats.h"
+#include "LIWTracer.h"
 
 namespace LIW {
 	class LIWThreadPool
@@ -40,6 +44,22 @@ namespace LIW {
 		/// </summary>
 		/// <returns> count of tasks to process </returns>
 		inline uint64_t GetTasksCount() const { return m_tasks.size(); }
+		/// <summary>
+		/// Get a snapshot of pool stats. (All zero unless LIW_ENABLE_STATS is defined)
+		/// </summary>
+		/// <returns> pool stats </returns>
+		Util::LIWPoolStats GetStats() const;
+		/// <summary>
+		/// Get a snapshot of task latencies (submit to start, start to finish), merged from all workers. (Empty unless LIW_ENABLE_STATS is defined)
+		/// </summary>
+		/// <returns> latency stats </returns>
+		Util::LIWLatencyStats GetLatencyStats() const;
+		/// <summary>
+		/// Get a snapshot of per-tag accounting (count, wall time, running time, CPU time), merged from all workers and sorted by running time (descending). 
+		/// (Empty unless LIW_ENABLE_STATS is defined) Write it with Util::liw_write_tag_report. 
+		/// </summary>
+		/// <returns> stats of tags with at least one finished task </returns>
+		std::vector<Util::LIWTagStats> GetTagStats() const;
 
 		/// <summary>
 		/// Submit task for the thread pool to execute. 
@@ -60,16 +80,18 @@ namespace LIW {
 	private:
 		std::vector<std::thread> m_workers;
 		Util::LIWThreadSafeQueue<LIWITask*> m_tasks;
+		LIW_STATS(std::unique_ptr<Util::LIWWorkerCounters[]> m_workerCounters;)
 
 
 	private:
 		/// <summary>
 		/// Loop function to process task. 
 		/// </summary>
-		void ProcessTask();
+		/// <param name="idxWorker"> index of the worker running the loop </param>
+		void ProcessTask(int idxWorker);
 
 	private:
-		bool __m_isRunning;
+		std::atomic<bool> __m_isRunning;
 		bool __m_isInit;
 	};
 }
@@ -2,9 +2,13 @@
 #include <thread>
 #include <functional>
 #include <vector>
+#include <memory>
+#include <atomic>
 
 #include "LIWThreadSafeQueueSized.h"
 #include "LIWITask.h"
+#include "LIWStats.h"
+#include "LIWTracer.h"
 
 namespace LIW {
 	template<uint64_t TasksSize>
@@ -28,8 +32,9 @@ namespace LIW {
 		/// <param name="maxWorkers"> number of maximum workers </param>
 		void Init(int minWorkers, int maxWorkers) {
 			__m_isRunning = true;
+			LIW_STATS(m_workerCounters.reset(new Util::LIWWorkerCounters[minWorkers]));
 			for (int i = 0; i < minWorkers; ++i) {
-				m_workers.emplace_back(std::thread(std::bind(&LIW::LIWThreadPoolSized<TasksSize>::ProcessTask, this)));
+				m_workers.emplace_back(std::thread(std::bind(&LIW::LIWThreadPoolSized<TasksSize>::ProcessTask, this, i)));
 			}
 			__m_isInit = true;
 		}
@@ -54,6 +59,49 @@ namespace LIW {
 		/// </summary>
 		/// <returns> count of tasks to process </returns>
 		inline uint64_t GetTasksCount() const { return m_tasks.size(); }
+		/// <summary>
+		/// Get a snapshot of pool stats. (All zero unless LIW_ENABLE_STATS is defined)
+		/// </summary>
+		/// <returns> pool stats </returns>
+		Util::LIWPoolStats GetStats() const {
+			Util::LIWPoolStats stats;
+#ifdef LIW_ENABLE_STATS
+			for (size_t i = 0; i < m_workers.size(); ++i) {
+				stats.m_workers.emplace_back(m_workerCounters[i].Snapshot());
+			}
+#endif
+			stats.m_tasks = m_tasks.get_stats();
+			return stats;
+		}
+		/// <summary>
+		/// Get a snapshot of task latencies (submit to start, start to finish), merged from all workers. (Empty unless LIW_ENABLE_STATS is defined)
+		/// </summary>
+		/// <returns> latency stats </returns>
+		Util::LIWLatencyStats GetLatencyStats() const {
+			Util::LIWLatencyStats stats;
+#ifdef LIW_ENABLE_STATS
+			for (size_t i = 0; i < m_workers.size(); ++i) {
+				m_workerCounters[i].MergeLatencyInto(stats);
+			}
+#endif
+			return stats;
+		}
+		/// <summary>
+		/// Get a snapshot of per-tag accounting (count, wall time, running time, CPU time), merged from all workers and sorted by running time (descending). 
+		/// (Empty unless LIW_ENABLE_STATS is defined) Write it with Util::liw_write_tag_report. 
+		/// </summary>
+		/// <returns> stats of tags with at least one finished task </returns>
+		std::vector<Util::LIWTagStats> GetTagStats() const {
+			std::vector<Util::LIWTagStats> stats;
+#ifdef LIW_ENABLE_STATS
+			stats = Util::liw_make_tag_stats();
+			for (size_t i = 0; i < m_workers.size(); ++i) {
+				m_workerCounters[i].MergeTagsInto(stats);
+			}
+			Util::liw_sort_tag_stats(stats);
+#endif
+			return stats;
+		}
 
 		/// <summary>
 		/// Submit task for the thread pool to execute when task queue is not full. 
@@ -61,6 +109,7 @@ namespace LIW {
 		/// <param name="task"> task to execute </param>
 		/// <returns></returns>
 		inline bool Submit(LIWITask* task) {
+			LIW_STATS(task->m_nsSubmit = Util::liw_stats_now_ns());
 			return m_tasks.push(task);
 		}
 		/// <summary>
@@ -69,6 +118,7 @@ namespace LIW {
 		/// <param name="task"> task to execute </param>
 		/// <returns></returns>
 		inline bool SubmitNow(LIWITask* task) {
+			LIW_STATS(task->m_nsSubmit = Util::liw_stats_now_ns());
 			return m_tasks.push_now(task);
 		}
 
@@ -111,24 +161,38 @@ namespace LIW {
 	private:
 		std::vector<std::thread> m_workers;
 		Util::LIWThreadSafeQueueSized<LIWITask*, TasksSize> m_tasks;
+		LIW_STATS(std::unique_ptr<Util::LIWWorkerCounters[]> m_workerCounters;)
 
 
 	private:
 		/// <summary>
 		/// Loop function to process task. 
 		/// </summary>
-		void ProcessTask() {
-			while (!m_tasks.empty() || __m_isRunning) {
+		/// <param name="idxWorker"> index of the worker running the loop </param>
+		void ProcessTask(int idxWorker) {
+			LIW_STATS(Util::LIWWorkerCounters& counters = m_workerCounters[idxWorker]);
+			while (__m_isRunning || !m_tasks.empty()) { // Check running first: once it reads false, every task submitted before the stop is visible to the empty checks. 
 				LIWITask* task = nullptr;
+				LIW_STATS(const uint64_t tBeg = Util::liw_stats_now_ns());
 				if (m_tasks.pop(task)) {
+					LIW_STATS(const uint64_t tExec = Util::liw_stats_now_ns(); counters.OnTaskStarted(tExec - task->m_nsSubmit));
+					LIW_STATS(const uint32_t idTag = LIWTaskTag::GetID(task->GetTag()); const uint64_t cpuExec = Util::liw_stats_now_cpu());
+					LIW_TRACE(Util::LIWTracer::Begin("Task"));
 					task->Execute(nullptr);
+					LIW_TRACE(Util::LIWTracer::End("Task"));
+					LIW_STATS(const uint64_t cpu = Util::liw_stats_now_cpu() - cpuExec);
 					delete task;
+					LIW_STATS(const uint64_t tEnd = Util::liw_stats_now_ns(); counters.OnTask(); counters.OnTaskFinished(tEnd - tExec); counters.OnTaskAccounted(idTag, tEnd - tExec, tEnd - tExec, cpu));
+					LIW_STATS(counters.OnIdle(tExec - tBeg); counters.OnBusy(tEnd - tExec));
+				}
+				else {
+					LIW_STATS(counters.OnIdle(Util::liw_stats_now_ns() - tBeg));
 				}
 			}
 		}
 
 	private:
-		bool __m_isRunning;
+		std::atomic<bool> __m_isRunning;
 		bool __m_isInit;
 	};
 }
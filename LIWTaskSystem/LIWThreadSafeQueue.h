@@ -4,6 +4,9 @@
 #include <condition_variable>
 #include <queue>
 
+#include "LIWStats.h"
+#include "LIWTracer.h"
+
 namespace LIW {
 	namespace Util {
 		template<class T>
@@ -24,14 +27,29 @@ namespace LIW {
 			/// <param name="val"> Value to enqueue. </param>
 			/// <returns> Is operation successful. </returns>
 			inline bool push_now(const T& val){
-				lock_guard lock(__m_mtx_data);
+				lock_guard lock(LockData(), std::adopt_lock);
 				__m_queue.push(val);
+				LIW_STATS(__m_stats.OnEnqueue(__m_queue.size()));
 				__m_cv_nonempty.notify_one();
 				return true;
 			}
 			inline bool push_now(T&& val) {
-				lock_guard lock(__m_mtx_data);
-				__m_queue.emplace(val);
+				lock_guard lock(LockData(), std::adopt_lock);
+				__m_queue.emplace(std::move(val));
+				LIW_STATS(__m_stats.OnEnqueue(__m_queue.size()));
+				__m_cv_nonempty.notify_one();
+				return true;
+			}
+			/// <summary>
+			/// Construct a value in place at the end of queue immediately. 
+			/// </summary>
+			/// <param name="args"> Arguments to construct the value with. </param>
+			/// <returns> Is operation successful. </returns>
+			template<class... Args>
+			inline bool emplace_now(Args&&... args) {
+				lock_guard lock(LockData(), std::adopt_lock);
+				__m_queue.emplace(std::forward<Args>(args)...);
+				LIW_STATS(__m_stats.OnEnqueue(__m_queue.size()));
 				__m_cv_nonempty.notify_one();
 				return true;
 			}
@@ -42,12 +60,13 @@ namespace LIW {
 			/// <param name="valOut"> Value dequeued. </param>
 			/// <returns> Is operation successful. </returns>
 			bool pop_now(T& valOut) {
-				lock_guard lock(__m_mtx_data);
+				lock_guard lock(LockData(), std::adopt_lock);
 				if (__m_queue.empty()) {
 					return false;
 				}
 				valOut = std::move(__m_queue.front());
 				__m_queue.pop();
+				LIW_STATS(__m_stats.OnDequeue());
 				return true;
 			}
 
@@ -57,13 +76,20 @@ namespace LIW {
 			/// <param name="valOut"> Value dequeued. </param>
 			/// <returns> Is operation successful. Unsuccess means operation terminated. </returns>
 			bool pop(T& valOut) {
-				std::unique_lock<std::mutex> lock_empty(__m_mtx_data);
+				std::unique_lock<std::mutex> lock_empty(LockData(), std::adopt_lock);
+				LIW_STATS(uint64_t tWait = 0);
+				LIW_TRACE(bool isWaiting = false);
 				while (__m_queue.empty() && __m_running) {
+					LIW_STATS(if (tWait == 0) tWait = liw_stats_now_ns());
+					LIW_TRACE(if (!isWaiting) { isWaiting = true; LIWTracer::Begin("QueueWait"); });
 					__m_cv_nonempty.wait_for(lock_empty, c_max_wait);
 				}
+				LIW_STATS(if (tWait != 0) __m_stats.OnWaited(liw_stats_now_ns() - tWait));
+				LIW_TRACE(if (isWaiting) LIWTracer::End("QueueWait"));
 				if (__m_running) {
 					valOut = std::move(__m_queue.front());
 					__m_queue.pop();
+					LIW_STATS(__m_stats.OnDequeue());
 					return true;
 				}
 				else {
@@ -97,27 +123,56 @@ namespace LIW {
 			/// Get size of queue. 
 			/// </summary>
 			/// <returns> Size of queue. </returns>
-			inline typename size_type size() const { lock_guard lk(__m_mtx_data); return __m_queue.size(); }
+			inline size_type size() const { lock_guard lk(__m_mtx_data); return __m_queue.size(); }
 			/// <summary>
 			/// Get if queue is empty. 
 			/// </summary>
 			/// <returns> Is queue empty. </returns>
 			inline bool empty() const { lock_guard lk(__m_mtx_data); return __m_queue.empty(); }
 
+			/// <summary>
+			/// Get a snapshot of queue stats. (All zero unless LIW_ENABLE_STATS is defined)
+			/// </summary>
+			/// <returns> Queue stats. </returns>
+			inline LIWQueueStats get_stats() const {
+#ifdef LIW_ENABLE_STATS
+				return __m_stats.Snapshot();
+#else
+				return LIWQueueStats();
+#endif
+			}
+
 			/// <summary>
 			/// Block the thread until queue is empty. 
 			/// </summary>
 			inline void block_till_empty() {
-				while (!__m_queue.empty()) { std::this_thread::yield(); }
+				while (!empty()) { std::this_thread::yield(); }
 			}
 			/// <summary>
 			/// Notify all pop() calls to stop blocking and exit. 
 			/// </summary>
 			inline void notify_stop() {
-				__m_running = false;
+				{
+					lock_guard lk(__m_mtx_data); // Set under the lock, so a waiter cannot miss it between its check and wait
+					__m_running = false;
+				}
 				__m_cv_nonempty.notify_all();
 			}
 
+		private:
+			/// <summary>
+			/// Lock data mutex (counting contention when stats are enabled). 
+			/// </summary>
+			/// <returns> Locked data mutex. </returns>
+			inline std::mutex& LockData() {
+#ifdef LIW_ENABLE_STATS
+				__m_stats.Lock(__m_mtx_data);
+#else
+				__m_mtx_data.lock();
+#endif
+				return __m_mtx_data;
+			}
+
 		protected:
 			std::queue<T> __m_queue;
 		private:
@@ -125,6 +180,7 @@ namespace LIW {
 			std::condition_variable __m_cv_nonempty;
 			//std::condition_variable __m_cv_empty;
 			bool __m_running = true;
+			LIW_STATS(LIWQueueCounters __m_stats;)
 		};
 	}
 }
\ No newline at end of file
@@ -4,9 +4,16 @@
 #include <condition_variable>
 #include <queue>
 #include <atomic>
+#include <algorithm>
+#include <type_traits>
+#include <cstring>
+#include <new>
 
 #include <iostream>
 
+#include "LIWStats.h"
+#include "LIWTracer.h"
+
 namespace LIW {
 	namespace Util {
 		template<class T, uint64_t Size>
@@ -19,6 +26,12 @@ namespace LIW {
 			const std::chrono::milliseconds c_max_wait = std::chrono::milliseconds(1);
 		public:
 			LIWThreadSafeQueueSized() = default;
+			~LIWThreadSafeQueueSized() {
+				const size_type back = __m_back.load(std::memory_order_relaxed);
+				for (size_type idx = __m_front.load(std::memory_order_relaxed); idx < back; ++idx) { // Destroy values left
+					Slot(idx)->~T();
+				}
+			}
 			LIWThreadSafeQueueSized(const LIWThreadSafeQueueSized&) = delete;
 			LIWThreadSafeQueueSized& operator=(const LIWThreadSafeQueueSized&) = delete;
 
@@ -27,21 +40,22 @@ namespace LIW {
 			/// </summary>
 			/// <param name="val"> Value to enqueue. </param>
 			/// <returns> Is operation successful. </returns>
-			bool push_now(const T& val) {
-				lock_guard lk(__m_mtx_data);
-				if (__m_back.load(std::memory_order_relaxed) - __m_front.load(std::memory_order_relaxed) < Size) {
-					__m_queue[__m_back.fetch_add(1, std::memory_order_release) % Size] = val;
-					__m_cv_nonempty.notify_one();
-					return true;
-				}
-				else {
-					return false;
-				}
+			inline bool push_now(const T& val) {
+				return emplace_now(val);
 			}
-			bool push_now(T&& val) {
-				lock_guard lk(__m_mtx_data);
+			inline bool push_now(T&& val) {
+				return emplace_now(std::move(val));
+			}
+			/// <summary>
+			/// Construct a value in place at the end of queue immediately. 
+			/// </summary>
+			/// <param name="args"> Arguments to construct the value with. </param>
+			/// <returns> Is operation successful. </returns>
+			template<class... Args>
+			bool emplace_now(Args&&... args) {
+				lock_guard lk(LockData(), std::adopt_lock);
 				if (__m_back.load(std::memory_order_relaxed) - __m_front.load(std::memory_order_relaxed) < Size) {
-					__m_queue[__m_back.fetch_add(1, std::memory_order_release) % Size] = val;
+					PushBack(std::forward<Args>(args)...);
 					__m_cv_nonempty.notify_one();
 					return true;
 				}
@@ -55,27 +69,31 @@ namespace LIW {
 			/// </summary>
 			/// <param name="val"> Value to enqueue. </param>
 			/// <returns> Is operation successful. Unsuccess means operation terminated. </returns>
-			bool push(const T& val) {
-				uniq_lock lk_full(__m_mtx_data);
-				while (__m_back.load(std::memory_order_relaxed) - __m_front.load(std::memory_order_relaxed) >= Size && __m_running) {
-					__m_cv_nonfull.wait_for(lk_full, c_max_wait);
-				}
-				if (__m_running) {
-					__m_queue[__m_back.fetch_add(1, std::memory_order_release) % Size] = val;
-					__m_cv_nonempty.notify_one();
-					return true;
-				}
-				else {
-					return false;
-				}
+			inline bool push(const T& val) {
+				return emplace(val);
+			}
+			inline bool push(T&& val) {
+				return emplace(std::move(val));
 			}
-			bool push(T&& val) {
-				uniq_lock lk(__m_mtx_data);
+			/// <summary>
+			/// Construct a value in place at the end of queue when not full. 
+			/// </summary>
+			/// <param name="args"> Arguments to construct the value with. </param>
+			/// <returns> Is operation successful. Unsuccess means operation terminated. </returns>
+			template<class... Args>
+			bool emplace(Args&&... args) {
+				uniq_lock lk(LockData(), std::adopt_lock);
+				LIW_STATS(uint64_t tWait = 0);
+				LIW_TRACE(bool isWaiting = false);
 				while (__m_back.load(std::memory_order_relaxed) - __m_front.load(std::memory_order_relaxed) >= Size && __m_running) {
+					LIW_STATS(if (tWait == 0) tWait = liw_stats_now_ns());
+					LIW_TRACE(if (!isWaiting) { isWaiting = true; LIWTracer::Begin("QueueWait"); });
 					__m_cv_nonfull.wait_for(lk, c_max_wait);
 				}
+				LIW_STATS(if (tWait != 0) __m_stats.OnWaited(liw_stats_now_ns() - tWait));
+				LIW_TRACE(if (isWaiting) LIWTracer::End("QueueWait"));
 				if (__m_running) {
-					__m_queue[__m_back.fetch_add(1, std::memory_order_release) % Size] = val;
+					PushBack(std::forward<Args>(args)...);
 					__m_cv_nonempty.notify_one();
 					return true;
 				}
@@ -90,9 +108,9 @@ namespace LIW {
 			/// <param name="valOut"> Value dequeued. </param>
 			/// <returns> Is operation successful. </returns>
 			bool pop_now(T& valOut) {
-				lock_guard lk(__m_mtx_data);
+				lock_guard lk(LockData(), std::adopt_lock);
 				if (__m_back.load(std::memory_order_relaxed) > __m_front.load(std::memory_order_relaxed)) {
-					valOut = std::move(__m_queue[__m_front.fetch_add(1, std::memory_order_release) % Size]);
+					PopFront(valOut);
 					__m_cv_nonfull.notify_one();
 					return true;
 				}
@@ -107,12 +125,18 @@ namespace LIW {
 			/// <param name="valOut"> Value dequeued. </param>
 			/// <returns> Is operation successful. Unsuccess means operation terminated. </returns>
 			bool pop(T& valOut) {
-				uniq_lock lk(__m_mtx_data);
+				uniq_lock lk(LockData(), std::adopt_lock);
+				LIW_STATS(uint64_t tWait = 0);
+				LIW_TRACE(bool isWaiting = false);
 				while (__m_back.load(std::memory_order_relaxed) <= __m_front.load(std::memory_order_relaxed) && __m_running) {
+					LIW_STATS(if (tWait == 0) tWait = liw_stats_now_ns());
+					LIW_TRACE(if (!isWaiting) { isWaiting = true; LIWTracer::Begin("QueueWait"); });
 					__m_cv_nonempty.wait_for(lk, c_max_wait);
 				}
+				LIW_STATS(if (tWait != 0) __m_stats.OnWaited(liw_stats_now_ns() - tWait));
+				LIW_TRACE(if (isWaiting) LIWTracer::End("QueueWait"));
 				if (__m_running) {
-					valOut = std::move(__m_queue[__m_front.fetch_add(1, std::memory_order_release) % Size]);
+					PopFront(valOut);
 					__m_cv_nonfull.notify_one();
 					return true;
 				}
@@ -121,6 +145,66 @@ namespace LIW {
 				}
 			}
 
+			/// <summary>
+			/// Pop up to maxN values from queue immediately, with a single index update. 
+			/// </summary>
+			/// <param name="valsOut"> Buffer receiving values dequeued (at least maxN long). </param>
+			/// <param name="maxN"> Max count of values to dequeue. </param>
+			/// <returns> Count of values dequeued. </returns>
+			size_type pop_bulk(T* valsOut, size_type maxN) {
+				lock_guard lk(LockData(), std::adopt_lock);
+				const size_type front = __m_front.load(std::memory_order_relaxed);
+				const size_type count = (std::min)(__m_back.load(std::memory_order_relaxed) - front, maxN);
+				if (count == 0) {
+					return 0;
+				}
+				const size_type idxFront = front % Size;
+				const size_type countFirst = (std::min)(count, Size - idxFront); // Range could wrap around the ring
+				MoveOutRange(valsOut, Slot(idxFront), countFirst);
+				MoveOutRange(valsOut + countFirst, Slot(0), count - countFirst);
+				__m_front.fetch_add(count, std::memory_order_release);
+				LIW_STATS(__m_stats.OnDequeue(count));
+				__m_cv_nonfull.notify_all();
+				return count;
+			}
+
+			/// <summary>
+			/// Steal half of the values in other queue (rounded up, as many as fit) into this queue. 
+			/// </summary>
+			/// <param name="other"> Queue to steal from. </param>
+			/// <returns> Count of values stolen. </returns>
+			size_type steal_half(LIWThreadSafeQueueSized& other) {
+				if (&other == this) {
+					return 0;
+				}
+				std::lock(__m_mtx_data, other.__m_mtx_data);
+				lock_guard lk(__m_mtx_data, std::adopt_lock);
+				lock_guard lkOther(other.__m_mtx_data, std::adopt_lock);
+				const size_type frontOther = other.__m_front.load(std::memory_order_relaxed);
+				const size_type sizeOther = other.__m_back.load(std::memory_order_relaxed) - frontOther;
+				const size_type back = __m_back.load(std::memory_order_relaxed);
+				const size_type space = Size - (back - __m_front.load(std::memory_order_relaxed));
+				const size_type count = (std::min)((sizeOther + 1) / 2, space);
+				if (count == 0) {
+					return 0;
+				}
+				size_type moved = 0;
+				while (moved < count) { // Copy contiguous segments. (Both rings could wrap around)
+					const size_type idxSrc = (frontOther + moved) % Size;
+					const size_type idxDst = (back + moved) % Size;
+					const size_type countSeg = (std::min)({ count - moved, Size - idxSrc, Size - idxDst });
+					RelocateRange(Slot(idxDst), other.Slot(idxSrc), countSeg);
+					moved += countSeg;
+				}
+				other.__m_front.fetch_add(count, std::memory_order_release);
+				__m_back.fetch_add(count, std::memory_order_release);
+				LIW_STATS(other.__m_stats.OnDequeue(count));
+				LIW_STATS(__m_stats.OnEnqueue(size(), count));
+				other.__m_cv_nonfull.notify_all();
+				__m_cv_nonempty.notify_all();
+				return count;
+			}
+
 			/// <summary>
 			/// Get a copy of the front of the queue. 
 			/// </summary>
@@ -129,7 +213,7 @@ namespace LIW {
 			bool front(T& valOut) {
 				lock_guard lk(__m_mtx_data);
 				if (__m_front.load(std::memory_order_relaxed) != __m_back.load(std::memory_order_relaxed)) {
-					valOut = __m_queue[__m_front.load(std::memory_order_relaxed) % Size];
+					valOut = *Slot(__m_front.load(std::memory_order_relaxed));
 					return true;
 				}
 				else {
@@ -144,7 +228,7 @@ namespace LIW {
 			bool back(T& valOut) {
 				lock_guard lk(__m_mtx_data);
 				if (__m_front.load(std::memory_order_relaxed) != __m_back.load(std::memory_order_relaxed)) {
-					valOut = __m_queue[__m_back.load(std::memory_order_relaxed) - 1 % Size];
+					valOut = *Slot(__m_back.load(std::memory_order_relaxed) - 1);
 					return true;
 				}
 				else {
@@ -155,13 +239,30 @@ namespace LIW {
 			/// Get size of queue. 
 			/// </summary>
 			/// <returns> Size of queue. </returns>
-			inline typename size_type size() const { return __m_back.load(std::memory_order_acquire) - __m_front.load(std::memory_order_acquire); }
+			inline size_type size() const {
+				// Load front first. Back only grows, so back >= front here. Clamp, since a racing pop-then-push may make it look over full. 
+				const size_type front = __m_front.load(std::memory_order_acquire);
+				const size_type back = __m_back.load(std::memory_order_acquire);
+				return back - front < Size ? back - front : Size;
+			}
 			/// <summary>
 			/// Get if queue is empty. 
 			/// </summary>
 			/// <returns> Is queue empty. </returns>
 			inline bool empty() const { return __m_back.load(std::memory_order_acquire) == __m_front.load(std::memory_order_acquire); }
 
+			/// <summary>
+			/// Get a snapshot of queue stats. (All zero unless LIW_ENABLE_STATS is defined)
+			/// </summary>
+			/// <returns> Queue stats. </returns>
+			inline LIWQueueStats get_stats() const {
+#ifdef LIW_ENABLE_STATS
+				return __m_stats.Snapshot();
+#else
+				return LIWQueueStats();
+#endif
+			}
+
 			/// <summary>
 			/// Block the thread until queue is empty. 
 			/// </summary>
@@ -172,22 +273,106 @@ namespace LIW {
 			/// Notify all pop() calls to stop blocking and exit. 
 			/// </summary>
 			inline void notify_stop() {
-				__m_running = false;
+				{
+					lock_guard lk(__m_mtx_data); // Set under the lock, so a waiter cannot miss it between its check and wait
+					__m_running = false;
+				}
 				__m_cv_nonempty.notify_all();
 				__m_cv_nonfull.notify_all();
 			}
 
+		private:
+			/// <summary>
+			/// Get the storage slot of an index. 
+			/// </summary>
+			inline T* Slot(size_type idx) {
+				return reinterpret_cast<T*>(&__m_queue[idx % Size]);
+			}
+
+			/// <summary>
+			/// Lock data mutex (counting contention when stats are enabled). 
+			/// </summary>
+			/// <returns> Locked data mutex. </returns>
+			inline std::mutex& LockData() {
+#ifdef LIW_ENABLE_STATS
+				__m_stats.Lock(__m_mtx_data);
+#else
+				__m_mtx_data.lock();
+#endif
+				return __m_mtx_data;
+			}
+
+			/// <summary>
+			/// Construct a value at the back of queue. (Lock must be held, queue must not be full)
+			/// </summary>
+			template<class... Args>
+			inline void PushBack(Args&&... args) {
+				const size_type back = __m_back.load(std::memory_order_relaxed);
+				new(Slot(back)) T(std::forward<Args>(args)...);
+				__m_back.store(back + 1, std::memory_order_release);
+				LIW_STATS(__m_stats.OnEnqueue(back + 1 - __m_front.load(std::memory_order_relaxed)));
+			}
+
+			/// <summary>
+			/// Move the front value out and destroy it in queue. (Lock must be held, queue must not be empty)
+			/// </summary>
+			inline void PopFront(T& valOut) {
+				const size_type front = __m_front.load(std::memory_order_relaxed);
+				T* const slot = Slot(front);
+				valOut = std::move(*slot);
+				slot->~T();
+				__m_front.store(front + 1, std::memory_order_release);
+				LIW_STATS(__m_stats.OnDequeue());
+			}
+
+			/// <summary>
+			/// Move a contiguous range out of the queue into constructed values, and destroy them in queue. 
+			/// Trivially copyable values (e.g. pointers) are moved with a single memcpy. 
+			/// </summary>
+			static inline void MoveOutRange(T* dst, T* src, size_type count) {
+				MoveOutRange(dst, src, count, std::is_trivially_copyable<T>());
+			}
+			static inline void MoveOutRange(T* dst, T* src, size_type count, std::true_type) {
+				if (count > 0) {
+					memcpy(dst, src, sizeof(T) * count);
+				}
+			}
+			static inline void MoveOutRange(T* dst, T* src, size_type count, std::false_type) {
+				for (size_type i = 0; i < count; ++i) {
+					dst[i] = std::move(src[i]);
+					src[i].~T();
+				}
+			}
+			/// <summary>
+			/// Move a contiguous range into uninitialized storage, and destroy them in source. 
+			/// Trivially copyable values (e.g. pointers) are moved with a single memcpy. 
+			/// </summary>
+			static inline void RelocateRange(T* dst, T* src, size_type count) {
+				RelocateRange(dst, src, count, std::is_trivially_copyable<T>());
+			}
+			static inline void RelocateRange(T* dst, T* src, size_type count, std::true_type) {
+				if (count > 0) {
+					memcpy(dst, src, sizeof(T) * count);
+				}
+			}
+			static inline void RelocateRange(T* dst, T* src, size_type count, std::false_type) {
+				for (size_type i = 0; i < count; ++i) {
+					new(dst + i) T(std::move(src[i]));
+					src[i].~T();
+				}
+			}
+
 		protected:
-			T __m_queue[Size];
-			std::atomic<size_type> __m_front;
-			//size_type __m_front = 0;
-			std::atomic<size_type> __m_back;
-			//size_type __m_back = 0;
+			struct alignas(T) storage_type { unsigned char m_data[sizeof(T)]; }; // Raw storage. T is constructed on push and destroyed on pop. 
+			storage_type __m_queue[Size];
+			std::atomic<size_type> __m_front{ 0 };
+			std::atomic<size_type> __m_back{ 0 };
 		private:
 			mutable std::mutex __m_mtx_data;
 			std::condition_variable __m_cv_nonempty;
 			std::condition_variable __m_cv_nonfull;
 			bool __m_running = true;
+			LIW_STATS(LIWQueueCounters __m_stats;)
 		};
 	}
 }
\ No newline at end of file
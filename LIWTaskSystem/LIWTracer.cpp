@@ -0,0 +1,100 @@
+#include "LIWTracer.h"
+
+#include <fstream>
+#include <thread>
+
+thread_local LIW::Util::LIWTracer::ThreadBuffer* LIW::Util::LIWTracer::tl_buffer = nullptr;
+std::mutex LIW::Util::LIWTracer::s_mtxBuffers;
+std::vector<std::unique_ptr<LIW::Util::LIWTracer::ThreadBuffer>> LIW::Util::LIWTracer::s_buffers;
+uint64_t LIW::Util::LIWTracer::s_tickStart = LIW::Util::LIWTracer::Now();
+std::chrono::steady_clock::time_point LIW::Util::LIWTracer::s_timeStart = std::chrono::steady_clock::now();
+
+static void WriteJsonString(std::ostream& os, const char* str)
+{
+	os << '"';
+	for (const char* c = str; c && *c; ++c) {
+		if (*c == '"' || *c == '\\') os << '\\';
+		os << *c;
+	}
+	os << '"';
+}
+
+void LIW::Util::LIWTracer::DumpChromeTrace(std::ostream& os)
+{
+	std::lock_guard<std::mutex> lk(s_mtxBuffers);
+	const double ticksPerUs = GetTicksPerMicrosecond();
+	const std::ios::fmtflags flags = os.flags();
+
+	os << "{\"traceEvents\":[\n";
+	bool first = true;
+	for (auto& buffer : s_buffers) {
+		// Thread name
+		if (!first) os << ",\n";
+		first = false;
+		os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->m_threadIdx
+		   << ",\"args\":{\"name\":\"thread " << buffer->m_threadIdx << "\"}}";
+
+		// Events (only the last c_bufferCapacity are kept)
+		const uint64_t countWritten = buffer->m_countWritten.load(std::memory_order_acquire);
+		const uint64_t countCleared = buffer->m_countCleared.load(std::memory_order_relaxed);
+		const uint64_t idxBeg = countWritten > countCleared + c_bufferCapacity ? countWritten - c_bufferCapacity : countCleared;
+		for (uint64_t idx = idxBeg; idx < countWritten; ++idx) {
+			const LIWTraceEvent& ev = buffer->m_events[idx % c_bufferCapacity];
+			const double ts = ev.m_timestamp >= s_tickStart ? (double)(ev.m_timestamp - s_tickStart) / ticksPerUs : 0.0;
+			const char* phase = ev.m_type == LIWTraceEventType::Begin ? "B" : (ev.m_type == LIWTraceEventType::End ? "E" : "i");
+			os << ",\n{\"name\":";
+			WriteJsonString(os, ev.m_name);
+			os << ",\"ph\":\"" << phase << "\",\"ts\":" << std::fixed << ts
+			   << ",\"pid\":0,\"tid\":" << buffer->m_threadIdx;
+			if (ev.m_type == LIWTraceEventType::Instant) {
+				os << ",\"s\":\"t\"";
+			}
+			os << ",\"args\":{\"arg\":" << ev.m_arg << "}}";
+		}
+	}
+	os << "\n]}\n";
+	os.flags(flags);
+}
+
+bool LIW::Util::LIWTracer::DumpChromeTrace(const char* path)
+{
+	std::ofstream fout(path);
+	if (!fout.is_open())
+		return false;
+	DumpChromeTrace(fout);
+	return true;
+}
+
+void LIW::Util::LIWTracer::Clear()
+{
+	std::lock_guard<std::mutex> lk(s_mtxBuffers);
+	for (auto& buffer : s_buffers) { // Move the start past the events written so far, rather than resetting the count under a recording thread
+		buffer->m_countCleared.store(buffer->m_countWritten.load(std::memory_order_acquire), std::memory_order_relaxed);
+	}
+}
+
+LIW::Util::LIWTracer::ThreadBuffer* LIW::Util::LIWTracer::RegisterThread()
+{
+	std::lock_guard<std::mutex> lk(s_mtxBuffers);
+	s_buffers.emplace_back(new ThreadBuffer());
+	ThreadBuffer* buffer = s_buffers.back().get();
+	buffer->m_threadIdx = (uint32_t)(s_buffers.size() - 1);
+	tl_buffer = buffer;
+	return buffer;
+}
+
+double LIW::Util::LIWTracer::GetTicksPerMicrosecond()
+{
+#ifdef LIW_TRACE_HAS_TSC
+	using namespace std::chrono;
+	// Calibrate TSC against steady clock since tracer start
+	while (steady_clock::now() - s_timeStart < milliseconds(1)) {
+		std::this_thread::yield();
+	}
+	const uint64_t ticks = Now() - s_tickStart;
+	const double us = (double)duration_cast<nanoseconds>(steady_clock::now() - s_timeStart).count() / 1000.0;
+	return (double)ticks / us;
+#else
+	return 1000.0; // Steady clock ns
+#endif
+}
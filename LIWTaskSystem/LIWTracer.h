@@ -0,0 +1,134 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define LIW_TRACE_HAS_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define LIW_TRACE_HAS_TSC
+#endif
+
+/*
+* Optional timeline tracer of tasks and fibers.
+* Define LIW_ENABLE_TRACE to enable. When disabled, trace points are compiled out.
+* Each thread records events into its own ring buffer (oldest events are overwritten).
+* Call LIWTracer::DumpChromeTrace to write a Chrome trace JSON (chrome://tracing or ui.perfetto.dev).
+*/
+#ifdef LIW_ENABLE_TRACE
+#define LIW_TRACE(...) __VA_ARGS__
+#else
+#define LIW_TRACE(...)
+#endif
+
+namespace LIW {
+	namespace Util {
+		enum class LIWTraceEventType : uint32_t {
+			Begin,		// Begin of a slice on this thread
+			End,		// End of a slice on this thread
+			Instant		// Single point in time
+		};
+
+		struct LIWTraceEvent {
+			uint64_t m_timestamp;		// TSC (or steady clock ns when TSC is not available)
+			const char* m_name;			// Static string naming the event
+			uint64_t m_arg;				// Event argument (fiber id, sync counter index...)
+			LIWTraceEventType m_type;
+		};
+
+		class LIWTracer {
+		public:
+			static const size_t c_bufferCapacity = size_t{ 1 } << 16; // Events kept per thread
+
+		private:
+			struct ThreadBuffer {
+				LIWTraceEvent m_events[c_bufferCapacity];
+				std::atomic<uint64_t> m_countWritten{ 0 }; // Only written by the thread recording, so Clear never races with Record
+				std::atomic<uint64_t> m_countCleared{ 0 }; // Count written when Clear was last called. Events before it are discarded.
+				uint32_t m_threadIdx{ 0 };
+			};
+
+		public:
+			/// <summary>
+			/// Get current timestamp of the trace clock.
+			/// </summary>
+			static inline uint64_t Now() {
+#ifdef LIW_TRACE_HAS_TSC
+				return __rdtsc();
+#else
+				return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+			}
+
+			/// <summary>
+			/// Record the begin of a slice on this thread.
+			/// </summary>
+			/// <param name="name"> static string naming the slice </param>
+			/// <param name="arg"> argument </param>
+			static inline void Begin(const char* name, uint64_t arg = 0) { Record(LIWTraceEventType::Begin, name, arg); }
+			/// <summary>
+			/// Record the end of a slice on this thread.
+			/// </summary>
+			/// <param name="name"> static string naming the slice </param>
+			/// <param name="arg"> argument </param>
+			static inline void End(const char* name, uint64_t arg = 0) { Record(LIWTraceEventType::End, name, arg); }
+			/// <summary>
+			/// Record an instant event on this thread.
+			/// </summary>
+			/// <param name="name"> static string naming the event </param>
+			/// <param name="arg"> argument </param>
+			static inline void Instant(const char* name, uint64_t arg = 0) { Record(LIWTraceEventType::Instant, name, arg); }
+
+			/// <summary>
+			/// Record an event into the ring buffer of this thread.
+			/// </summary>
+			static inline void Record(LIWTraceEventType type, const char* name, uint64_t arg) {
+				ThreadBuffer* buffer = tl_buffer;
+				if (!buffer) {
+					buffer = RegisterThread();
+				}
+				const uint64_t idx = buffer->m_countWritten.load(std::memory_order_relaxed);
+				LIWTraceEvent& ev = buffer->m_events[idx % c_bufferCapacity];
+				ev.m_timestamp = Now();
+				ev.m_name = name;
+				ev.m_arg = arg;
+				ev.m_type = type;
+				buffer->m_countWritten.store(idx + 1, std::memory_order_release);
+			}
+
+			/// <summary>
+			/// Write all recorded events as Chrome trace JSON.
+			/// NOTE: Events recorded concurrently with dumping may be torn. Dump while pools are idle for an exact trace.
+			/// </summary>
+			/// <param name="os"> stream to write to </param>
+			static void DumpChromeTrace(std::ostream& os);
+			/// <summary>
+			/// Write all recorded events as Chrome trace JSON into a file.
+			/// </summary>
+			/// <param name="path"> file path </param>
+			/// <returns> is operation successful? </returns>
+			static bool DumpChromeTrace(const char* path);
+			/// <summary>
+			/// Discard all recorded events. Safe while threads are recording (events recorded concurrently may be kept).
+			/// </summary>
+			static void Clear();
+
+		private:
+			static ThreadBuffer* RegisterThread();
+			static double GetTicksPerMicrosecond();
+
+		private:
+			static thread_local ThreadBuffer* tl_buffer;
+			static std::mutex s_mtxBuffers;
+			static std::vector<std::unique_ptr<ThreadBuffer>> s_buffers; // Buffers outlive their threads, so they can be dumped after pools stop.
+			static uint64_t s_tickStart;
+			static std::chrono::steady_clock::time_point s_timeStart;
+		};
+	}
+}
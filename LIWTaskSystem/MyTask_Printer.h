@@ -15,7 +15,7 @@ class MyTask_Printer :
 {
 public:
     MyTask_Printer(const std::string& str) : m_str(str) {}
-    MyTask_Printer(std::string&& str) : m_str(str) {}
+    MyTask_Printer(std::string&& str) : m_str(std::move(str)) {}
     void Execute(void*) override;
 private:
     std::string m_str;
@@ -15,7 +15,7 @@ class MyTask_Printer_Sized :
 {
 public:
     MyTask_Printer_Sized(const std::string& str) : m_str(str) {}
-    MyTask_Printer_Sized(std::string&& str) : m_str(str) {}
+    MyTask_Printer_Sized(std::string&& str) : m_str(std::move(str)) {}
     void Execute(void*) override;
 private:
     std::string m_str;
@@ -0,0 +1,158 @@
+#pragma once
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include "LIWBenchmark.h"
+#include "LIWFiberMain.h"
+#include "LIWFiberWorker.h"
+#include "LIWFiberThreadPool.h"
+#include "LIWFiberThreadPoolSized.h"
+
+using namespace LIW;
+using namespace LIW::Util;
+
+typedef LIWFiberThreadPoolSized<1 << 8, 1 << 10, 1 << 16, 1 << 10> bench_fiber_pool_sized_type;
+
+inline int benchmark_count_fiber_workers() {
+	return std::max(2, (int)std::thread::hardware_concurrency());
+}
+inline void benchmark_fiber_pool_init(LIWFiberThreadPool& pool) { pool.Init(benchmark_count_fiber_workers(), 256); }
+inline void benchmark_fiber_pool_init(bench_fiber_pool_sized_type& pool) { pool.Init(benchmark_count_fiber_workers()); }
+
+/*
+* Fiber switch: main fiber switches to a fiber, which yields right back.
+*/
+void BenchFiber_YieldLoop(LIWFiberWorker* thisFiber, void* param) {
+	const uint64_t countOps = *reinterpret_cast<uint64_t*>(param);
+	for (uint64_t i = 0; i < countOps; ++i) {
+		thisFiber->YieldToMain();
+	}
+}
+
+uint64_t benchmark_fiber_switch(uint64_t countOps) {
+	static LIWFiberMain* s_fiberMain = LIWFiberMain::InitThreadMainFiber(); // A thread can only be converted once
+	LIWFiberWorker* fiber = new LIWFiberWorker(0);
+	fiber->SetMainFiber(s_fiberMain);
+	fiber->SetRunFunction(BenchFiber_YieldLoop, &countOps);
+	const uint64_t tBeg = liw_bench_now_ns();
+	for (uint64_t i = 0; i < countOps; ++i) {
+		s_fiberMain->YieldTo(fiber); // Round trip: main -> fiber -> main
+	}
+	const uint64_t tEnd = liw_bench_now_ns();
+	s_fiberMain->YieldTo(fiber); // Let the run function return
+	delete fiber;
+	return tEnd - tBeg;
+}
+
+/*
+* Fiber pool submit-to-execute latency.
+*/
+void BenchFiberTask_Stamp(LIWFiberWorker* thisFiber, void* param) {
+	reinterpret_cast<std::atomic<uint64_t>*>(param)->store(liw_bench_now_ns(), std::memory_order_release);
+}
+
+template<class Pool>
+uint64_t benchmark_fiber_pool_submit_latency(uint64_t countOps) {
+	Pool* pool = new Pool();
+	benchmark_fiber_pool_init(*pool);
+	std::atomic<uint64_t> tExec{ 0 };
+	uint64_t nsTotal = 0;
+	for (uint64_t i = 0; i < countOps; ++i) {
+		tExec.store(0, std::memory_order_relaxed);
+		const uint64_t tSubmit = liw_bench_now_ns();
+		pool->Submit(new LIWFiberTask{ BenchFiberTask_Stamp, &tExec });
+		uint64_t t;
+		while ((t = tExec.load(std::memory_order_acquire)) == 0) {
+			std::this_thread::yield();
+		}
+		nsTotal += t - tSubmit;
+	}
+	pool->WaitAndStop();
+	delete pool;
+	return nsTotal;
+}
+
+/*
+* Fork/join inside the fiber pool: a root task forks countOps subtasks and waits on a sync counter. (Inline: subtasks run on the worker thread)
+* Sync counter wake latency: a root task repeatedly forks one subtask and waits on a sync counter.
+*/
+template<class Pool>
+struct BenchParam_FiberJoin {
+	Pool* m_pool;
+	uint64_t m_countOps;
+	std::atomic<uint64_t> m_tDecrease{ 0 }; // When the last subtask decreased the sync counter
+	std::atomic<uint64_t> m_nsWake{ 0 }; // Sum of wake latency
+	std::atomic<bool> m_isDone{ false };
+};
+
+template<class Pool>
+void BenchFiberTask_Join(LIWFiberWorker* thisFiber, void* param) {
+	BenchParam_FiberJoin<Pool>* paramJoin = reinterpret_cast<BenchParam_FiberJoin<Pool>*>(param);
+	paramJoin->m_tDecrease.store(liw_bench_now_ns(), std::memory_order_relaxed);
+	paramJoin->m_pool->DecreaseSyncCounter(0);
+}
+
+template<class Pool, bool IsInline>
+void BenchFiberTask_Fanout(LIWFiberWorker* thisFiber, void* param) {
+	BenchParam_FiberJoin<Pool>* paramJoin = reinterpret_cast<BenchParam_FiberJoin<Pool>*>(param);
+	paramJoin->m_pool->IncreaseSyncCounter(0, (int)paramJoin->m_countOps);
+	for (uint64_t i = 0; i < paramJoin->m_countOps; ++i) {
+		LIWFiberTask* task = new LIWFiberTask{ BenchFiberTask_Join<Pool>, paramJoin };
+		task->m_isInline = IsInline; // Leaf subtasks never yield
+		paramJoin->m_pool->Submit(task);
+	}
+	paramJoin->m_pool->WaitForSyncCounter(0, thisFiber);
+	paramJoin->m_isDone.store(true, std::memory_order_release);
+}
+
+template<class Pool>
+void BenchFiberTask_WakeLoop(LIWFiberWorker* thisFiber, void* param) {
+	BenchParam_FiberJoin<Pool>* paramJoin = reinterpret_cast<BenchParam_FiberJoin<Pool>*>(param);
+	uint64_t nsWake = 0;
+	for (uint64_t i = 0; i < paramJoin->m_countOps; ++i) {
+		paramJoin->m_pool->IncreaseSyncCounter(0, 1);
+		paramJoin->m_pool->Submit(new LIWFiberTask{ BenchFiberTask_Join<Pool>, paramJoin });
+		paramJoin->m_pool->WaitForSyncCounter(0, thisFiber);
+		nsWake += liw_bench_now_ns() - paramJoin->m_tDecrease.load(std::memory_order_relaxed);
+	}
+	paramJoin->m_nsWake.store(nsWake, std::memory_order_relaxed);
+	paramJoin->m_isDone.store(true, std::memory_order_release);
+}
+
+template<class Pool>
+uint64_t benchmark_fiber_pool_join(uint64_t countOps, LIWFiberRunner rootTask, bool isWakeLatency) {
+	Pool* pool = new Pool();
+	benchmark_fiber_pool_init(*pool);
+	BenchParam_FiberJoin<Pool> paramJoin;
+	paramJoin.m_pool = pool;
+	paramJoin.m_countOps = countOps;
+	const uint64_t tBeg = liw_bench_now_ns();
+	pool->Submit(new LIWFiberTask{ rootTask, &paramJoin });
+	while (!paramJoin.m_isDone.load(std::memory_order_acquire)) {
+		std::this_thread::yield();
+	}
+	const uint64_t tEnd = liw_bench_now_ns();
+	pool->WaitAndStop();
+	delete pool;
+	return isWakeLatency ? paramJoin.m_nsWake.load(std::memory_order_relaxed) : tEnd - tBeg;
+}
+
+template<class Pool>
+uint64_t benchmark_fiber_pool_fanout(uint64_t countOps) { return benchmark_fiber_pool_join<Pool>(countOps, BenchFiberTask_Fanout<Pool, false>, false); }
+template<class Pool>
+uint64_t benchmark_fiber_pool_fanout_inline(uint64_t countOps) { return benchmark_fiber_pool_join<Pool>(countOps, BenchFiberTask_Fanout<Pool, true>, false); }
+template<class Pool>
+uint64_t benchmark_fiber_pool_sync_wake_latency(uint64_t countOps) { return benchmark_fiber_pool_join<Pool>(countOps, BenchFiberTask_WakeLoop<Pool>, true); }
+
+void benchmark_register_fiber(LIWBenchmarkSuite& suite) {
+	suite.Add("fiber/switch_roundtrip", benchmark_fiber_switch, 1000000);
+	suite.Add("fiber_pool/submit_latency", benchmark_fiber_pool_submit_latency<LIWFiberThreadPool>, 10000);
+	suite.Add("fiber_pool/fanout", benchmark_fiber_pool_fanout<LIWFiberThreadPool>, 10000);
+	suite.Add("fiber_pool/fanout_inline", benchmark_fiber_pool_fanout_inline<LIWFiberThreadPool>, 10000);
+	suite.Add("fiber_pool/sync_wake_latency", benchmark_fiber_pool_sync_wake_latency<LIWFiberThreadPool>, 10000);
+	suite.Add("fiber_pool_sized/submit_latency", benchmark_fiber_pool_submit_latency<bench_fiber_pool_sized_type>, 10000);
+	suite.Add("fiber_pool_sized/fanout", benchmark_fiber_pool_fanout<bench_fiber_pool_sized_type>, 10000);
+	suite.Add("fiber_pool_sized/fanout_inline", benchmark_fiber_pool_fanout_inline<bench_fiber_pool_sized_type>, 10000);
+	suite.Add("fiber_pool_sized/sync_wake_latency", benchmark_fiber_pool_sync_wake_latency<bench_fiber_pool_sized_type>, 10000);
+}
@@ -0,0 +1,18 @@
+/*
+* Entry of the benchmark executable (built by CMake target "benchmark").
+* Run with --help for options. E.g.
+*	benchmark --filter fiber --format csv --out bench.csv
+*/
+#include "benchmark_queue.h"
+#include "benchmark_pool.h"
+#include "benchmark_fiber.h"
+#include "benchmark_memory.h"
+
+int main(int argc, char** argv) {
+	LIWBenchmarkSuite suite;
+	benchmark_register_queue(suite);
+	benchmark_register_pool(suite);
+	benchmark_register_fiber(suite);
+	benchmark_register_memory(suite);
+	return suite.Main(argc, argv);
+}
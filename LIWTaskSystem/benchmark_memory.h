@@ -0,0 +1,230 @@
+#pragma once
+#include <cstdlib>
+#include <algorithm>
+
+#include "LIWBenchmark.h"
+#include "LIWLGStackAllocator.h"
+#include "LIWLGPoolAllocator.h"
+#include "LIWLGGPAllocator.h"
+#include "LIWObjectPool.h"
+#include "LIWLGSlabAllocator.h"
+#include "LIWMemory.h"
+
+using namespace LIW;
+using namespace LIW::Util;
+
+/*
+* Alloc/free rate of each allocator. An operation is one allocation and its free.
+* Allocations are done in batches of c_benchAllocBatch, then freed (or reset for stack allocators).
+*/
+static const uint64_t c_benchAllocBatch = 1024;
+static const size_t c_benchAllocSize = 64;
+
+typedef LIWLGStackAllocator<64 * 1024 * 1024, 64 * 1024> bench_stack_allocator_type;
+typedef LIWLGPoolAllocator<c_benchAllocSize, uint32_t, c_benchAllocBatch, 64> bench_pool_allocator_type;
+typedef LIWLGGPAllocator<64 * 1024 * 1024, c_benchAllocBatch * 2, 256 * 1024> bench_gp_allocator_type;
+struct BenchPooledObject { char m_data[c_benchAllocSize]; };
+typedef LIWObjectPool<BenchPooledObject, c_benchAllocBatch, 64> bench_object_pool_type;
+typedef LIWLGPoolAllocator<c_benchAllocSize, uint32_t, c_benchAllocBatch, 16 * 1024> bench_pool_allocator_1gb_type;
+typedef LIWLGSlabAllocator<64 * 1024, 256> bench_slab_allocator_type;
+
+uint64_t benchmark_memory_malloc(uint64_t countOps) {
+	void* ptrs[c_benchAllocBatch];
+	const uint64_t tBeg = liw_bench_now_ns();
+	for (uint64_t i = 0; i < countOps; i += c_benchAllocBatch) {
+		const uint64_t count = std::min(c_benchAllocBatch, countOps - i);
+		for (uint64_t j = 0; j < count; ++j) {
+			ptrs[j] = malloc(c_benchAllocSize);
+			liw_bench_keep(ptrs[j]);
+		}
+		for (uint64_t j = 0; j < count; ++j) {
+			free(ptrs[j]);
+		}
+	}
+	return liw_bench_now_ns() - tBeg;
+}
+
+uint64_t benchmark_memory_stack(uint64_t countOps) {
+	bench_stack_allocator_type::GlobalStackAllocator* globalAllocator = new bench_stack_allocator_type::GlobalStackAllocator();
+	bench_stack_allocator_type::LocalStackAllocator* localAllocator = new bench_stack_allocator_type::LocalStackAllocator();
+	globalAllocator->Init();
+	localAllocator->Init(*globalAllocator);
+	const uint64_t tBeg = liw_bench_now_ns();
+	for (uint64_t i = 0; i < countOps; i += c_benchAllocBatch) {
+		const uint64_t count = std::min(c_benchAllocBatch, countOps - i);
+		for (uint64_t j = 0; j < count; ++j) {
+			liw_bench_keep(localAllocator->Allocate(c_benchAllocSize));
+		}
+		// Free everything (like a frame)
+		globalAllocator->Clear();
+		localAllocator->Init(*globalAllocator);
+	}
+	const uint64_t tEnd = liw_bench_now_ns();
+	globalAllocator->Cleanup();
+	delete localAllocator;
+	delete globalAllocator;
+	return tEnd - tBeg;
+}
+
+uint64_t benchmark_memory_pool(uint64_t countOps) {
+	bench_pool_allocator_type::GlobalPoolAllocator* globalAllocator = new bench_pool_allocator_type::GlobalPoolAllocator();
+	bench_pool_allocator_type::LocalPoolAllocator* localAllocator = new bench_pool_allocator_type::LocalPoolAllocator();
+	globalAllocator->Init();
+	localAllocator->Init(*globalAllocator);
+	void* ptrs[c_benchAllocBatch];
+	const uint64_t tBeg = liw_bench_now_ns();
+	for (uint64_t i = 0; i < countOps; i += c_benchAllocBatch) {
+		const uint64_t count = std::min(c_benchAllocBatch, countOps - i);
+		for (uint64_t j = 0; j < count; ++j) {
+			ptrs[j] = localAllocator->Fetch();
+			liw_bench_keep(ptrs[j]);
+		}
+		for (uint64_t j = 0; j < count; ++j) {
+			localAllocator->Return(ptrs[j]);
+		}
+	}
+	const uint64_t tEnd = liw_bench_now_ns();
+	globalAllocator->Cleanup();
+	delete localAllocator;
+	delete globalAllocator;
+	return tEnd - tBeg;
+}
+
+/*
+* Start-up cost of a 1GB pool. An operation is an init, a fetch and a cleanup. 
+*/
+uint64_t benchmark_memory_pool_init_1gb(uint64_t countOps) {
+	bench_pool_allocator_1gb_type::GlobalPoolAllocator* globalAllocator = new bench_pool_allocator_1gb_type::GlobalPoolAllocator();
+	bench_pool_allocator_1gb_type::LocalPoolAllocator* localAllocator = new bench_pool_allocator_1gb_type::LocalPoolAllocator();
+	const uint64_t tBeg = liw_bench_now_ns();
+	for (uint64_t i = 0; i < countOps; ++i) {
+		globalAllocator->Init();
+		localAllocator->Init(*globalAllocator);
+		liw_bench_keep(localAllocator->Fetch());
+		localAllocator->Cleanup();
+		globalAllocator->Cleanup();
+	}
+	const uint64_t tEnd = liw_bench_now_ns();
+	delete localAllocator;
+	delete globalAllocator;
+	return tEnd - tBeg;
+}
+
+uint64_t benchmark_memory_object_pool_batch(uint64_t countOps) {
+	bench_object_pool_type::GlobalObjectPool* globalPool = new bench_object_pool_type::GlobalObjectPool();
+	bench_object_pool_type::LocalObjectPool* localPool = new bench_object_pool_type::LocalObjectPool();
+	globalPool->Init();
+	localPool->Init(*globalPool);
+	BenchPooledObject* ptrs[c_benchAllocBatch];
+	const uint64_t tBeg = liw_bench_now_ns();
+	for (uint64_t i = 0; i < countOps; i += c_benchAllocBatch) {
+		const uint64_t count = std::min(c_benchAllocBatch, countOps - i);
+		localPool->FetchN(ptrs, count);
+		liw_bench_keep(ptrs[0]);
+		localPool->ReturnN(ptrs, count);
+	}
+	const uint64_t tEnd = liw_bench_now_ns();
+	localPool->Cleanup();
+	globalPool->Cleanup();
+	delete localPool;
+	delete globalPool;
+	return tEnd - tBeg;
+}
+
+uint64_t benchmark_memory_mem_pool(uint64_t countOps) {
+	liw_hdl_type handles[c_benchAllocBatch];
+	const uint64_t tBeg = liw_bench_now_ns();
+	for (uint64_t i = 0; i < countOps; i += c_benchAllocBatch) {
+		const uint64_t count = std::min(c_benchAllocBatch, countOps - i);
+		for (uint64_t j = 0; j < count; ++j) {
+			handles[j] = liw_new<LIWMem_Pool, BenchPooledObject>();
+		}
+		for (uint64_t j = 0; j < count; ++j) {
+			liw_delete<LIWMem_Pool, BenchPooledObject>(handles[j]);
+		}
+	}
+	return liw_bench_now_ns() - tBeg;
+}
+
+/*
+* Mixed small sizes (up to 256 bytes), against malloc. 
+*/
+static inline size_t bench_mixed_size(uint64_t i) { return 8 + (size_t)((i * 0x9E3779B97F4A7C15ull) >> 56); }
+
+uint64_t benchmark_memory_malloc_mixed(uint64_t countOps) {
+	void* ptrs[c_benchAllocBatch];
+	const uint64_t tBeg = liw_bench_now_ns();
+	for (uint64_t i = 0; i < countOps; i += c_benchAllocBatch) {
+		const uint64_t count = std::min(c_benchAllocBatch, countOps - i);
+		for (uint64_t j = 0; j < count; ++j) {
+			ptrs[j] = malloc(bench_mixed_size(i + j));
+			liw_bench_keep(ptrs[j]);
+		}
+		for (uint64_t j = 0; j < count; ++j) {
+			free(ptrs[j]);
+		}
+	}
+	return liw_bench_now_ns() - tBeg;
+}
+
+uint64_t benchmark_memory_slab_mixed(uint64_t countOps) {
+	bench_slab_allocator_type::GlobalSlabAllocator* globalAllocator = new bench_slab_allocator_type::GlobalSlabAllocator();
+	bench_slab_allocator_type::LocalSlabAllocator* localAllocator = new bench_slab_allocator_type::LocalSlabAllocator();
+	globalAllocator->Init();
+	localAllocator->Init(*globalAllocator);
+	void* ptrs[c_benchAllocBatch];
+	const uint64_t tBeg = liw_bench_now_ns();
+	for (uint64_t i = 0; i < countOps; i += c_benchAllocBatch) {
+		const uint64_t count = std::min(c_benchAllocBatch, countOps - i);
+		for (uint64_t j = 0; j < count; ++j) {
+			ptrs[j] = localAllocator->Allocate(bench_mixed_size(i + j));
+			liw_bench_keep(ptrs[j]);
+		}
+		for (uint64_t j = 0; j < count; ++j) {
+			localAllocator->Free(ptrs[j]);
+		}
+	}
+	const uint64_t tEnd = liw_bench_now_ns();
+	localAllocator->Cleanup();
+	globalAllocator->Cleanup();
+	delete localAllocator;
+	delete globalAllocator;
+	return tEnd - tBeg;
+}
+
+uint64_t benchmark_memory_gp(uint64_t countOps) {
+	bench_gp_allocator_type::GlobalGPAllocator* globalAllocator = new bench_gp_allocator_type::GlobalGPAllocator();
+	bench_gp_allocator_type::LocalGPAllocator* localAllocator = new bench_gp_allocator_type::LocalGPAllocator();
+	globalAllocator->Init();
+	localAllocator->Init(*globalAllocator);
+	liw_hdl_type handles[c_benchAllocBatch];
+	const uint64_t tBeg = liw_bench_now_ns();
+	for (uint64_t i = 0; i < countOps; i += c_benchAllocBatch) {
+		const uint64_t count = std::min(c_benchAllocBatch, countOps - i);
+		for (uint64_t j = 0; j < count; ++j) {
+			handles[j] = localAllocator->Allocate(c_benchAllocSize);
+		}
+		for (uint64_t j = 0; j < count; ++j) {
+			localAllocator->Free(handles[j]);
+		}
+		localAllocator->GC_P1(); // Segs are only marked by Free
+	}
+	const uint64_t tEnd = liw_bench_now_ns();
+	localAllocator->Cleanup();
+	globalAllocator->Cleanup();
+	delete localAllocator;
+	delete globalAllocator;
+	return tEnd - tBeg;
+}
+
+void benchmark_register_memory(LIWBenchmarkSuite& suite) {
+	suite.Add("memory/malloc_free", benchmark_memory_malloc, 1000000);
+	suite.Add("memory/stack_alloc_clear", benchmark_memory_stack, 1000000);
+	suite.Add("memory/pool_fetch_return", benchmark_memory_pool, 1000000);
+	suite.Add("memory/pool_init_1gb", benchmark_memory_pool_init_1gb, 100);
+	suite.Add("memory/object_pool_fetchn_returnn", benchmark_memory_object_pool_batch, 1000000);
+	suite.Add("memory/mem_pool_new_delete", benchmark_memory_mem_pool, 1000000);
+	suite.Add("memory/malloc_free_mixed", benchmark_memory_malloc_mixed, 1000000);
+	suite.Add("memory/slab_alloc_free_mixed", benchmark_memory_slab_mixed, 1000000);
+	suite.Add("memory/gp_alloc_free_gc", benchmark_memory_gp, 1000000);
+}
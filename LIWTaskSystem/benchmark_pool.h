@@ -0,0 +1,87 @@
+#pragma once
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include "LIWBenchmark.h"
+#include "LIWThreadPool.h"
+#include "LIWThreadPoolSized.h"
+
+using namespace LIW;
+using namespace LIW::Util;
+
+typedef LIWThreadPoolSized<1 << 16> bench_pool_sized_type;
+
+inline int benchmark_count_workers() {
+	return std::max(2, (int)std::thread::hardware_concurrency());
+}
+
+// Record the time it starts executing
+class BenchTask_Stamp : public LIWITask {
+public:
+	BenchTask_Stamp(std::atomic<uint64_t>* tExec) : m_tExec(tExec) {}
+	void Execute(void*) override { m_tExec->store(liw_bench_now_ns(), std::memory_order_release); }
+private:
+	std::atomic<uint64_t>* m_tExec;
+};
+
+// Count down a shared counter
+class BenchTask_CountDown : public LIWITask {
+public:
+	BenchTask_CountDown(std::atomic<uint64_t>* counter) : m_counter(counter) {}
+	void Execute(void*) override { m_counter->fetch_sub(1, std::memory_order_acq_rel); }
+private:
+	std::atomic<uint64_t>* m_counter;
+};
+
+/*
+* Submit one task at a time and wait for it to start. Measures submit-to-execute latency.
+*/
+template<class Pool>
+uint64_t benchmark_pool_submit_latency(uint64_t countOps) {
+	Pool* pool = new Pool();
+	pool->Init(benchmark_count_workers());
+	std::atomic<uint64_t> tExec{ 0 };
+	uint64_t nsTotal = 0;
+	for (uint64_t i = 0; i < countOps; ++i) {
+		tExec.store(0, std::memory_order_relaxed);
+		const uint64_t tSubmit = liw_bench_now_ns();
+		pool->Submit(new BenchTask_Stamp(&tExec));
+		uint64_t t;
+		while ((t = tExec.load(std::memory_order_acquire)) == 0) {
+			std::this_thread::yield();
+		}
+		nsTotal += t - tSubmit;
+	}
+	pool->WaitAndStop();
+	delete pool;
+	return nsTotal;
+}
+
+/*
+* Submit countOps tasks at once and wait for all of them to finish. Measures fork/join throughput.
+*/
+template<class Pool>
+uint64_t benchmark_pool_fanout(uint64_t countOps) {
+	Pool* pool = new Pool();
+	pool->Init(benchmark_count_workers());
+	std::atomic<uint64_t> counter{ countOps };
+	const uint64_t tBeg = liw_bench_now_ns();
+	for (uint64_t i = 0; i < countOps; ++i) {
+		pool->Submit(new BenchTask_CountDown(&counter));
+	}
+	while (counter.load(std::memory_order_acquire) != 0) {
+		std::this_thread::yield();
+	}
+	const uint64_t tEnd = liw_bench_now_ns();
+	pool->WaitAndStop();
+	delete pool;
+	return tEnd - tBeg;
+}
+
+void benchmark_register_pool(LIWBenchmarkSuite& suite) {
+	suite.Add("pool/submit_latency", benchmark_pool_submit_latency<LIWThreadPool>, 10000);
+	suite.Add("pool/fanout", benchmark_pool_fanout<LIWThreadPool>, 100000);
+	suite.Add("pool_sized/submit_latency", benchmark_pool_submit_latency<bench_pool_sized_type>, 10000);
+	suite.Add("pool_sized/fanout", benchmark_pool_fanout<bench_pool_sized_type>, 100000);
+}
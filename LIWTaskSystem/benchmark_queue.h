@@ -0,0 +1,81 @@
+#pragma once
+#include <thread>
+#include <vector>
+
+#include "LIWBenchmark.h"
+#include "LIWThreadSafeQueue.h"
+#include "LIWThreadSafeQueueSized.h"
+
+using namespace LIW;
+using namespace LIW::Util;
+
+typedef LIWThreadSafeQueueSized<uint64_t, 1024> bench_queue_sized_type;
+
+// Blocking push where available (sized queue blocks when full, size-free queue never does)
+inline void benchmark_queue_push(LIWThreadSafeQueue<uint64_t>& queue, uint64_t val) { queue.push_now(val); }
+inline void benchmark_queue_push(bench_queue_sized_type& queue, uint64_t val) { queue.push(val); }
+
+/*
+* Single thread push_now + pop_now pairs (uncontended lock cost).
+*/
+template<class Queue>
+uint64_t benchmark_queue_push_pop_now(uint64_t countOps) {
+	Queue* queue = new Queue();
+	uint64_t val = 0;
+	const uint64_t tBeg = liw_bench_now_ns();
+	for (uint64_t i = 0; i < countOps; ++i) {
+		queue->push_now(i);
+		queue->pop_now(val);
+	}
+	const uint64_t tEnd = liw_bench_now_ns();
+	liw_bench_keep(&val);
+	delete queue;
+	return tEnd - tBeg;
+}
+
+/*
+* Producers push and consumers pop (blocking) countOps values in total.
+*/
+template<class Queue>
+uint64_t benchmark_queue_mpmc(uint64_t countOps, int countProducers, int countConsumers) {
+	Queue* queue = new Queue();
+	std::vector<std::thread> threads;
+	const uint64_t tBeg = liw_bench_now_ns();
+	for (int i = 0; i < countProducers; ++i) {
+		const uint64_t countPush = countOps / countProducers + (i < (int)(countOps % countProducers) ? 1 : 0);
+		threads.emplace_back([queue, countPush]() {
+			for (uint64_t j = 0; j < countPush; ++j) {
+				benchmark_queue_push(*queue, j);
+			}
+		});
+	}
+	for (int i = 0; i < countConsumers; ++i) {
+		const uint64_t countPop = countOps / countConsumers + (i < (int)(countOps % countConsumers) ? 1 : 0);
+		threads.emplace_back([queue, countPop]() {
+			uint64_t val;
+			for (uint64_t j = 0; j < countPop; ++j) {
+				queue->pop(val);
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	const uint64_t tEnd = liw_bench_now_ns();
+	delete queue;
+	return tEnd - tBeg;
+}
+
+template<class Queue>
+uint64_t benchmark_queue_spsc(uint64_t countOps) { return benchmark_queue_mpmc<Queue>(countOps, 1, 1); }
+template<class Queue>
+uint64_t benchmark_queue_mpmc_4x4(uint64_t countOps) { return benchmark_queue_mpmc<Queue>(countOps, 4, 4); }
+
+void benchmark_register_queue(LIWBenchmarkSuite& suite) {
+	suite.Add("queue/push_pop_now", benchmark_queue_push_pop_now<LIWThreadSafeQueue<uint64_t>>, 1000000);
+	suite.Add("queue/spsc", benchmark_queue_spsc<LIWThreadSafeQueue<uint64_t>>, 1000000);
+	suite.Add("queue/mpmc_4x4", benchmark_queue_mpmc_4x4<LIWThreadSafeQueue<uint64_t>>, 1000000);
+	suite.Add("queue_sized/push_pop_now", benchmark_queue_push_pop_now<bench_queue_sized_type>, 1000000);
+	suite.Add("queue_sized/spsc", benchmark_queue_spsc<bench_queue_sized_type>, 1000000);
+	suite.Add("queue_sized/mpmc_4x4", benchmark_queue_mpmc_4x4<bench_queue_sized_type>, 1000000);
+}
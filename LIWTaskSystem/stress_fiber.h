@@ -0,0 +1,601 @@
+#pragma once
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <utility>
+
+#include "LIWStress.h"
+#include "LIWFiberThreadPool.h"
+#include "LIWFiberThreadPoolSized.h"
+#include "LIWFiberChannel.h"
+#include "LIWFiberScratchMemory.h"
+#include "LIWFiberMutex.h"
+#include "LIWFiberSemaphore.h"
+#include "LIWFiberConditionVariable.h"
+#include "stress_queue.h"
+
+using namespace LIW;
+using namespace LIW::Util;
+
+template<uint64_t TasksSize>
+using stress_fiber_pool_sized_type = LIWFiberThreadPoolSized<8, 8, TasksSize, 16>;
+
+// Init with random worker count, and at least minFibers fibers (for sized pools the fiber count is fixed to 8)
+inline void stress_fiber_pool_init(LIWFiberThreadPool& pool, LIWStressRandom& rng, int minFibers) {
+	pool.Init((int)rng.Range(1, 4), (int)rng.Range(minFibers, minFibers + 8));
+}
+template<uint64_t TasksSize>
+inline void stress_fiber_pool_init(stress_fiber_pool_sized_type<TasksSize>& pool, LIWStressRandom& rng, [[maybe_unused]] int minFibers) {
+	pool.Init((int)rng.Range(1, 4));
+}
+// Submit, retrying while the task queue is full (sized pools)
+template<class Pool>
+inline void stress_fiber_submit(Pool& pool, LIWFiberRunner runner, void* param, bool isInline = false, LIWFiberAffinity affinity = LIWFiberAffinity::None) {
+	LIWFiberTask* task = new LIWFiberTask{ runner, param };
+	task->m_isInline = isInline;
+	task->m_affinity = affinity;
+	while (!pool.Submit(task)) { std::this_thread::yield(); }
+}
+
+/*
+* Exactly-once execution of fiber tasks submitted by several threads.
+*/
+struct StressParam_Mark {
+	std::atomic<uint32_t>* m_slot;
+	uint64_t m_seed;
+};
+
+void StressFiberTask_Mark(LIWFiberWorker* thisFiber, void* param) {
+	StressParam_Mark* paramMark = reinterpret_cast<StressParam_Mark*>(param);
+	LIWStressRandom rng(paramMark->m_seed);
+	liw_stress_yield(rng);
+	paramMark->m_slot->fetch_add(1, std::memory_order_relaxed);
+	delete paramMark;
+}
+
+template<class Pool, uint64_t MaxPerSubmitter = 3000>
+bool stress_fiber_pool_exactly_once(LIWStressContext& ctx) {
+	LIWStressRandom& rng = ctx.GetRandom();
+	std::unique_ptr<Pool> pool(new Pool());
+	stress_fiber_pool_init(*pool, rng, 1);
+	const uint64_t countSubmitters = rng.Range(1, 3);
+	const uint64_t countPerSubmitter = rng.Range(1, MaxPerSubmitter);
+	std::vector<std::atomic<uint32_t>> slots(countSubmitters * countPerSubmitter);
+	for (auto& slot : slots) slot.store(0, std::memory_order_relaxed);
+
+	std::vector<std::thread> submitters;
+	for (uint64_t s = 0; s < countSubmitters; ++s) {
+		submitters.emplace_back([&, s](LIWStressRandom rngThread) {
+			for (uint64_t i = 0; i < countPerSubmitter; ++i) {
+				stress_fiber_submit(*pool, StressFiberTask_Mark, new StressParam_Mark{ &slots[s * countPerSubmitter + i], rngThread.Next() });
+				liw_stress_yield(rngThread);
+			}
+		}, rng.Fork());
+	}
+	for (auto& submitter : submitters) {
+		submitter.join();
+	}
+	pool->WaitAndStop(); // Must execute everything submitted before stopping
+
+	for (auto& slot : slots) {
+		LIW_STRESS_CHECK(ctx, slot.load(std::memory_order_relaxed) == 1);
+	}
+	return true;
+}
+
+/*
+* Sync counters: root tasks fork subtasks in rounds and wait on their own sync counter.
+* When a root is awaken, all subtasks of the round must have finished, and a pinned root must be back on the thread which started it.
+* Roots fill a scratch allocation of their fiber every round, which must be intact after each wait, whichever thread resumed it.
+*/
+template<class Pool>
+struct StressParam_ForkJoin {
+	LIWStressContext* m_ctx;
+	Pool* m_pool;
+	uint32_t m_idxCounter;
+	uint64_t m_seed;
+	bool m_isInline; // Run subtasks inline (on the worker thread)
+	LIWFiberAffinity m_affinity; // Affinity of the root
+	std::atomic<uint64_t> m_countDone{ 0 };
+	std::atomic<bool> m_isFinished{ false };
+};
+
+template<class Pool>
+void StressFiberTask_Join(LIWFiberWorker* thisFiber, void* param) {
+	StressParam_ForkJoin<Pool>* paramJoin = reinterpret_cast<StressParam_ForkJoin<Pool>*>(param);
+	LIW_STRESS_EXPECT(*paramJoin->m_ctx, (thisFiber == nullptr) == paramJoin->m_isInline);
+	paramJoin->m_countDone.fetch_add(1, std::memory_order_relaxed);
+	paramJoin->m_pool->DecreaseSyncCounter(paramJoin->m_idxCounter);
+}
+
+template<class Pool>
+void StressFiberTask_Fork(LIWFiberWorker* thisFiber, void* param) {
+	StressParam_ForkJoin<Pool>* paramJoin = reinterpret_cast<StressParam_ForkJoin<Pool>*>(param);
+	LIWStressRandom rng(paramJoin->m_seed);
+	const std::thread::id idThread = std::this_thread::get_id();
+	const uint64_t countRounds = rng.Range(1, 5);
+	uint64_t countExpected = 0;
+	LIW_STRESS_EXPECT(*paramJoin->m_ctx, thisFiber->GetScratch().GetSizeUsed() == 0); // Reset after the previous task
+	std::pair<uint8_t*, size_t> scratches[5];
+	for (uint64_t round = 0; round < countRounds; ++round) {
+		const size_t sizeScratch = (size_t)rng.Range(1, 2 * LIWFiberScratch::c_sizeDefault);
+		scratches[round] = std::make_pair((uint8_t*)liw_malloc_fiber(thisFiber, sizeScratch), sizeScratch);
+		memset(scratches[round].first, (int)round, sizeScratch);
+		const uint64_t countSub = rng.Range(1, 200);
+		countExpected += countSub;
+		paramJoin->m_pool->IncreaseSyncCounter(paramJoin->m_idxCounter, (int)countSub);
+		for (uint64_t i = 0; i < countSub; ++i) {
+			stress_fiber_submit(*paramJoin->m_pool, StressFiberTask_Join<Pool>, paramJoin, paramJoin->m_isInline);
+			liw_stress_yield(rng);
+		}
+		paramJoin->m_pool->WaitForSyncCounter(paramJoin->m_idxCounter, thisFiber);
+		LIW_STRESS_EXPECT(*paramJoin->m_ctx, paramJoin->m_affinity != LIWFiberAffinity::Pinned || std::this_thread::get_id() == idThread); // Resumed by the worker which started it
+		LIW_STRESS_EXPECT(*paramJoin->m_ctx, paramJoin->m_countDone.load(std::memory_order_relaxed) == countExpected);
+		LIW_STRESS_EXPECT(*paramJoin->m_ctx, paramJoin->m_pool->GetSyncCounter(paramJoin->m_idxCounter) == 0);
+		for (uint64_t roundScratch = 0; roundScratch <= round; ++roundScratch) {
+			for (size_t i = 0; i < scratches[roundScratch].second; i += 64) {
+				if (scratches[roundScratch].first[i] != (uint8_t)roundScratch) {
+					LIW_STRESS_EXPECT(*paramJoin->m_ctx, scratches[roundScratch].first[i] == (uint8_t)roundScratch);
+					break;
+				}
+			}
+		}
+	}
+	paramJoin->m_isFinished.store(true, std::memory_order_release);
+}
+
+template<class Pool>
+bool stress_fiber_pool_fork_join(LIWStressContext& ctx) {
+	LIWStressRandom& rng = ctx.GetRandom();
+	std::unique_ptr<Pool> pool(new Pool());
+	const uint64_t countRoots = rng.Range(1, 4);
+	stress_fiber_pool_init(*pool, rng, (int)countRoots + 1); // Roots hold fibers while waiting
+	std::vector<std::unique_ptr<StressParam_ForkJoin<Pool>>> params;
+	for (uint64_t r = 0; r < countRoots; ++r) {
+		params.emplace_back(new StressParam_ForkJoin<Pool>());
+		params.back()->m_ctx = &ctx;
+		params.back()->m_pool = pool.get();
+		params.back()->m_idxCounter = (uint32_t)r;
+		params.back()->m_seed = rng.Next();
+		params.back()->m_isInline = rng.Range(0, 1) == 1;
+		params.back()->m_affinity = (LIWFiberAffinity)rng.Range(0, 2);
+		stress_fiber_submit(*pool, StressFiberTask_Fork<Pool>, params.back().get(), false, params.back()->m_affinity);
+	}
+	for (auto& param : params) {
+		while (!param->m_isFinished.load(std::memory_order_acquire)) {
+			std::this_thread::yield();
+		}
+	}
+	pool->WaitAndStop();
+	return true;
+}
+
+/*
+* Fiber channel MPMC: producer and consumer fibers park on a channel with small capacity.
+*/
+struct StressParam_Channel {
+	LIWStressContext* m_ctx;
+	LIWFiberChannel<uint64_t>* m_channel;
+	StressValueChecker* m_checker;
+	std::atomic<uint64_t>* m_tickets;
+	std::atomic<uint64_t>* m_countFinished;
+	uint64_t m_countTotal;
+	uint64_t m_idxProducer;
+	uint64_t m_countPerProducer;
+	uint64_t m_seed;
+};
+
+void StressFiberTask_ChannelProducer(LIWFiberWorker* thisFiber, void* param) {
+	StressParam_Channel* paramChannel = reinterpret_cast<StressParam_Channel*>(param);
+	LIWStressRandom rng(paramChannel->m_seed);
+	for (uint64_t seq = 0; seq < paramChannel->m_countPerProducer; ++seq) {
+		LIW_STRESS_EXPECT(*paramChannel->m_ctx, paramChannel->m_channel->push(thisFiber, StressValueChecker::Encode(paramChannel->m_idxProducer, seq)));
+		liw_stress_yield(rng);
+	}
+	paramChannel->m_countFinished->fetch_add(1, std::memory_order_release);
+	delete paramChannel;
+}
+
+void StressFiberTask_ChannelConsumer(LIWFiberWorker* thisFiber, void* param) {
+	StressParam_Channel* paramChannel = reinterpret_cast<StressParam_Channel*>(param);
+	LIWStressRandom rng(paramChannel->m_seed);
+	std::vector<uint64_t> state = paramChannel->m_checker->MakeConsumerState();
+	while (paramChannel->m_tickets->fetch_add(1, std::memory_order_relaxed) < paramChannel->m_countTotal) { // A ticket guarantees a value to pop
+		uint64_t val = 0;
+		LIW_STRESS_EXPECT(*paramChannel->m_ctx, paramChannel->m_channel->pop(thisFiber, val));
+		paramChannel->m_checker->OnPop(*paramChannel->m_ctx, state, val);
+		liw_stress_yield(rng);
+	}
+	paramChannel->m_countFinished->fetch_add(1, std::memory_order_release);
+	delete paramChannel;
+}
+
+template<uint64_t Capacity>
+bool stress_fiber_channel_mpmc(LIWStressContext& ctx) {
+	LIWStressRandom& rng = ctx.GetRandom();
+	const uint64_t countProducers = rng.Range(1, 4);
+	const uint64_t countConsumers = rng.Range(1, 4);
+	const uint64_t countPerProducer = rng.Range(1, 2000);
+	const uint64_t countTotal = countProducers * countPerProducer;
+	LIWFiberChannel<uint64_t> channel(Capacity);
+	StressValueChecker checker(countProducers, countPerProducer);
+	std::atomic<uint64_t> tickets{ 0 };
+	std::atomic<uint64_t> countFinished{ 0 };
+
+	std::unique_ptr<LIWFiberThreadPool> pool(new LIWFiberThreadPool());
+	stress_fiber_pool_init(*pool, rng, (int)(countProducers + countConsumers)); // Parked producers/consumers hold fibers
+	for (uint64_t p = 0; p < countProducers; ++p) {
+		stress_fiber_submit(*pool, StressFiberTask_ChannelProducer,
+			new StressParam_Channel{ &ctx, &channel, &checker, &tickets, &countFinished, countTotal, p, countPerProducer, rng.Next() });
+	}
+	for (uint64_t c = 0; c < countConsumers; ++c) {
+		stress_fiber_submit(*pool, StressFiberTask_ChannelConsumer,
+			new StressParam_Channel{ &ctx, &channel, &checker, &tickets, &countFinished, countTotal, 0, 0, rng.Next() });
+	}
+	while (countFinished.load(std::memory_order_acquire) < countProducers + countConsumers) {
+		std::this_thread::yield();
+	}
+	pool->WaitAndStop();
+	LIW_STRESS_CHECK(ctx, channel.empty());
+	return checker.CheckExactlyOnce(ctx);
+}
+
+/*
+* Fiber mutex: tasks increment a plain counter under the mutex.
+*/
+struct StressParam_Mutex {
+	LIWFiberMutex* m_mtx;
+	uint64_t* m_counter;
+	uint64_t m_countIncrements;
+	std::atomic<uint64_t>* m_countFinished;
+	uint64_t m_seed;
+};
+
+void StressFiberTask_Mutex(LIWFiberWorker* thisFiber, void* param) {
+	StressParam_Mutex* paramMutex = reinterpret_cast<StressParam_Mutex*>(param);
+	LIWStressRandom rng(paramMutex->m_seed);
+	for (uint64_t i = 0; i < paramMutex->m_countIncrements; ++i) {
+		LIWFiberLockGuard lk(*paramMutex->m_mtx, thisFiber);
+		++*paramMutex->m_counter;
+		liw_stress_yield(rng);
+	}
+	paramMutex->m_countFinished->fetch_add(1, std::memory_order_release);
+	delete paramMutex;
+}
+
+bool stress_fiber_mutex(LIWStressContext& ctx) {
+	LIWStressRandom& rng = ctx.GetRandom();
+	const uint64_t countTasks = rng.Range(1, 8);
+	const uint64_t countIncrements = rng.Range(1, 500);
+	LIWFiberMutex mtx;
+	uint64_t counter = 0;
+	std::atomic<uint64_t> countFinished{ 0 };
+
+	std::unique_ptr<LIWFiberThreadPool> pool(new LIWFiberThreadPool());
+	stress_fiber_pool_init(*pool, rng, (int)countTasks); // Parked tasks hold fibers
+	for (uint64_t t = 0; t < countTasks; ++t) {
+		stress_fiber_submit(*pool, StressFiberTask_Mutex, new StressParam_Mutex{ &mtx, &counter, countIncrements, &countFinished, rng.Next() }, false, (LIWFiberAffinity)rng.Range(0, 2));
+	}
+	while (countFinished.load(std::memory_order_acquire) < countTasks) {
+		std::this_thread::yield();
+	}
+	pool->WaitAndStop();
+	LIW_STRESS_CHECK(ctx, counter == countTasks * countIncrements);
+	return true;
+}
+
+/*
+* Fiber semaphore: tasks in the section never outnumber the permits, and every acquire is matched by a release.
+*/
+struct StressParam_Semaphore {
+	LIWFiberSemaphore* m_sem;
+	std::atomic<int>* m_countInSection;
+	std::atomic<int>* m_countInSectionMax;
+	std::atomic<uint64_t>* m_countAcquired;
+	std::atomic<uint64_t>* m_countReleased;
+	uint64_t m_countRounds;
+	std::atomic<uint64_t>* m_countFinished;
+	uint64_t m_seed;
+};
+
+void StressFiberTask_Semaphore(LIWFiberWorker* thisFiber, void* param) {
+	StressParam_Semaphore* paramSem = reinterpret_cast<StressParam_Semaphore*>(param);
+	LIWStressRandom rng(paramSem->m_seed);
+	for (uint64_t round = 0; round < paramSem->m_countRounds; ++round) {
+		if (!rng.OneIn(4) || !paramSem->m_sem->try_acquire()) {
+			paramSem->m_sem->acquire(thisFiber);
+		}
+		paramSem->m_countAcquired->fetch_add(1, std::memory_order_relaxed);
+		const int countIn = paramSem->m_countInSection->fetch_add(1, std::memory_order_seq_cst) + 1;
+		int countInMax = paramSem->m_countInSectionMax->load(std::memory_order_relaxed);
+		while (countIn > countInMax && !paramSem->m_countInSectionMax->compare_exchange_weak(countInMax, countIn, std::memory_order_relaxed)) {}
+		liw_stress_yield(rng);
+		paramSem->m_countInSection->fetch_sub(1, std::memory_order_seq_cst);
+		paramSem->m_countReleased->fetch_add(1, std::memory_order_relaxed);
+		paramSem->m_sem->release();
+	}
+	paramSem->m_countFinished->fetch_add(1, std::memory_order_release);
+	delete paramSem;
+}
+
+bool stress_fiber_semaphore(LIWStressContext& ctx) {
+	LIWStressRandom& rng = ctx.GetRandom();
+	const int countPermits = (int)rng.Range(1, 4);
+	const uint64_t countTasks = rng.Range(1, 8);
+	const uint64_t countRounds = rng.Range(1, 500);
+	LIWFiberSemaphore sem(countPermits);
+	std::atomic<int> countInSection{ 0 };
+	std::atomic<int> countInSectionMax{ 0 };
+	std::atomic<uint64_t> countAcquired{ 0 };
+	std::atomic<uint64_t> countReleased{ 0 };
+	std::atomic<uint64_t> countFinished{ 0 };
+
+	std::unique_ptr<LIWFiberThreadPool> pool(new LIWFiberThreadPool());
+	stress_fiber_pool_init(*pool, rng, (int)countTasks); // Parked tasks hold fibers
+	for (uint64_t t = 0; t < countTasks; ++t) {
+		stress_fiber_submit(*pool, StressFiberTask_Semaphore, new StressParam_Semaphore{ &sem, &countInSection, &countInSectionMax, &countAcquired, &countReleased, countRounds, &countFinished, rng.Next() }, false, (LIWFiberAffinity)rng.Range(0, 2));
+	}
+	while (countFinished.load(std::memory_order_acquire) < countTasks) {
+		std::this_thread::yield();
+	}
+	pool->WaitAndStop();
+	LIW_STRESS_CHECK(ctx, countInSectionMax.load() <= countPermits);
+	LIW_STRESS_CHECK(ctx, countAcquired.load() == countTasks * countRounds);
+	LIW_STRESS_CHECK(ctx, countReleased.load() == countAcquired.load());
+	LIW_STRESS_CHECK(ctx, sem.GetCount() == countPermits);
+	return true;
+}
+
+/*
+* Fiber condition variable: every waiter wakes on one notify_all, and no wakeup is lost when each ticket is handed over with notify_one.
+*/
+struct StressState_ConditionVariable {
+	LIWFiberMutex m_mtx;
+	LIWFiberConditionVariable m_cv;
+	bool m_isGo = false; // Set once before notify_all (guarded by m_mtx)
+	uint64_t m_countTickets = 0; // Tickets handed over with notify_one (guarded by m_mtx)
+	std::atomic<uint64_t> m_countWaiting{ 0 }; // Waiters which have registered (incremented under m_mtx)
+	std::atomic<uint64_t> m_countFinished{ 0 };
+};
+struct StressParam_ConditionVariable {
+	StressState_ConditionVariable* m_state;
+	uint64_t m_seed;
+};
+
+void StressFiberTask_WaitAll(LIWFiberWorker* thisFiber, void* param) {
+	StressParam_ConditionVariable* paramCv = reinterpret_cast<StressParam_ConditionVariable*>(param);
+	StressState_ConditionVariable& state = *paramCv->m_state;
+	LIWFiberLockGuard lk(state.m_mtx, thisFiber);
+	state.m_countWaiting.fetch_add(1, std::memory_order_release);
+	state.m_cv.wait(thisFiber, state.m_mtx, [&state]() { return state.m_isGo; });
+	state.m_countFinished.fetch_add(1, std::memory_order_release);
+	delete paramCv;
+}
+
+void StressFiberTask_NotifyAll(LIWFiberWorker* thisFiber, void* param) {
+	StressParam_ConditionVariable* paramCv = reinterpret_cast<StressParam_ConditionVariable*>(param);
+	StressState_ConditionVariable& state = *paramCv->m_state;
+	{
+		LIWFiberLockGuard lk(state.m_mtx, thisFiber);
+		state.m_isGo = true;
+	}
+	state.m_cv.notify_all();
+	state.m_countFinished.fetch_add(1, std::memory_order_release);
+	delete paramCv;
+}
+
+void StressFiberTask_WaitOne(LIWFiberWorker* thisFiber, void* param) {
+	StressParam_ConditionVariable* paramCv = reinterpret_cast<StressParam_ConditionVariable*>(param);
+	StressState_ConditionVariable& state = *paramCv->m_state;
+	LIWStressRandom rng(paramCv->m_seed);
+	liw_stress_yield(rng);
+	{
+		LIWFiberLockGuard lk(state.m_mtx, thisFiber);
+		state.m_cv.wait(thisFiber, state.m_mtx, [&state]() { return state.m_countTickets > 0; });
+		--state.m_countTickets;
+	}
+	state.m_countFinished.fetch_add(1, std::memory_order_release);
+	delete paramCv;
+}
+
+void StressFiberTask_NotifyOne(LIWFiberWorker* thisFiber, void* param) {
+	StressParam_ConditionVariable* paramCv = reinterpret_cast<StressParam_ConditionVariable*>(param);
+	StressState_ConditionVariable& state = *paramCv->m_state;
+	LIWStressRandom rng(paramCv->m_seed);
+	liw_stress_yield(rng);
+	{
+		LIWFiberLockGuard lk(state.m_mtx, thisFiber);
+		++state.m_countTickets;
+	}
+	state.m_cv.notify_one();
+	state.m_countFinished.fetch_add(1, std::memory_order_release);
+	delete paramCv;
+}
+
+bool stress_fiber_condition_variable(LIWStressContext& ctx) {
+	LIWStressRandom& rng = ctx.GetRandom();
+	const uint64_t countWaiters = rng.Range(1, 8);
+	std::unique_ptr<LIWFiberThreadPool> pool(new LIWFiberThreadPool());
+	stress_fiber_pool_init(*pool, rng, (int)(2 * countWaiters)); // Parked tasks hold fibers
+
+	// notify_all: submitted once every waiter has registered, so it alone must wake them all
+	StressState_ConditionVariable stateAll;
+	for (uint64_t t = 0; t < countWaiters; ++t) {
+		stress_fiber_submit(*pool, StressFiberTask_WaitAll, new StressParam_ConditionVariable{ &stateAll, rng.Next() }, false, (LIWFiberAffinity)rng.Range(0, 2));
+	}
+	while (stateAll.m_countWaiting.load(std::memory_order_acquire) < countWaiters) {
+		std::this_thread::yield();
+	}
+	stress_fiber_submit(*pool, StressFiberTask_NotifyAll, new StressParam_ConditionVariable{ &stateAll, rng.Next() }, false, (LIWFiberAffinity)rng.Range(0, 2));
+	while (stateAll.m_countFinished.load(std::memory_order_acquire) < countWaiters + 1) {
+		std::this_thread::yield();
+	}
+
+	// notify_one: waiters and notifiers interleaved, one ticket per waiter
+	StressState_ConditionVariable stateOne;
+	uint64_t countWaitersSubmitted = 0;
+	uint64_t countNotifiersSubmitted = 0;
+	while (countWaitersSubmitted < countWaiters || countNotifiersSubmitted < countWaiters) {
+		const bool isWaiter = countNotifiersSubmitted == countWaiters || (countWaitersSubmitted < countWaiters && rng.OneIn(2));
+		stress_fiber_submit(*pool, isWaiter ? StressFiberTask_WaitOne : StressFiberTask_NotifyOne, new StressParam_ConditionVariable{ &stateOne, rng.Next() }, false, (LIWFiberAffinity)rng.Range(0, 2));
+		++(isWaiter ? countWaitersSubmitted : countNotifiersSubmitted);
+	}
+	while (stateOne.m_countFinished.load(std::memory_order_acquire) < 2 * countWaiters) {
+		std::this_thread::yield();
+	}
+	pool->WaitAndStop();
+	LIW_STRESS_CHECK(ctx, stateOne.m_countTickets == 0);
+	return true;
+}
+
+/*
+* Fiber stacks: pools honour the stack size, and (with stats) the peak covers the stack touched by tasks. 
+*/
+struct StressParam_Stack {
+	uint32_t m_depth;
+	std::atomic<uint64_t>* m_countFinished;
+};
+
+// Touch about 1KB of stack per level
+inline uint32_t stress_touch_stack(uint32_t depth) {
+	volatile char frame[1024];
+	for (size_t i = 0; i < sizeof(frame); i += 64) frame[i] = (char)depth;
+	return depth == 0 ? (uint32_t)frame[0] : stress_touch_stack(depth - 1) + (uint32_t)frame[64];
+}
+
+void StressFiberTask_Stack(LIWFiberWorker* thisFiber, void* param) {
+	StressParam_Stack* paramStack = reinterpret_cast<StressParam_Stack*>(param);
+	stress_touch_stack(paramStack->m_depth);
+	paramStack->m_countFinished->fetch_add(1, std::memory_order_release);
+	delete paramStack;
+}
+
+bool stress_fiber_stack(LIWStressContext& ctx) {
+	LIWStressRandom& rng = ctx.GetRandom();
+	const size_t stackSize = (size_t)rng.Range(64, 128) * 1024;
+	const uint32_t depth = (uint32_t)rng.Range(1, 32);
+	const uint64_t countTasks = rng.Range(1, 64);
+	std::atomic<uint64_t> countFinished{ 0 };
+
+	std::unique_ptr<LIWFiberThreadPool> pool(new LIWFiberThreadPool());
+	const int numWorkers = (int)rng.Range(1, 4);
+	const int numFibers = (int)rng.Range(1, 8);
+	pool->Init(numWorkers, numWorkers, numFibers, numFibers, stackSize);
+	for (uint64_t t = 0; t < countTasks; ++t) {
+		stress_fiber_submit(*pool, StressFiberTask_Stack, new StressParam_Stack{ depth, &countFinished });
+	}
+	pool->WaitAndStop();
+	LIW_STRESS_CHECK(ctx, countFinished.load(std::memory_order_acquire) == countTasks);
+
+	size_t peakMax = 0;
+	const std::vector<LIWFiberStackStats> stats = pool->GetFiberStackStats();
+	LIW_STRESS_CHECK(ctx, stats.size() == (size_t)numFibers);
+	for (auto& statsFiber : stats) {
+		LIW_STRESS_CHECK(ctx, statsFiber.m_size >= stackSize);
+		LIW_STRESS_CHECK(ctx, statsFiber.m_peak <= statsFiber.m_size);
+		peakMax = statsFiber.m_peak > peakMax ? statsFiber.m_peak : peakMax;
+	}
+#ifdef LIW_ENABLE_STATS
+	LIW_STRESS_CHECK(ctx, peakMax >= (size_t)depth * 1024);
+#endif
+	return true;
+}
+
+/*
+* Fiber stack classes: tasks run on fibers of the class they hint, or of the class one step up. Tasks hinting a class the pool has no fibers of are refused. 
+*/
+struct StressParam_StackClass {
+	const LIWFiberStackConfig* m_config;
+	size_t m_idxClass;
+	std::atomic<uint64_t>* m_countFinished;
+	std::atomic<uint64_t>* m_countWrongClass;
+};
+
+void StressFiberTask_StackClass(LIWFiberWorker* thisFiber, void* param) {
+	StressParam_StackClass* paramClass = reinterpret_cast<StressParam_StackClass*>(param);
+	size_t idxClassRan = 0; // Largest class whose size fits in the stack of this fiber
+	for (size_t idxClass = 0; idxClass < c_countFiberStackClasses; ++idxClass) {
+		if (paramClass->m_config->m_stackSizes[idxClass] <= thisFiber->GetStackSize()) {
+			idxClassRan = idxClass;
+		}
+	}
+	if (idxClassRan != paramClass->m_idxClass && idxClassRan != paramClass->m_idxClass + 1) {
+		paramClass->m_countWrongClass->fetch_add(1, std::memory_order_relaxed);
+	}
+	if (thisFiber->GetStackSize() >= paramClass->m_config->m_stackSizes[paramClass->m_idxClass]) {
+		stress_touch_stack((uint32_t)(paramClass->m_config->m_stackSizes[paramClass->m_idxClass] / 1024 / 2)); // Half of the stack, so a small fiber would overflow
+	}
+	paramClass->m_countFinished->fetch_add(1, std::memory_order_release);
+	delete paramClass;
+}
+
+template<class Pool>
+bool stress_fiber_stack_classes(LIWStressContext& ctx) {
+	LIWStressRandom& rng = ctx.GetRandom();
+	LIWFiberStackConfig config;
+	config.m_stackSizes[(size_t)LIWFiberStackClass::Small] = 32 * 1024;
+	config.m_stackSizes[(size_t)LIWFiberStackClass::Medium] = 64 * 1024;
+	config.m_stackSizes[(size_t)LIWFiberStackClass::Large] = 256 * 1024;
+	size_t idxClassesWithFibers[c_countFiberStackClasses];
+	size_t countClassesWithFibers = 0;
+	for (size_t idxClass = 0; idxClass < c_countFiberStackClasses; ++idxClass) {
+		config.m_numFibers[idxClass] = (int)rng.Range(0, 2);
+		if (config.m_numFibers[idxClass] > 0) {
+			idxClassesWithFibers[countClassesWithFibers++] = idxClass;
+		}
+	}
+	if (countClassesWithFibers == 0) { // No fibers at all
+		const size_t idxClass = (size_t)rng.Range(0, c_countFiberStackClasses - 1);
+		config.m_numFibers[idxClass] = 1;
+		idxClassesWithFibers[countClassesWithFibers++] = idxClass;
+	}
+	const uint64_t countTasks = rng.Range(1, 200);
+	std::atomic<uint64_t> countFinished{ 0 };
+	std::atomic<uint64_t> countWrongClass{ 0 };
+
+	std::unique_ptr<Pool> pool(new Pool());
+	const int numWorkers = (int)rng.Range(1, 4);
+	pool->Init(numWorkers, numWorkers, config);
+	for (size_t idxClass = 0; idxClass < c_countFiberStackClasses; ++idxClass) {
+		if (config.m_numFibers[idxClass] > 0) {
+			continue;
+		}
+		LIWFiberTask taskRefused{ StressFiberTask_StackClass, nullptr };
+		taskRefused.m_stackClass = (LIWFiberStackClass)idxClass;
+		LIW_STRESS_CHECK(ctx, !pool->Submit(&taskRefused));
+	}
+	for (uint64_t t = 0; t < countTasks; ++t) {
+		const size_t idxClass = idxClassesWithFibers[rng.Range(0, countClassesWithFibers - 1)];
+		LIWFiberTask* task = new LIWFiberTask{ StressFiberTask_StackClass, new StressParam_StackClass{ &config, idxClass, &countFinished, &countWrongClass } };
+		task->m_stackClass = (LIWFiberStackClass)idxClass;
+		while (!pool->Submit(task)) { std::this_thread::yield(); }
+	}
+	pool->WaitAndStop();
+	LIW_STRESS_CHECK(ctx, countFinished.load(std::memory_order_acquire) == countTasks);
+	LIW_STRESS_CHECK(ctx, countWrongClass.load(std::memory_order_relaxed) == 0);
+	for (auto& statsFiber : pool->GetFiberStackStats()) {
+		LIW_STRESS_CHECK(ctx, statsFiber.m_size >= config.m_stackSizes[statsFiber.m_stackClass]);
+	}
+	return true;
+}
+
+void stress_register_fiber(LIWStressSuite& suite) {
+	suite.Add("fiber_pool/exactly_once", stress_fiber_pool_exactly_once<LIWFiberThreadPool>);
+	suite.Add("fiber_pool/fork_join", stress_fiber_pool_fork_join<LIWFiberThreadPool>);
+	suite.Add("fiber_pool/stack", stress_fiber_stack);
+	suite.Add("fiber_pool/stack_classes", stress_fiber_stack_classes<LIWFiberThreadPool>);
+	// Tiny task queues make submitters contend with spinning workers. Keep the task count low.
+	suite.Add("fiber_pool_sized/exactly_once_cap1", stress_fiber_pool_exactly_once<stress_fiber_pool_sized_type<1>, 200>);
+	suite.Add("fiber_pool_sized/exactly_once_cap3", stress_fiber_pool_exactly_once<stress_fiber_pool_sized_type<3>, 200>);
+	suite.Add("fiber_pool_sized/exactly_once_cap1024", stress_fiber_pool_exactly_once<stress_fiber_pool_sized_type<1024>>);
+	suite.Add("fiber_pool_sized/fork_join", stress_fiber_pool_fork_join<stress_fiber_pool_sized_type<1024>>);
+	suite.Add("fiber_pool_sized/stack_classes", stress_fiber_stack_classes<stress_fiber_pool_sized_type<1024>>);
+	suite.Add("fiber_channel/mpmc_unbounded", stress_fiber_channel_mpmc<0>);
+	suite.Add("fiber_channel/mpmc_cap1", stress_fiber_channel_mpmc<1>);
+	suite.Add("fiber_channel/mpmc_cap3", stress_fiber_channel_mpmc<3>);
+	suite.Add("fiber_sync/mutex", stress_fiber_mutex);
+	suite.Add("fiber_sync/semaphore", stress_fiber_semaphore);
+	suite.Add("fiber_sync/condition_variable", stress_fiber_condition_variable);
+}
@@ -0,0 +1,18 @@
+/*
+* Entry of the stress test executable (built by CMake target "stress_test", run by ctest).
+* Run with --help for options. E.g.
+*	stress_test --filter queue_sized --iterations 1000 --seed 42
+*/
+#include "stress_queue.h"
+#include "stress_pool.h"
+#include "stress_fiber.h"
+#include "stress_memory.h"
+
+int main(int argc, char** argv) {
+	LIWStressSuite suite;
+	stress_register_queue(suite);
+	stress_register_pool(suite);
+	stress_register_fiber(suite);
+	stress_register_memory(suite);
+	return suite.Main(argc, argv);
+}
@@ -0,0 +1,791 @@
+#pragma once
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <functional>
+#include <tuple>
+
+#include "LIWStress.h"
+#include "LIWLGPoolAllocator.h"
+#include "LIWThreadSafeQueue.h"
+#include "LIWObjectPool.h"
+#include "LIWLGSlabAllocator.h"
+#include "LIWLGStackAllocator.h"
+#include "LIWMemory.h"
+
+using namespace LIW;
+using namespace LIW::Util;
+
+typedef LIWLGPoolAllocator<16, uint32_t, 8, 32> stress_pool_allocator_type;
+
+/*
+* Threads fetch, stamp and return global pool blocks concurrently. 
+* A block handed out twice gets its stamp overwritten; a lost block is missing when all blocks are drained at the end. 
+*/
+bool stress_pool_allocator_block_exchange(LIWStressContext& ctx) {
+	typedef stress_pool_allocator_type allocator_type;
+	LIWStressRandom& rng = ctx.GetRandom();
+	std::unique_ptr<allocator_type::GlobalPoolAllocator> allocator(new allocator_type::GlobalPoolAllocator());
+	allocator->Init();
+	const uint64_t countThreads = rng.Range(1, 6);
+	const uint64_t countHeldMax = allocator_type::c_countBlock / countThreads;
+	const uint64_t countRounds = rng.Range(100, 2000);
+
+	std::vector<std::thread> threads;
+	for (uint64_t t = 0; t < countThreads; ++t) {
+		threads.emplace_back([&, t](LIWStressRandom rngThread) {
+			std::vector<uint64_t*> held;
+			for (uint64_t round = 0; round < countRounds; ++round) {
+				const uint64_t stamp = (t << 32) | round;
+				const uint64_t countFetch = rngThread.Range(1, countHeldMax);
+				for (uint64_t i = 0; i < countFetch; ++i) {
+					uint64_t* const block = (uint64_t*)allocator->FetchBlock();
+					LIW_STRESS_EXPECT(ctx, block);
+					if (!block) break;
+					for (size_t idx = 0; idx < allocator_type::c_blockSize / sizeof(uint64_t); ++idx) block[idx] = stamp;
+					held.push_back(block);
+				}
+				liw_stress_yield(rngThread);
+				for (uint64_t* block : held) {
+					for (size_t idx = 0; idx < allocator_type::c_blockSize / sizeof(uint64_t); ++idx) LIW_STRESS_EXPECT(ctx, block[idx] == stamp);
+					allocator->ReturnBlock(block);
+				}
+				held.clear();
+			}
+		}, rng.Fork());
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	std::set<void*> blocks;
+	for (size_t i = 0; i < allocator_type::c_countBlock; ++i) {
+		blocks.insert(allocator->FetchBlock());
+	}
+	allocator->Cleanup();
+	LIW_STRESS_CHECK(ctx, blocks.size() == allocator_type::c_countBlock);
+	LIW_STRESS_CHECK(ctx, blocks.count(nullptr) == 0);
+	return true;
+}
+
+/*
+* Threads fetch and return elements through their own local allocators over one global allocator, 
+* so local allocators refill blocks concurrently. 
+*/
+bool stress_pool_allocator_local_refill(LIWStressContext& ctx) {
+	typedef stress_pool_allocator_type allocator_type;
+	LIWStressRandom& rng = ctx.GetRandom();
+	std::unique_ptr<allocator_type::GlobalPoolAllocator> allocator(new allocator_type::GlobalPoolAllocator());
+	allocator->Init();
+	const uint64_t countThreads = rng.Range(1, 4);
+	const uint64_t countHeldMax = allocator_type::c_countPerBlock * (allocator_type::c_countBlock / countThreads - 1);
+	const uint64_t countRounds = rng.Range(10, 200);
+
+	std::vector<std::thread> threads;
+	for (uint64_t t = 0; t < countThreads; ++t) {
+		threads.emplace_back([&, t](LIWStressRandom rngThread) {
+			allocator_type::LocalPoolAllocator local;
+			local.Init(*allocator);
+			std::vector<uint64_t*> held;
+			for (uint64_t round = 0; round < countRounds; ++round) {
+				const uint64_t stamp = (t << 32) | round;
+				const uint64_t countFetch = rngThread.Range(1, countHeldMax);
+				for (uint64_t i = 0; i < countFetch; ++i) {
+					uint64_t* const ptr = (uint64_t*)local.Fetch();
+					ptr[1] = stamp; // Keep clear of the link word
+					held.push_back(ptr);
+				}
+				liw_stress_yield(rngThread);
+				for (uint64_t* ptr : held) {
+					LIW_STRESS_EXPECT(ctx, ptr[1] == stamp);
+					local.Return(ptr);
+				}
+				held.clear();
+			}
+		}, rng.Fork());
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	allocator->Cleanup();
+	return true;
+}
+
+/*
+* Clearing the global allocator makes every block available again, whatever was fetched or returned before. 
+*/
+bool stress_pool_allocator_clear(LIWStressContext& ctx) {
+	typedef stress_pool_allocator_type allocator_type;
+	LIWStressRandom& rng = ctx.GetRandom();
+	std::unique_ptr<allocator_type::GlobalPoolAllocator> allocator(new allocator_type::GlobalPoolAllocator());
+	allocator->Init();
+	const uint64_t countClears = rng.Range(1, 10);
+	for (uint64_t c = 0; c < countClears; ++c) {
+		std::vector<void*> held;
+		const uint64_t countFetch = rng.Range(0, allocator_type::c_countBlock);
+		for (uint64_t i = 0; i < countFetch; ++i) {
+			held.push_back(allocator->FetchBlock());
+		}
+		for (void* block : held) {
+			if (rng.OneIn(2)) allocator->ReturnBlock(block);
+		}
+		allocator->Clear();
+		std::set<void*> blocks;
+		for (size_t i = 0; i < allocator_type::c_countBlock; ++i) {
+			blocks.insert(allocator->FetchBlock());
+		}
+		LIW_STRESS_CHECK(ctx, blocks.size() == allocator_type::c_countBlock);
+		LIW_STRESS_CHECK(ctx, blocks.count(nullptr) == 0);
+		allocator->Clear();
+	}
+	allocator->Cleanup();
+	return true;
+}
+
+/*
+* Threads fetch elements and pass them through a queue, so most elements are returned by a thread other than their owner. 
+* Every element must be handed out once at a time, and all blocks must be back in the global allocator after the owners reset. 
+*/
+bool stress_pool_allocator_remote_return(LIWStressContext& ctx) {
+	typedef LIWLGPoolAllocator<16, uint32_t, 16, 64> allocator_type;
+	LIWStressRandom& rng = ctx.GetRandom();
+	std::unique_ptr<allocator_type::GlobalPoolAllocator> allocator(new allocator_type::GlobalPoolAllocator());
+	allocator->Init();
+	char* const dataBuffer = (char*)allocator->FetchBlock(); // Block 0 (the first fetched) marks the start of the pool
+	allocator->ReturnBlock(dataBuffer);
+	const uint64_t countThreads = rng.Range(1, 4);
+	const uint64_t countRounds = rng.Range(100, 2000);
+	std::vector<allocator_type::LocalPoolAllocator> locals(countThreads);
+	for (auto& local : locals) local.Init(*allocator);
+	std::vector<std::atomic<uint8_t>> live(allocator_type::c_countPerPool);
+	for (auto& flag : live) flag.store(0, std::memory_order_relaxed);
+	auto idx_of = [&](void* ptr) { return ((char*)ptr - dataBuffer) / allocator_type::c_elementSize; };
+	LIWThreadSafeQueue<void*> exchange;
+
+	std::vector<std::thread> threads;
+	for (uint64_t t = 0; t < countThreads; ++t) {
+		threads.emplace_back([&, t](LIWStressRandom rngThread) {
+			allocator_type::LocalPoolAllocator& local = locals[t];
+			for (uint64_t round = 0; round < countRounds; ++round) {
+				const uint64_t count = rngThread.Range(1, 8);
+				for (uint64_t i = 0; i < count; ++i) {
+					void* const ptr = local.Fetch();
+					LIW_STRESS_EXPECT(ctx, live[idx_of(ptr)].exchange(1, std::memory_order_acq_rel) == 0);
+					exchange.push_now(ptr);
+				}
+				liw_stress_yield(rngThread);
+				void* ptr = nullptr;
+				for (uint64_t i = 0; i < count && exchange.pop_now(ptr); ++i) {
+					LIW_STRESS_EXPECT(ctx, live[idx_of(ptr)].exchange(0, std::memory_order_acq_rel) == 1);
+					local.Return(ptr);
+				}
+			}
+		}, rng.Fork());
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	void* ptr = nullptr;
+	while (exchange.pop_now(ptr)) {
+		LIW_STRESS_CHECK(ctx, live[idx_of(ptr)].exchange(0, std::memory_order_acq_rel) == 1);
+		locals[0].Return(ptr);
+	}
+
+	// Every element is returned. Resetting gives back every block but the new current ones. 
+	for (auto& local : locals) local.Reset();
+	std::set<void*> blocks;
+	for (size_t i = 0; i < allocator_type::c_countBlock - countThreads; ++i) {
+		blocks.insert(allocator->FetchBlock());
+	}
+	allocator->Cleanup();
+	LIW_STRESS_CHECK(ctx, blocks.size() == allocator_type::c_countBlock - countThreads);
+	LIW_STRESS_CHECK(ctx, blocks.count(nullptr) == 0);
+	return true;
+}
+
+/*
+* Object counting its live instances. Odd sized to exercise the element stride. 
+*/
+struct StressPooledObject {
+	StressPooledObject(uint64_t stamp) : m_stamp(stamp) { s_countLive.fetch_add(1, std::memory_order_relaxed); }
+	~StressPooledObject() { s_countLive.fetch_sub(1, std::memory_order_relaxed); }
+	uint64_t m_stamp;
+	char m_pad[13];
+	static std::atomic<int64_t> s_countLive;
+};
+std::atomic<int64_t> StressPooledObject::s_countLive{ 0 };
+
+/*
+* Threads fetch objects in batches from their own object pools and return them in batches on other threads. 
+* Every object must be constructed and destroyed once. 
+*/
+bool stress_pool_allocator_object_pool(LIWStressContext& ctx) {
+	typedef LIWObjectPool<StressPooledObject, 16, 256> pool_type;
+	static_assert(pool_type::c_elementSize % alignof(StressPooledObject) == 0, "Element stride must keep objects aligned");
+	LIWStressRandom& rng = ctx.GetRandom();
+	std::unique_ptr<pool_type::GlobalObjectPool> poolGlobal(new pool_type::GlobalObjectPool());
+	poolGlobal->Init();
+	const uint64_t countThreads = rng.Range(1, 4);
+	const uint64_t countRounds = rng.Range(100, 1000);
+	std::vector<pool_type::LocalObjectPool> pools(countThreads);
+	for (auto& pool : pools) pool.Init(*poolGlobal);
+	LIWThreadSafeQueue<std::vector<StressPooledObject*>> exchange;
+
+	std::vector<std::thread> threads;
+	for (uint64_t t = 0; t < countThreads; ++t) {
+		threads.emplace_back([&, t](LIWStressRandom rngThread) {
+			pool_type::LocalObjectPool& pool = pools[t];
+			for (uint64_t round = 0; round < countRounds; ++round) {
+				const uint64_t stamp = (t << 32) | round;
+				std::vector<StressPooledObject*> batch(rngThread.Range(1, 40));
+				pool.FetchN(batch.data(), batch.size(), stamp);
+				for (StressPooledObject* obj : batch) {
+					LIW_STRESS_EXPECT(ctx, ((uintptr_t)obj % alignof(StressPooledObject)) == 0);
+				}
+				exchange.push_now(std::move(batch));
+				liw_stress_yield(rngThread);
+				std::vector<StressPooledObject*> batchOther;
+				if (exchange.pop_now(batchOther)) {
+					const uint64_t stampOther = batchOther[0]->m_stamp;
+					for (StressPooledObject* obj : batchOther) {
+						LIW_STRESS_EXPECT(ctx, obj->m_stamp == stampOther);
+					}
+					if (rngThread.OneIn(2)) {
+						pool.ReturnN(batchOther.data(), batchOther.size());
+					}
+					else {
+						for (StressPooledObject* obj : batchOther) pool.Return(obj);
+					}
+				}
+			}
+		}, rng.Fork());
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	std::vector<StressPooledObject*> batch;
+	while (exchange.pop_now(batch)) {
+		pools[0].ReturnN(batch.data(), batch.size());
+	}
+	LIW_STRESS_CHECK(ctx, StressPooledObject::s_countLive.load() == 0);
+	for (auto& pool : pools) pool.Cleanup();
+	poolGlobal->Cleanup();
+	return true;
+}
+
+/*
+* liw_new/liw_delete in pool mode, with objects deleted on a thread other than the one that created them. 
+*/
+bool stress_pool_allocator_mem_pool(LIWStressContext& ctx) {
+	LIWStressRandom& rng = ctx.GetRandom();
+	const uint64_t countThreads = rng.Range(1, 4);
+	const uint64_t countRounds = rng.Range(100, 2000);
+	LIWThreadSafeQueue<liw_hdl_type> exchange;
+	std::atomic<uint64_t> countThreadsDone{ 0 };
+
+	std::vector<std::thread> threads;
+	for (uint64_t t = 0; t < countThreads; ++t) {
+		threads.emplace_back([&, t](LIWStressRandom rngThread) {
+			liw_minit_pool_thd();
+			for (uint64_t round = 0; round < countRounds; ++round) {
+				const uint64_t stamp = (t << 32) | round;
+				exchange.push_now(liw_new<LIWMem_Pool, StressPooledObject>(stamp));
+				liw_stress_yield(rngThread);
+				liw_hdl_type handle;
+				if (exchange.pop_now(handle)) {
+					LIW_STRESS_EXPECT(ctx, (((StressPooledObject*)liw_maddr<LIWMem_Pool>(handle))->m_stamp & 0xFFFFFFFF) < countRounds);
+					liw_delete<LIWMem_Pool, StressPooledObject>(handle);
+				}
+			}
+			// Objects of this thread may still be in the exchange. Keep the local pool until every thread is done. 
+			countThreadsDone.fetch_add(1);
+			liw_hdl_type handle;
+			while (countThreadsDone.load() < countThreads) {
+				if (exchange.pop_now(handle)) liw_delete<LIWMem_Pool, StressPooledObject>(handle);
+				else std::this_thread::yield();
+			}
+			while (exchange.pop_now(handle)) {
+				liw_delete<LIWMem_Pool, StressPooledObject>(handle);
+			}
+			liw_mclnup_pool_thd();
+		}, rng.Fork());
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	LIW_STRESS_CHECK(ctx, exchange.empty());
+	LIW_STRESS_CHECK(ctx, StressPooledObject::s_countLive.load() == 0);
+	return true;
+}
+
+/*
+* Pool mode over several runs (liw_mclnup_pool between them). 
+* Threads of a run may skip liw_mclnup_pool_thd, leaving a local pool of a freed run behind, which must be dropped on its next use. 
+*/
+bool stress_pool_allocator_mem_pool_rerun(LIWStressContext& ctx) {
+	LIWStressRandom& rng = ctx.GetRandom();
+	const uint64_t countRuns = rng.Range(2, 5);
+	for (uint64_t run = 0; run < countRuns; ++run) {
+		const uint64_t countObjects = rng.Range(1, 2000);
+		std::vector<liw_hdl_type> handles;
+		for (uint64_t i = 0; i < countObjects; ++i) { // On this thread, which keeps its thread locals over runs
+			handles.push_back(liw_new<LIWMem_Pool, StressPooledObject>(run));
+		}
+		std::thread worker([&](LIWStressRandom rngThread) {
+			for (uint64_t i = 0; i < countObjects; ++i) {
+				liw_hdl_type handle = liw_new<LIWMem_Pool, StressPooledObject>(run);
+				LIW_STRESS_EXPECT(ctx, ((StressPooledObject*)liw_maddr<LIWMem_Pool>(handle))->m_stamp == run);
+				liw_delete<LIWMem_Pool, StressPooledObject>(handle);
+				liw_stress_yield(rngThread);
+			}
+			liw_mclnup_pool_thd();
+		}, rng.Fork());
+		worker.join();
+		for (liw_hdl_type handle : handles) {
+			LIW_STRESS_CHECK(ctx, ((StressPooledObject*)liw_maddr<LIWMem_Pool>(handle))->m_stamp == run);
+			liw_delete<LIWMem_Pool, StressPooledObject>(handle);
+		}
+		if (rng.OneIn(2)) {
+			liw_mclnup_pool_thd();
+		}
+		liw_mclnup_pool();
+	}
+	liw_mclnup_pool_thd();
+	LIW_STRESS_CHECK(ctx, StressPooledObject::s_countLive.load() == 0);
+	return true;
+}
+
+/*
+* A thread which only deletes pool objects created on another thread returns them remotely, without a local pool (and its block) of its own. 
+*/
+bool stress_pool_allocator_mem_pool_free_only(LIWStressContext& ctx) {
+	LIWStressRandom& rng = ctx.GetRandom();
+	const uint64_t countObjects = rng.Range(1, 2000);
+	std::vector<liw_hdl_type> handles;
+	for (uint64_t i = 0; i < countObjects; ++i) {
+		handles.push_back(liw_new<LIWMem_Pool, StressPooledObject>(i));
+	}
+	std::thread worker([&](LIWStressRandom rngThread) {
+		for (liw_hdl_type handle : handles) {
+			liw_delete<LIWMem_Pool, StressPooledObject>(handle);
+			liw_stress_yield(rngThread);
+		}
+		LIW_STRESS_EXPECT(ctx, PoolMemBufferOf<StressPooledObject>::tl_poolGeneration == 0); // No local pool initialized
+		liw_mclnup_pool_thd();
+	}, rng.Fork());
+	worker.join();
+	LIW_STRESS_CHECK(ctx, StressPooledObject::s_countLive.load() == 0);
+	for (auto& handle : handles) { // Served again from the blocks of this thread, drained of the remote returns
+		handle = liw_new<LIWMem_Pool, StressPooledObject>(countObjects);
+	}
+	for (liw_hdl_type handle : handles) {
+		LIW_STRESS_CHECK(ctx, ((StressPooledObject*)liw_maddr<LIWMem_Pool>(handle))->m_stamp == countObjects);
+		liw_delete<LIWMem_Pool, StressPooledObject>(handle);
+	}
+	liw_mclnup_pool_thd();
+	liw_mclnup_pool();
+	LIW_STRESS_CHECK(ctx, StressPooledObject::s_countLive.load() == 0);
+	return true;
+}
+
+typedef LIWLGSlabAllocator<8 * 1024, 64> stress_slab_allocator_type;
+
+/*
+* Every size maps to the smallest class holding it. 
+*/
+bool stress_slab_allocator_classes(LIWStressContext& ctx) {
+	typedef stress_slab_allocator_type allocator_type;
+	for (size_t size = 1; size <= allocator_type::c_sizeMax; ++size) {
+		const size_t idxClass = allocator_type::GetClass(size);
+		LIW_STRESS_CHECK(ctx, idxClass < allocator_type::c_countClasses);
+		LIW_STRESS_CHECK(ctx, allocator_type::GetClassSize(idxClass) >= size);
+		LIW_STRESS_CHECK(ctx, idxClass == 0 || allocator_type::GetClassSize(idxClass - 1) < size);
+		LIW_STRESS_CHECK(ctx, allocator_type::GetClassSize(idxClass) % 16 == 0);
+	}
+	return true;
+}
+
+/*
+* Threads allocate random sizes (some above the largest class), fill them and pass them through a queue to be checked and freed by any thread. 
+*/
+bool stress_slab_allocator_exchange(LIWStressContext& ctx) {
+	typedef stress_slab_allocator_type allocator_type;
+	LIWStressRandom& rng = ctx.GetRandom();
+	std::unique_ptr<allocator_type::GlobalSlabAllocator> allocator(new allocator_type::GlobalSlabAllocator());
+	allocator->Init();
+	const uint64_t countThreads = rng.Range(1, 4);
+	const uint64_t countRounds = rng.Range(100, 1000);
+	std::vector<allocator_type::LocalSlabAllocator> locals(countThreads);
+	for (auto& local : locals) local.Init(*allocator);
+	LIWThreadSafeQueue<std::pair<uint8_t*, size_t>> exchange;
+
+	std::vector<std::thread> threads;
+	for (uint64_t t = 0; t < countThreads; ++t) {
+		threads.emplace_back([&, t](LIWStressRandom rngThread) {
+			allocator_type::LocalSlabAllocator& local = locals[t];
+			for (uint64_t round = 0; round < countRounds; ++round) {
+				const size_t size = rngThread.OneIn(16) ? (size_t)rngThread.Range(1, 2 * allocator_type::c_sizeMax) : (size_t)rngThread.Range(1, 256);
+				uint8_t* const ptr = (uint8_t*)local.Allocate(size);
+				LIW_STRESS_EXPECT(ctx, ((uintptr_t)ptr & 15) == 0);
+				memset(ptr, (int)(size & 0xFF), size);
+				exchange.push_now(std::make_pair(ptr, size));
+				liw_stress_yield(rngThread);
+				std::pair<uint8_t*, size_t> other;
+				if (exchange.pop_now(other)) {
+					for (size_t idx = 0; idx < other.second; ++idx) {
+						if (other.first[idx] != (uint8_t)(other.second & 0xFF)) {
+							LIW_STRESS_EXPECT(ctx, false);
+							break;
+						}
+					}
+					local.Free(other.first);
+				}
+			}
+		}, rng.Fork());
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	std::pair<uint8_t*, size_t> other;
+	while (exchange.pop_now(other)) {
+		locals[0].Free(other.first);
+	}
+	for (auto& local : locals) local.Cleanup();
+	allocator->Cleanup();
+	return true;
+}
+
+/*
+* Threads with more local allocators than a class has blocks only free what one producer allocated. 
+* Freeing must not make a local allocator take blocks, so the producer can still allocate everything again. 
+*/
+bool stress_slab_allocator_free_only(LIWStressContext& ctx) {
+	typedef stress_slab_allocator_type allocator_type;
+	LIWStressRandom& rng = ctx.GetRandom();
+	std::unique_ptr<allocator_type::GlobalSlabAllocator> allocator(new allocator_type::GlobalSlabAllocator());
+	allocator->Init();
+	const uint64_t countThreads = rng.Range(1, 4);
+	const uint64_t countPerThread = allocator_type::c_countBlock / countThreads + rng.Range(1, 16); // Locals of all threads outnumber the blocks of a class
+	const size_t size = (size_t)rng.Range(1, 256);
+	allocator_type::LocalSlabAllocator producer;
+	producer.Init(*allocator);
+	std::vector<void*> ptrs(countThreads * countPerThread);
+	for (auto& ptr : ptrs) {
+		ptr = producer.Allocate(size);
+		LIW_STRESS_CHECK(ctx, ptr);
+	}
+
+	std::atomic<uint64_t> countThreadsDone{ 0 };
+	std::vector<std::thread> threads;
+	for (uint64_t t = 0; t < countThreads; ++t) {
+		threads.emplace_back([&, t](LIWStressRandom rngThread) {
+			std::vector<allocator_type::LocalSlabAllocator> locals(countPerThread);
+			for (uint64_t i = 0; i < countPerThread; ++i) {
+				locals[i].Init(*allocator);
+				locals[i].Free(ptrs[t * countPerThread + i]);
+				liw_stress_yield(rngThread);
+			}
+			countThreadsDone.fetch_add(1);
+			while (countThreadsDone.load() < countThreads) { // Keep the locals until every thread is done, as blocks they held would go back on cleanup
+				std::this_thread::yield();
+			}
+			for (auto& local : locals) local.Cleanup();
+		}, rng.Fork());
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	for (auto& ptr : ptrs) { // Served from the producer's blocks, drained of the remote frees
+		ptr = producer.Allocate(size);
+		LIW_STRESS_CHECK(ctx, ptr);
+	}
+	for (auto ptr : ptrs) producer.Free(ptr);
+	producer.Cleanup();
+	allocator->Cleanup();
+	return true;
+}
+
+typedef LIWLGStackAllocator<64 * 1024, 1024> stress_stack_allocator_type;
+
+/*
+* Threads take blocks from a small global stack allocator until it runs out. 
+* Without overflow chaining, requests past the buffer must fail and nothing handed out may leave the buffer or overlap. 
+* With it, every request must be served, and the overflow counter must match the failures it replaced. 
+*/
+bool stress_stack_allocator_bounded(LIWStressContext& ctx) {
+	typedef stress_stack_allocator_type allocator_type;
+	LIWStressRandom& rng = ctx.GetRandom();
+	std::unique_ptr<allocator_type::GlobalStackAllocator> allocator(new allocator_type::GlobalStackAllocator());
+	const bool isOverflowChained = rng.OneIn(2);
+	allocator->Init(isOverflowChained);
+	const uint64_t countThreads = rng.Range(1, 4);
+	const uint64_t countFrames = rng.Range(1, 5);
+
+	for (uint64_t frame = 0; frame < countFrames; ++frame) {
+		const uint64_t countRequests = rng.Range(10, 100);
+		const uint64_t countOverflowsBeg = allocator->GetCountOverflows();
+		std::mutex mtxRanges;
+		std::vector<std::pair<char*, size_t>> ranges;
+		std::atomic<uint64_t> countFailed{ 0 };
+		std::vector<std::thread> threads;
+		for (uint64_t t = 0; t < countThreads; ++t) {
+			threads.emplace_back([&](LIWStressRandom rngThread) {
+				for (uint64_t i = 0; i < countRequests; ++i) {
+					const size_t count = (size_t)rngThread.Range(1, 4);
+					char* const ptr = (char*)allocator->AllocateBlocks(count);
+					if (!ptr) {
+						countFailed.fetch_add(1);
+						continue;
+					}
+					memset(ptr, 0xAB, count * allocator_type::c_blockSize); // Must be writable
+					std::lock_guard<std::mutex> lk(mtxRanges);
+					ranges.emplace_back(ptr, count * allocator_type::c_blockSize);
+					liw_stress_yield(rngThread);
+				}
+			}, rng.Fork());
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+
+		const uint64_t countOverflows = allocator->GetCountOverflows() - countOverflowsBeg;
+		if (isOverflowChained) {
+			LIW_STRESS_CHECK(ctx, countFailed.load() == 0);
+		}
+		else {
+			LIW_STRESS_CHECK(ctx, countFailed.load() == countOverflows);
+		}
+		std::sort(ranges.begin(), ranges.end());
+		size_t sizeInBuffer = 0;
+		for (size_t i = 0; i < ranges.size(); ++i) {
+			LIW_STRESS_CHECK(ctx, i == 0 || ranges[i - 1].first + ranges[i - 1].second <= ranges[i].first);
+			sizeInBuffer += ranges[i].second;
+		}
+		LIW_STRESS_CHECK(ctx, isOverflowChained || sizeInBuffer <= allocator_type::c_totalSize);
+		allocator->Clear();
+	}
+	allocator->Cleanup();
+	return true;
+}
+
+/*
+* Locals allocate random sizes and alignments, some over half a block. 
+* Allocations must be aligned and disjoint, and the stats must account for the blocks taken, less the unused tail of the current block. 
+*/
+bool stress_stack_allocator_local_alloc(LIWStressContext& ctx) {
+	typedef stress_stack_allocator_type allocator_type;
+	LIWStressRandom& rng = ctx.GetRandom();
+	std::unique_ptr<allocator_type::GlobalStackAllocator> allocator(new allocator_type::GlobalStackAllocator());
+	allocator->Init(true);
+	const uint64_t countThreads = rng.Range(1, 4);
+	const uint64_t countRequests = rng.Range(10, 200);
+
+	std::mutex mtxRanges;
+	std::vector<std::pair<char*, size_t>> ranges;
+	std::vector<std::thread> threads;
+	for (uint64_t t = 0; t < countThreads; ++t) {
+		threads.emplace_back([&](LIWStressRandom rngThread) {
+			allocator_type::LocalStackAllocator local;
+			local.Init(*allocator);
+			for (uint64_t i = 0; i < countRequests; ++i) {
+				const size_t size = rngThread.OneIn(8) ? (size_t)rngThread.Range(allocator_type::c_blockSize / 2, allocator_type::c_blockSize * 3) : (size_t)rngThread.Range(1, 128);
+				const size_t align = size_t(1) << rngThread.Range(0, 7);
+				char* const ptr = (char*)local.Allocate(size, align);
+				LIW_STRESS_EXPECT(ctx, ptr);
+				if (!ptr) {
+					continue;
+				}
+				LIW_STRESS_EXPECT(ctx, (uintptr_t)ptr % align == 0);
+				memset(ptr, 0xAB, size); // Must be writable
+				std::lock_guard<std::mutex> lk(mtxRanges);
+				ranges.emplace_back(ptr, size);
+				liw_stress_yield(rngThread);
+			}
+			const LIWStackAllocatorStats stats = local.GetStats();
+			LIW_STRESS_EXPECT(ctx, stats.m_sizeAllocated + stats.m_sizePadding + stats.m_sizeWaste <= stats.m_countBlocks * allocator_type::c_blockSize);
+			LIW_STRESS_EXPECT(ctx, stats.m_sizeAllocated + stats.m_sizePadding + stats.m_sizeWaste + 2 * allocator_type::c_blockSize > stats.m_countBlocks * allocator_type::c_blockSize); // Only the tail of the current block is unaccounted
+		}, rng.Fork());
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	std::sort(ranges.begin(), ranges.end());
+	for (size_t i = 1; i < ranges.size(); ++i) {
+		LIW_STRESS_CHECK(ctx, ranges[i - 1].first + ranges[i - 1].second <= ranges[i].first);
+	}
+	allocator->Cleanup();
+	return true;
+}
+
+/*
+* Locals allocate inside randomly nested scopes, filling each allocation with the depth of its scope. 
+* On leaving a scope, allocations of the enclosing scopes must be intact, and the space freed must be handed out again. 
+*/
+bool stress_stack_allocator_markers(LIWStressContext& ctx) {
+	typedef stress_stack_allocator_type allocator_type;
+	LIWStressRandom& rng = ctx.GetRandom();
+	std::unique_ptr<allocator_type::GlobalStackAllocator> allocator(new allocator_type::GlobalStackAllocator());
+	allocator->Init(true);
+	const uint64_t countThreads = rng.Range(1, 4);
+	const uint64_t countScopes = rng.Range(10, 100);
+
+	std::vector<std::thread> threads;
+	for (uint64_t t = 0; t < countThreads; ++t) {
+		threads.emplace_back([&](LIWStressRandom rngThread) {
+			allocator_type::LocalStackAllocator local;
+			local.Init(*allocator);
+			std::vector<std::pair<uint8_t*, size_t>> live; // Allocations of the enclosing scopes
+			std::function<void(uint8_t)> runScope = [&](uint8_t depth) {
+				LIWStackScope<allocator_type::LocalStackAllocator> scope(local);
+				const LIWStackMarker marker = local.GetMarker();
+				const size_t countLiveBeg = live.size();
+				const uint64_t countAllocs = rngThread.Range(0, 8);
+				for (uint64_t i = 0; i < countAllocs; ++i) {
+					const size_t size = rngThread.OneIn(16) ? (size_t)rngThread.Range(allocator_type::c_blockSize / 2, allocator_type::c_blockSize * 2) : (size_t)rngThread.Range(1, 256);
+					uint8_t* const ptr = (uint8_t*)local.Allocate(size);
+					LIW_STRESS_EXPECT(ctx, ptr);
+					if (!ptr) {
+						continue;
+					}
+					memset(ptr, depth, size);
+					live.emplace_back(ptr, size);
+					if (depth < 8 && rngThread.OneIn(3)) {
+						runScope(depth + 1);
+					}
+				}
+				if (rngThread.OneIn(2)) { // Roll back explicitly before the scope does
+					local.FreeToMarker(marker);
+					if (local.GetMarker().m_ptrBeg == marker.m_ptrBeg) {
+						LIW_STRESS_EXPECT(ctx, local.GetMarker().m_ptrTop == marker.m_ptrTop);
+					}
+				}
+				for (size_t i = 0; i < live.size(); ++i) {
+					const uint8_t depthLive = i < countLiveBeg ? live[i].first[0] : depth;
+					for (size_t j = 0; j < live[i].second; ++j) {
+						if (live[i].first[j] != depthLive) {
+							LIW_STRESS_EXPECT(ctx, live[i].first[j] == depthLive);
+							break;
+						}
+					}
+				}
+				live.resize(countLiveBeg);
+				liw_stress_yield(rngThread);
+			};
+			for (uint64_t i = 0; i < countScopes; ++i) {
+				const LIWStackMarker marker = local.GetMarker();
+				runScope(0);
+				if (local.GetMarker().m_ptrBeg == marker.m_ptrBeg) { // Scopes must hand their space back
+					LIW_STRESS_EXPECT(ctx, local.GetMarker().m_ptrTop == marker.m_ptrTop);
+				}
+			}
+		}, rng.Fork());
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	allocator->Cleanup();
+	return true;
+}
+
+/*
+* Threads allocate from N-buffered stack allocators (as liw_malloc_dframe), while another thread rolls the frame epoch over (as liw_mupdate_dframe). 
+* The updater waits for every thread to allocate a few times in a frame before the next update, like a frame end. 
+* Each allocation is filled with its own byte, and must stay intact for N - 1 more frames. Locals must take new blocks after their buffer is cleared, instead of bumping their stale block. 
+*/
+bool stress_stack_allocator_frame_rollover(LIWStressContext& ctx) {
+	typedef stress_stack_allocator_type allocator_type;
+	const size_t c_countBuffers = 3;
+	LIWStressRandom& rng = ctx.GetRandom();
+	std::unique_ptr<allocator_type::GlobalStackAllocator[]> allocators(new allocator_type::GlobalStackAllocator[c_countBuffers]);
+	for (size_t idx = 0; idx < c_countBuffers; ++idx) {
+		allocators[idx].Init(true);
+	}
+	const uint64_t countThreads = rng.Range(1, 4);
+	const uint64_t countFrames = rng.Range(5, 30);
+	std::atomic<uint64_t> epoch{ 0 };
+	std::atomic<bool> isDone{ false };
+	std::unique_ptr<std::atomic<uint64_t>[]> epochsSeen(new std::atomic<uint64_t>[countThreads]);
+	for (uint64_t t = 0; t < countThreads; ++t) epochsSeen[t].store(0);
+
+	std::vector<std::thread> threads;
+	for (uint64_t t = 0; t < countThreads; ++t) {
+		threads.emplace_back([&, t](LIWStressRandom rngThread) {
+			allocator_type::LocalStackAllocator locals[c_countBuffers];
+			for (size_t idx = 0; idx < c_countBuffers; ++idx) {
+				locals[idx].Init(allocators[idx]);
+			}
+			std::vector<std::tuple<uint8_t*, size_t, uint64_t, uint8_t>> live; // Allocation, size, frame, fill
+			uint8_t fill = (uint8_t)(t * 64);
+			const uint64_t countPerFrame = rngThread.Range(1, 64); // Allocations before the frame is reported seen
+			uint64_t epochLast = 0;
+			uint64_t countInFrame = 0;
+			while (!isDone.load(std::memory_order_acquire)) {
+				const uint64_t epochNow = epoch.load(std::memory_order_acquire);
+				const size_t size = (size_t)rngThread.Range(1, allocator_type::c_blockSize / 4);
+				uint8_t* const ptr = (uint8_t*)locals[epochNow % c_countBuffers].Allocate(size);
+				LIW_STRESS_EXPECT(ctx, ptr);
+				if (ptr) {
+					memset(ptr, ++fill, size);
+					live.emplace_back(ptr, size, epochNow, fill);
+				}
+				// Allocations of the frames before the one seen last are safe from updates in flight
+				live.erase(std::remove_if(live.begin(), live.end(), [&](const std::tuple<uint8_t*, size_t, uint64_t, uint8_t>& alloc) {
+					return std::get<2>(alloc) + c_countBuffers - 1 <= epochNow;
+				}), live.end());
+				for (const auto& alloc : live) {
+					const uint8_t* const bytes = std::get<0>(alloc);
+					if (bytes[0] != std::get<3>(alloc) || bytes[std::get<1>(alloc) - 1] != std::get<3>(alloc)) {
+						LIW_STRESS_EXPECT(ctx, bytes[0] == std::get<3>(alloc) && bytes[std::get<1>(alloc) - 1] == std::get<3>(alloc));
+						break;
+					}
+				}
+				countInFrame = epochNow == epochLast ? countInFrame + 1 : 1;
+				epochLast = epochNow;
+				if (countInFrame >= countPerFrame) {
+					epochsSeen[t].store(epochNow, std::memory_order_release);
+				}
+				liw_stress_yield(rngThread);
+			}
+		}, rng.Fork());
+	}
+	for (uint64_t frame = 1; frame <= countFrames; ++frame) {
+		for (uint64_t t = 0; t < countThreads; ++t) { // Frame end: wait for every thread to have allocated in the current frame
+			while (epochsSeen[t].load(std::memory_order_acquire) != frame - 1) {
+				std::this_thread::yield();
+			}
+		}
+		allocators[frame % c_countBuffers].Clear();
+		epoch.store(frame, std::memory_order_release);
+	}
+	isDone.store(true, std::memory_order_release);
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	for (size_t idx = 0; idx < c_countBuffers; ++idx) {
+		allocators[idx].Cleanup();
+	}
+	return true;
+}
+
+void stress_register_memory(LIWStressSuite& suite) {
+	suite.Add("pool_allocator/block_exchange", stress_pool_allocator_block_exchange);
+	suite.Add("pool_allocator/local_refill", stress_pool_allocator_local_refill);
+	suite.Add("pool_allocator/clear", stress_pool_allocator_clear);
+	suite.Add("pool_allocator/remote_return", stress_pool_allocator_remote_return);
+	suite.Add("pool_allocator/object_pool", stress_pool_allocator_object_pool);
+	suite.Add("pool_allocator/mem_pool", stress_pool_allocator_mem_pool);
+	suite.Add("pool_allocator/mem_pool_rerun", stress_pool_allocator_mem_pool_rerun);
+	suite.Add("pool_allocator/mem_pool_free_only", stress_pool_allocator_mem_pool_free_only);
+	suite.Add("slab_allocator/classes", stress_slab_allocator_classes);
+	suite.Add("slab_allocator/exchange", stress_slab_allocator_exchange);
+	suite.Add("slab_allocator/free_only", stress_slab_allocator_free_only);
+	suite.Add("stack_allocator/bounded", stress_stack_allocator_bounded);
+	suite.Add("stack_allocator/local_alloc", stress_stack_allocator_local_alloc);
+	suite.Add("stack_allocator/markers", stress_stack_allocator_markers);
+	suite.Add("stack_allocator/frame_rollover", stress_stack_allocator_frame_rollover);
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <memory>
+
+#include "LIWStress.h"
+#include "LIWThreadPool.h"
+#include "LIWThreadPoolSized.h"
+
+using namespace LIW;
+using namespace LIW::Util;
+
+/*
+* Exactly-once execution: several threads submit tasks, each task marks its own slot.
+* After WaitAndStop, every slot must have been marked exactly once.
+*/
+class StressTask_Mark : public LIWITask {
+public:
+	StressTask_Mark(std::atomic<uint32_t>* slot, uint64_t seed) : m_slot(slot), m_rng(seed) {}
+	void Execute(void*) override {
+		liw_stress_yield(m_rng);
+		m_slot->fetch_add(1, std::memory_order_relaxed);
+	}
+private:
+	std::atomic<uint32_t>* m_slot;
+	LIWStressRandom m_rng;
+};
+
+template<class Pool>
+bool stress_pool_exactly_once(LIWStressContext& ctx) {
+	LIWStressRandom& rng = ctx.GetRandom();
+	std::unique_ptr<Pool> pool(new Pool());
+	pool->Init((int)rng.Range(1, 6));
+	const uint64_t countSubmitters = rng.Range(1, 3);
+	const uint64_t countPerSubmitter = rng.Range(1, 3000);
+	std::vector<std::atomic<uint32_t>> slots(countSubmitters * countPerSubmitter);
+	for (auto& slot : slots) slot.store(0, std::memory_order_relaxed);
+
+	std::vector<std::thread> submitters;
+	for (uint64_t s = 0; s < countSubmitters; ++s) {
+		submitters.emplace_back([&, s](LIWStressRandom rngThread) {
+			for (uint64_t i = 0; i < countPerSubmitter; ++i) {
+				LIW_STRESS_EXPECT(ctx, pool->Submit(new StressTask_Mark(&slots[s * countPerSubmitter + i], rngThread.Next())));
+				liw_stress_yield(rngThread);
+			}
+		}, rng.Fork());
+	}
+	for (auto& submitter : submitters) {
+		submitter.join();
+	}
+	pool->WaitAndStop(); // Must execute everything submitted before stopping
+
+	for (auto& slot : slots) {
+		LIW_STRESS_CHECK(ctx, slot.load(std::memory_order_relaxed) == 1);
+	}
+	return true;
+}
+
+void stress_register_pool(LIWStressSuite& suite) {
+	suite.Add("thread_pool/exactly_once", stress_pool_exactly_once<LIWThreadPool>);
+	suite.Add("thread_pool_sized/exactly_once_cap1", stress_pool_exactly_once<LIWThreadPoolSized<1>>);
+	suite.Add("thread_pool_sized/exactly_once_cap3", stress_pool_exactly_once<LIWThreadPoolSized<3>>);
+	suite.Add("thread_pool_sized/exactly_once_cap1024", stress_pool_exactly_once<LIWThreadPoolSized<1024>>);
+}
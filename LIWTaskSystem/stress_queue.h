@@ -0,0 +1,283 @@
+#pragma once
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <deque>
+#include <memory>
+
+#include "LIWStress.h"
+#include "LIWThreadSafeQueue.h"
+#include "LIWThreadSafeQueueSized.h"
+
+using namespace LIW;
+using namespace LIW::Util;
+
+/*
+* Sequential model check: random ops on a queue and on std::deque must give the same results.
+*/
+bool stress_queue_model_sizefree(LIWStressContext& ctx) {
+	LIWStressRandom& rng = ctx.GetRandom();
+	LIWThreadSafeQueue<uint64_t> queue;
+	std::deque<uint64_t> model;
+	const uint64_t countOps = rng.Range(100, 2000);
+	for (uint64_t i = 0; i < countOps; ++i) {
+		uint64_t val = 0;
+		switch (rng.Range(0, 4)) {
+		case 0:
+		case 1:
+			LIW_STRESS_CHECK(ctx, queue.push_now(i));
+			model.push_back(i);
+			break;
+		case 2:
+			LIW_STRESS_CHECK(ctx, queue.pop_now(val) == !model.empty());
+			if (!model.empty()) {
+				LIW_STRESS_CHECK(ctx, val == model.front());
+				model.pop_front();
+			}
+			break;
+		case 3:
+			LIW_STRESS_CHECK(ctx, queue.front(val) == !model.empty());
+			LIW_STRESS_CHECK(ctx, model.empty() || val == model.front());
+			break;
+		case 4:
+			LIW_STRESS_CHECK(ctx, queue.back(val) == !model.empty());
+			LIW_STRESS_CHECK(ctx, model.empty() || val == model.back());
+			break;
+		}
+		LIW_STRESS_CHECK(ctx, queue.size() == model.size());
+		LIW_STRESS_CHECK(ctx, queue.empty() == model.empty());
+	}
+	return true;
+}
+
+template<uint64_t Capacity>
+bool stress_queue_model_sized(LIWStressContext& ctx) {
+	typedef LIWThreadSafeQueueSized<uint64_t, Capacity> queue_type;
+	LIWStressRandom& rng = ctx.GetRandom();
+	std::unique_ptr<queue_type> queues[2] = { std::unique_ptr<queue_type>(new queue_type()), std::unique_ptr<queue_type>(new queue_type()) };
+	std::deque<uint64_t> models[2];
+	std::vector<uint64_t> buffer(Capacity);
+	const uint64_t countOps = rng.Range(100, 2000);
+	for (uint64_t i = 0; i < countOps; ++i) {
+		const int idx = (int)rng.Range(0, 1);
+		queue_type& queue = *queues[idx];
+		std::deque<uint64_t>& model = models[idx];
+		uint64_t val = 0;
+		switch (rng.Range(0, 6)) {
+		case 0:
+		case 1:
+			LIW_STRESS_CHECK(ctx, queue.push_now(i) == (model.size() < Capacity));
+			if (model.size() < Capacity) model.push_back(i);
+			break;
+		case 2:
+			LIW_STRESS_CHECK(ctx, queue.pop_now(val) == !model.empty());
+			if (!model.empty()) {
+				LIW_STRESS_CHECK(ctx, val == model.front());
+				model.pop_front();
+			}
+			break;
+		case 3:
+			LIW_STRESS_CHECK(ctx, queue.front(val) == !model.empty());
+			LIW_STRESS_CHECK(ctx, model.empty() || val == model.front());
+			LIW_STRESS_CHECK(ctx, queue.back(val) == !model.empty());
+			LIW_STRESS_CHECK(ctx, model.empty() || val == model.back());
+			break;
+		case 4: {
+			const uint64_t maxN = rng.Range(0, Capacity);
+			const uint64_t count = queue.pop_bulk(buffer.data(), maxN);
+			LIW_STRESS_CHECK(ctx, count == (std::min)((uint64_t)model.size(), maxN));
+			for (uint64_t j = 0; j < count; ++j) {
+				LIW_STRESS_CHECK(ctx, buffer[j] == model.front());
+				model.pop_front();
+			}
+			break;
+		}
+		case 5: {
+			std::deque<uint64_t>& modelOther = models[1 - idx];
+			const uint64_t count = queue.steal_half(*queues[1 - idx]);
+			const uint64_t countExpected = (std::min)((uint64_t)(modelOther.size() + 1) / 2, (uint64_t)(Capacity - model.size()));
+			LIW_STRESS_CHECK(ctx, count == countExpected);
+			for (uint64_t j = 0; j < count; ++j) {
+				model.push_back(modelOther.front());
+				modelOther.pop_front();
+			}
+			break;
+		}
+		case 6:
+			LIW_STRESS_CHECK(ctx, queue.size() <= Capacity);
+			break;
+		}
+		for (int j = 0; j < 2; ++j) {
+			LIW_STRESS_CHECK(ctx, queues[j]->size() == models[j].size());
+			LIW_STRESS_CHECK(ctx, queues[j]->empty() == models[j].empty());
+		}
+	}
+	return true;
+}
+
+/*
+* Concurrent MPMC check. Values are (producer, seq) pairs.
+* Every value must be popped exactly once, and each consumer must see values of a producer in push order.
+*/
+inline void stress_queue_push(LIWThreadSafeQueue<uint64_t>& queue, uint64_t val, LIWStressRandom& rng) {
+	queue.push_now(val);
+}
+template<uint64_t Capacity>
+inline void stress_queue_push(LIWThreadSafeQueueSized<uint64_t, Capacity>& queue, uint64_t val, LIWStressRandom& rng) {
+	if (rng.OneIn(2)) {
+		queue.push(val);
+	}
+	else {
+		while (!queue.push_now(val)) { std::this_thread::yield(); }
+	}
+}
+inline uint64_t stress_queue_capacity(const LIWThreadSafeQueue<uint64_t>&) { return UINT64_MAX; }
+template<uint64_t Capacity>
+inline uint64_t stress_queue_capacity(const LIWThreadSafeQueueSized<uint64_t, Capacity>&) { return Capacity; }
+
+class StressValueChecker {
+public:
+	StressValueChecker(uint64_t countProducers, uint64_t countPerProducer) :
+		m_countProducers(countProducers), m_countPerProducer(countPerProducer), m_seen(countProducers * countPerProducer) {
+		for (auto& seen : m_seen) seen.store(0, std::memory_order_relaxed);
+	}
+	static inline uint64_t Encode(uint64_t producer, uint64_t seq) { return (producer << 32) | seq; }
+
+	// Per consumer state: next minimal seq of each producer
+	inline std::vector<uint64_t> MakeConsumerState() const { return std::vector<uint64_t>(m_countProducers, 0); }
+	inline void OnPop(LIWStressContext& ctx, std::vector<uint64_t>& state, uint64_t val) {
+		const uint64_t producer = val >> 32;
+		const uint64_t seq = val & 0xFFFFFFFFu;
+		LIW_STRESS_EXPECT(ctx, producer < m_countProducers && seq < m_countPerProducer);
+		if (producer >= m_countProducers || seq >= m_countPerProducer) return;
+		LIW_STRESS_EXPECT(ctx, seq >= state[producer]); // FIFO per producer
+		state[producer] = seq + 1;
+		m_seen[producer * m_countPerProducer + seq].fetch_add(1, std::memory_order_relaxed);
+	}
+	inline bool CheckExactlyOnce(LIWStressContext& ctx) const {
+		for (auto& seen : m_seen) {
+			LIW_STRESS_CHECK(ctx, seen.load(std::memory_order_relaxed) == 1);
+		}
+		return true;
+	}
+private:
+	uint64_t m_countProducers;
+	uint64_t m_countPerProducer;
+	std::vector<std::atomic<uint32_t>> m_seen;
+};
+
+template<class Queue>
+bool stress_queue_mpmc(LIWStressContext& ctx) {
+	LIWStressRandom& rng = ctx.GetRandom();
+	std::unique_ptr<Queue> queue(new Queue());
+	const uint64_t countProducers = rng.Range(1, 4);
+	const uint64_t countConsumers = rng.Range(1, 4);
+	const uint64_t countPerProducer = rng.Range(1, 5000);
+	const uint64_t countTotal = countProducers * countPerProducer;
+	StressValueChecker checker(countProducers, countPerProducer);
+	std::atomic<uint64_t> tickets{ 0 };
+
+	std::vector<std::thread> threads;
+	for (uint64_t p = 0; p < countProducers; ++p) {
+		threads.emplace_back([&, p](LIWStressRandom rngThread) {
+			for (uint64_t seq = 0; seq < countPerProducer; ++seq) {
+				stress_queue_push(*queue, StressValueChecker::Encode(p, seq), rngThread);
+				LIW_STRESS_EXPECT(ctx, queue->size() <= stress_queue_capacity(*queue));
+				liw_stress_yield(rngThread);
+			}
+		}, rng.Fork());
+	}
+	for (uint64_t c = 0; c < countConsumers; ++c) {
+		threads.emplace_back([&](LIWStressRandom rngThread) {
+			std::vector<uint64_t> state = checker.MakeConsumerState();
+			while (tickets.fetch_add(1, std::memory_order_relaxed) < countTotal) { // A ticket guarantees a value to pop
+				uint64_t val = 0;
+				if (rngThread.OneIn(2)) {
+					LIW_STRESS_EXPECT(ctx, queue->pop(val));
+				}
+				else {
+					while (!queue->pop_now(val)) { std::this_thread::yield(); }
+				}
+				checker.OnPop(ctx, state, val);
+				liw_stress_yield(rngThread);
+			}
+		}, rng.Fork());
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	LIW_STRESS_CHECK(ctx, queue->empty());
+	return checker.CheckExactlyOnce(ctx);
+}
+
+/*
+* Concurrent check of pop_bulk and steal_half: consumers drain with bulk pops or by stealing into a private queue.
+*/
+template<uint64_t Capacity>
+bool stress_queue_bulk_steal(LIWStressContext& ctx) {
+	typedef LIWThreadSafeQueueSized<uint64_t, Capacity> queue_type;
+	LIWStressRandom& rng = ctx.GetRandom();
+	std::unique_ptr<queue_type> queue(new queue_type());
+	const uint64_t countProducers = rng.Range(1, 4);
+	const uint64_t countConsumers = rng.Range(1, 4);
+	const uint64_t countPerProducer = rng.Range(1, 5000);
+	const uint64_t countTotal = countProducers * countPerProducer;
+	StressValueChecker checker(countProducers, countPerProducer);
+	std::atomic<uint64_t> countConsumed{ 0 };
+
+	std::vector<std::thread> threads;
+	for (uint64_t p = 0; p < countProducers; ++p) {
+		threads.emplace_back([&, p](LIWStressRandom rngThread) {
+			for (uint64_t seq = 0; seq < countPerProducer; ++seq) {
+				stress_queue_push(*queue, StressValueChecker::Encode(p, seq), rngThread);
+				liw_stress_yield(rngThread);
+			}
+		}, rng.Fork());
+	}
+	for (uint64_t c = 0; c < countConsumers; ++c) {
+		threads.emplace_back([&](LIWStressRandom rngThread) {
+			std::vector<uint64_t> state = checker.MakeConsumerState();
+			std::unique_ptr<queue_type> queueLocal(new queue_type());
+			std::vector<uint64_t> buffer(Capacity);
+			while (countConsumed.load(std::memory_order_relaxed) < countTotal) {
+				uint64_t count = 0;
+				if (rngThread.OneIn(2)) {
+					count = queue->pop_bulk(buffer.data(), rngThread.Range(1, Capacity));
+				}
+				else {
+					const uint64_t countStolen = queueLocal->steal_half(*queue);
+					LIW_STRESS_EXPECT(ctx, queueLocal->size() == countStolen);
+					count = queueLocal->pop_bulk(buffer.data(), Capacity);
+					LIW_STRESS_EXPECT(ctx, count == countStolen);
+				}
+				for (uint64_t i = 0; i < count; ++i) {
+					checker.OnPop(ctx, state, buffer[i]);
+				}
+				countConsumed.fetch_add(count, std::memory_order_relaxed);
+				if (count == 0) {
+					std::this_thread::yield();
+				}
+				liw_stress_yield(rngThread);
+			}
+		}, rng.Fork());
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	LIW_STRESS_CHECK(ctx, queue->empty());
+	return checker.CheckExactlyOnce(ctx);
+}
+
+void stress_register_queue(LIWStressSuite& suite) {
+	suite.Add("queue/model", stress_queue_model_sizefree);
+	suite.Add("queue/mpmc", stress_queue_mpmc<LIWThreadSafeQueue<uint64_t>>);
+	suite.Add("queue_sized/model_cap1", stress_queue_model_sized<1>);
+	suite.Add("queue_sized/model_cap3", stress_queue_model_sized<3>);
+	suite.Add("queue_sized/model_cap64", stress_queue_model_sized<64>);
+	suite.Add("queue_sized/mpmc_cap1", stress_queue_mpmc<LIWThreadSafeQueueSized<uint64_t, 1>>);
+	suite.Add("queue_sized/mpmc_cap3", stress_queue_mpmc<LIWThreadSafeQueueSized<uint64_t, 3>>);
+	suite.Add("queue_sized/mpmc_cap64", stress_queue_mpmc<LIWThreadSafeQueueSized<uint64_t, 64>>);
+	suite.Add("queue_sized/bulk_steal_cap1", stress_queue_bulk_steal<1>);
+	suite.Add("queue_sized/bulk_steal_cap3", stress_queue_bulk_steal<3>);
+	suite.Add("queue_sized/bulk_steal_cap64", stress_queue_bulk_steal<64>);
+}
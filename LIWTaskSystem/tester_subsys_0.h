@@ -9,12 +9,16 @@ void test() {
 	liw_minit_static();
 	liw_minit_frame();
 	liw_minit_dframe();
+	liw_minit_pool();
+	liw_minit_slab();
 
 	// Init mem for thread
 	liw_minit_def_thd();
 	liw_minit_static_thd();
 	liw_minit_frame_thd();
 	liw_minit_dframe_thd();
+	liw_minit_pool_thd();
+	liw_minit_slab_thd();
 
 
 	liw_hdl_type h0 = liw_new<LIWMem_Static, int>(2);
@@ -23,6 +27,11 @@ void test() {
 	printf("%d\n", v0);
 	liw_delete<LIWMem_Static, int>(h0);
 
+	struct alignas(64) Aligned64 { int m_val; }; // Over-aligned: only the mode used may be instantiated (pool and slab modes reject it)
+	liw_hdl_type h0a = liw_new<LIWMem_Static, Aligned64>(Aligned64{ 7 });
+	printf("%d %d\n", liw_mget<LIWMem_Static, Aligned64>(h0a).m_val, (int)((uintptr_t)liw_maddr<LIWMem_Static>(h0a) % 64));
+	liw_delete<LIWMem_Static, Aligned64>(h0a);
+
 	liw_hdl_type h1 = liw_new<LIWMem_Default, int>(2);
 	liw_mset<LIWMem_Default, int>(h1, 15);
 	int v1 = liw_mget<LIWMem_Default, int>(h1);
@@ -35,20 +44,42 @@ void test() {
 	printf("%d\n", v2);
 	liw_delete<LIWMem_Frame, int>(h2);
 
+	{
+		auto scope = liw_mscope_frame();
+		liw_hdl_type h2s = liw_new<LIWMem_Frame, int>(3);
+		printf("%d\n", liw_mget<LIWMem_Frame, int>(h2s));
+	}
+
 	liw_hdl_type h3 = liw_new<LIWMem_DFrame, int>(2);
 	liw_mset<LIWMem_DFrame, int>(h3, 15);
 	int v3 = liw_mget<LIWMem_DFrame, int>(h3);
 	printf("%d\n", v3);
 	liw_delete<LIWMem_DFrame, int>(h3);
 
+	liw_hdl_type h4 = liw_new<LIWMem_Pool, int>(2);
+	liw_mset<LIWMem_Pool, int>(h4, 15);
+	int v4 = liw_mget<LIWMem_Pool, int>(h4);
+	printf("%d\n", v4);
+	liw_delete<LIWMem_Pool, int>(h4);
+
+	liw_hdl_type h5 = liw_new<LIWMem_Slab, int>(2);
+	liw_mset<LIWMem_Slab, int>(h5, 15);
+	int v5 = liw_mget<LIWMem_Slab, int>(h5);
+	printf("%d\n", v5);
+	liw_delete<LIWMem_Slab, int>(h5);
+
 
 	// Cleanup mem for thread
+	liw_mclnup_slab_thd();
+	liw_mclnup_pool_thd();
 	liw_mclnup_dframe_thd();
 	liw_mclnup_frame_thd();
 	liw_mclnup_static_thd();
 	liw_mclnup_def_thd();
 
 	// Cleanup mem
+	liw_mclnup_slab();
+	liw_mclnup_pool();
 	liw_mclnup_dframe();
 	liw_mclnup_frame();
 	liw_mclnup_static();